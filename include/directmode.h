@@ -0,0 +1,97 @@
+#ifndef DIRECTMODE_H
+#define DIRECTMODE_H
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+#include <openvr_driver.h>
+#include <swaptextures.h>
+#include <layercompositor.h>
+#include <driverprofile.h>
+
+// --------------------------------------------------------------------------
+// Purpose: The display a direct mode component scans out on
+// --------------------------------------------------------------------------
+class IDirectModeDisplay
+{
+public:
+	/** Presents the composited frame, aiming for vsync ulRequestedFrame (0 for the next one), and returns the vsync it scans out on */
+	virtual uint64_t PresentDirectModeFrame( uint64_t ulRequestedFrame ) = 0;
+
+	/** Blocks until the last presented frame starts scanning out */
+	virtual void WaitForDirectModeFrame() = 0;
+
+	virtual uint64_t GetLastScanoutFrame() = 0;
+};
+
+
+// --------------------------------------------------------------------------
+// Purpose: Driver direct mode component for a display without a GPU scan-out
+//			path. Swap texture sets live in shared memory the driver can read
+//			on the CPU, and submitted layers are composited there. Frames are
+//			paced and counted against the display's vsync timeline.
+// --------------------------------------------------------------------------
+class CSampleDirectModeComponent : public vr::IVRDriverDirectModeComponent
+{
+public:
+	CSampleDirectModeComponent( CDriverProfile &profile, IDirectModeDisplay &display );
+
+	/** Starts the compositor for eyes of the given size; unThreads of 0 picks one per core */
+	void Start( uint32_t unEyeWidth, uint32_t unEyeHeight, uint32_t unThreads );
+	void Stop();
+
+	virtual void CreateSwapTextureSet( uint32_t unPid, const SwapTextureSetDesc_t *pSwapTextureSetDesc, SwapTextureSet_t *pOutSwapTextureSet );
+	virtual void DestroySwapTextureSet( vr::SharedTextureHandle_t sharedTextureHandle );
+	virtual void DestroyAllSwapTextureSets( uint32_t unPid );
+	virtual void GetNextSwapTextureSetIndex( vr::SharedTextureHandle_t sharedTextureHandles[ 2 ], uint32_t( *pIndices )[ 2 ] );
+	virtual void SubmitLayer( const SubmitLayerPerEye_t( &perEye )[ 2 ] );
+	virtual void Present( vr::SharedTextureHandle_t syncTexture );
+	virtual void PostPresent();
+	virtual void GetFrameTiming( vr::DriverDirectMode_FrameTiming *pFrameTiming );
+
+	const CSwapTextureSetPool &GetSwapTextures() const { return m_swapTextures; }
+
+	/** Compositor kernel, threads and frame counts */
+	void FormatCompositorSummary( char *pchBuffer, uint32_t unBufferSize ) const;
+
+	/** Present, mis-present and dropped frame totals and the current pacing */
+	void FormatTimingSummary( char *pchBuffer, uint32_t unBufferSize ) const;
+
+	/** Cycles two eye sets of the given size for a number of frames and writes the per-frame and per-set cost */
+	void RunSwapSetBenchmark( uint32_t unWidth, uint32_t unHeight, uint32_t unFrames, char *pchBuffer, uint32_t unBufferSize );
+
+private:
+	/** Picks how many vsyncs each frame is held for from the runtime's reprojection flags and recent drops */
+	void UpdatePacing( uint32_t unReprojectionFlags );
+
+	/** Lets go of the textures of the layers submitted since the last composite */
+	void UnpinLayers();
+
+	CDriverProfile &m_profile;
+	IDirectModeDisplay &m_display;
+	CSwapTextureSetPool m_swapTextures;
+	CLayerCompositor m_compositor;
+	std::atomic<uint64_t> m_ulCompositedFrames;
+	std::atomic<uint64_t> m_ulRejectedLayers;
+
+	// textures of the queued layers, pinned so a client destroying its set cannot unmap them mid-composite
+	SwapTextureMemory_t m_rPinned[ CLayerCompositor::k_unMaxLayers * 2 ];
+	uint32_t m_unPinnedCount;
+
+	// the frame on screen and what it was predicted to be; only touched on the compositor's thread
+	uint64_t m_ulTargetFrame;
+	uint32_t m_unNumMisPresented;
+	uint32_t m_unNumDroppedFrames;
+	uint32_t m_unRecentDrops;		// one bit per frame, newest in bit 0
+	uint32_t m_unFramesSinceDrop;	// since the last drop or pacing change
+
+	std::atomic<uint32_t> m_unFrameInterval;
+	std::atomic<uint32_t> m_unReprojectionFlags;
+	std::atomic<uint64_t> m_ulMisPresentedFrames;
+	std::atomic<uint64_t> m_ulDroppedFrames;
+};
+
+
+#endif // DIRECTMODE_H
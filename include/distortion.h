@@ -0,0 +1,206 @@
+#ifndef DISTORTION_H
+#define DISTORTION_H
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <openvr_driver.h>
+
+// --------------------------------------------------------------------------
+// Purpose: Maps a point in an eye's output viewport to the texture
+//			coordinates each colour channel samples from
+// --------------------------------------------------------------------------
+class IDistortionModel
+{
+public:
+	virtual ~IDistortionModel() {}
+
+	virtual vr::DistortionCoordinates_t Evaluate( vr::EVREye eEye, float fU, float fV ) const = 0;
+
+	/** Evaluates unCount points at once: pflU/pflV in, one u and one v array out per channel (red, green, blue).
+		The default calls Evaluate() per point; models with a vector path override it. */
+	virtual void EvaluateBatch( vr::EVREye eEye, const float *pflU, const float *pflV, uint32_t unCount,
+		float *const rpflOutU[3], float *const rpflOutV[3] ) const;
+};
+
+
+enum ELensChannel
+{
+	LensChannel_Red,
+	LensChannel_Green,
+	LensChannel_Blue,
+
+	LensChannel_Count
+};
+
+enum EDistortionKernel
+{
+	DistortionKernel_Scalar,
+	DistortionKernel_Avx2,
+	DistortionKernel_Neon,
+
+	DistortionKernel_Count
+};
+
+struct LensConfig_t
+{
+	// k1, k2, k3 of 1 + k1 r^2 + k2 r^4 + k3 r^6 for each channel
+	float rrflRadial[ LensChannel_Count ][3];
+
+	// decentring terms, shared by the channels; mirrored horizontally for the right eye
+	float flTangentialP1;
+	float flTangentialP2;
+
+	// optical axis of each eye in viewport coordinates
+	float rrflCentre[2][2];
+
+	// eye viewport width over height, so the radius is measured in square units
+	float flAspect;
+
+	// texture units per lens unit; 0 fits the green channel's edge at r = 1 to the texture edge
+	float flScale;
+};
+
+
+// --------------------------------------------------------------------------
+// Purpose: Polynomial lens model: radial distortion per colour channel, which
+//			is what produces the chromatic aberration, plus tangential
+//			decentring. Lens coordinates put the optical axis at the origin
+//			and the top and bottom edges of the viewport at +/-1.
+// --------------------------------------------------------------------------
+class CLensModel : public IDistortionModel
+{
+public:
+	CLensModel();
+
+	/** The default config leaves the image undistorted */
+	static void GetDefaultConfig( LensConfig_t *pConfig );
+
+	void Configure( const LensConfig_t &config );
+	const LensConfig_t &GetConfig() const { return m_config; }
+
+	/** Optical axis of an eye in viewport coordinates */
+	void GetCentre( vr::EVREye eEye, float *pfU, float *pfV ) const;
+
+	virtual vr::DistortionCoordinates_t Evaluate( vr::EVREye eEye, float fU, float fV ) const;
+	virtual void EvaluateBatch( vr::EVREye eEye, const float *pflU, const float *pflV, uint32_t unCount,
+		float *const rpflOutU[3], float *const rpflOutV[3] ) const;
+
+	/** The batch kernel defaults to the widest one the CPU supports. The vector kernels follow the scalar
+		operation order, so they agree with Evaluate() to the bit unless the compiler fuses multiply-adds. */
+	static bool IsKernelSupported( EDistortionKernel eKernel );
+	static const char *GetKernelName( EDistortionKernel eKernel );
+	void SetKernel( EDistortionKernel eKernel ) { m_eKernel = eKernel; }
+	EDistortionKernel GetKernel() const { return m_eKernel; }
+
+	/** Evaluates unSamples points with every supported kernel and writes samples per second and the largest difference from scalar */
+	void RunBatchBenchmark( uint32_t unSamples, char *pchBuffer, uint32_t unBufferSize ) const;
+
+	// constants of one eye as the kernels consume them
+	struct EyeTerms_t
+	{
+		float flCentreU;
+		float flCentreV;
+		float flLensScaleU;			// viewport to lens units
+		float flTangentialP1;
+		float flTangentialP2;		// sign already flipped for the right eye
+		float flTextureScaleU;		// lens to texture units
+		float flTextureScaleV;
+		float rrflRadial[ LensChannel_Count ][3];
+	};
+
+	const EyeTerms_t &GetEyeTerms( vr::EVREye eEye ) const { return m_rEyeTerms[ eEye == vr::Eye_Left ? 0 : 1 ]; }
+
+private:
+	LensConfig_t m_config;
+	float m_flScale;
+	EyeTerms_t m_rEyeTerms[2];
+	EDistortionKernel m_eKernel;
+};
+
+
+// --------------------------------------------------------------------------
+// Purpose: Distortion mesh file. The header is followed by each eye's
+//			(unCells + 1)^2 nodes in rows, every node holding red, green and
+//			blue texture coordinates as six floats, so the nodes can be
+//			sampled straight out of a read-only mapping. Little endian.
+// --------------------------------------------------------------------------
+static const uint32_t k_unDistortionMeshMagic = 0x4d445653;	// "SVDM"
+static const uint32_t k_unDistortionMeshVersion = 1;
+static const uint32_t k_unDistortionMeshMaxCells = 4096;
+static const uint64_t k_ulDistortionMeshVerifyBytes = 64ull << 20;	// larger meshes are checksummed after Load, off the calling thread
+
+struct DistortionMeshHeader_t
+{
+	uint32_t unMagic;
+	uint32_t unVersion;
+	uint32_t unHeaderSize;			// later versions may append fields; the nodes start after this
+	uint32_t unCells;
+	uint32_t unChannels;			// always LensChannel_Count
+	uint32_t unReserved;
+	uint64_t rulEyeOffset[2];		// byte offset of each eye's nodes from the start of the file
+	uint64_t ulChecksum;			// FNV-1a style, xor and multiply per little endian 64 bit word after the header
+};
+
+
+// --------------------------------------------------------------------------
+// Purpose: A distortion model sampled on a regular grid over each eye's
+//			viewport. Lookups interpolate bilinearly, so they cost the same
+//			however expensive the model behind the grid is. The nodes either
+//			come from a model or are mapped from a mesh file.
+// --------------------------------------------------------------------------
+class CDistortionGrid
+{
+public:
+	CDistortionGrid();
+	~CDistortionGrid();
+
+	/** Samples the model at (unCells + 1)^2 nodes per eye */
+	void Build( const IDistortionModel &model, uint32_t unCells );
+
+	/** Maps a mesh file read-only and samples it in place; on failure logs why and leaves the grid as it was.
+		A file up to k_ulDistortionMeshVerifyBytes is checksummed here; a larger one is accepted with
+		IsChecksumPending() set, and the caller runs VerifyChecksum() where reading it all does no harm. */
+	bool Load( const char *pchPath );
+
+	/** Reads the whole mapping and compares it with the header checksum; true for a grid built from a model */
+	bool VerifyChecksum() const;
+	bool IsChecksumPending() const { return m_bChecksumPending; }
+
+	/** Writes the current nodes as a mesh file */
+	bool Save( const char *pchPath ) const;
+
+	bool IsValid() const { return m_unCells != 0; }
+	bool IsMapped() const { return m_pMapping != nullptr; }
+	uint32_t GetCells() const { return m_unCells; }
+
+	vr::DistortionCoordinates_t Sample( vr::EVREye eEye, float fU, float fV ) const;
+
+	/** Largest texture coordinate difference from the model, checked at every cell centre */
+	float MeasureMaxError( const IDistortionModel &model ) const;
+
+private:
+	CDistortionGrid( const CDistortionGrid & ) = delete;
+	CDistortionGrid &operator=( const CDistortionGrid & ) = delete;
+
+	// texture coordinates of one node, red, green and blue
+	struct Node_t
+	{
+		float rflUV[6];
+	};
+
+	void Unmap();
+
+	uint32_t m_unCells;
+	std::vector<Node_t> m_rvecNodes[2];
+	const Node_t *m_rpNodes[2];			// into m_rvecNodes or the mapping
+
+	void *m_pMapping;
+	uint64_t m_ulMappingSize;
+	bool m_bChecksumPending;
+};
+
+
+#endif // DISTORTION_H
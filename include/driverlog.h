@@ -17,6 +17,18 @@ extern void DriverLog( const char *pchFormat, ... );
 extern void DebugDriverLog( const char *pchFormat, ... );
 
 
+// --------------------------------------------------------------------------
+// Purpose: Write to the log file from per-frame paths (Present, WaitForPresent,
+//			...). Compiled out entirely in stress builds (DRIVER_NO_FRAME_LOG)
+//			so those paths cost nothing but their own work.
+// --------------------------------------------------------------------------
+#if defined( DRIVER_NO_FRAME_LOG )
+#define FrameDriverLog( ... ) ( (void)0 )
+#else
+#define FrameDriverLog( ... ) DriverLog( __VA_ARGS__ )
+#endif
+
+
 extern bool InitDriverLog( vr::IVRDriverLog *pDriverLog );
 extern void CleanupDriverLog();
 
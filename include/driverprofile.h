@@ -0,0 +1,81 @@
+#ifndef DRIVERPROFILE_H
+#define DRIVERPROFILE_H
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+enum EDriverEntryPoint
+{
+	EntryPoint_Present,
+	EntryPoint_WaitForPresent,	// excludes the time the frame was legitimately waiting for its vsync
+	EntryPoint_GetTimeSinceLastVsync,
+	EntryPoint_ScanoutTick,		// excludes the sleep until the vsync
+	EntryPoint_CreateSwapTextureSet,
+	EntryPoint_DestroySwapTextureSet,
+	EntryPoint_GetNextSwapTextureSetIndex,
+	EntryPoint_SubmitLayer,
+	EntryPoint_Composite,		// direct mode Present, less the virtual display Present it makes
+
+	EntryPoint_Count
+};
+
+
+// --------------------------------------------------------------------------
+// Purpose: Cost of the driver's own work on the display path, so driver
+//			overhead can be told apart from runtime overhead. Lock-free; safe to
+//			feed from the compositor and scan-out threads at the same time.
+// --------------------------------------------------------------------------
+class CDriverProfile
+{
+public:
+	CDriverProfile() { Reset(); }
+
+	void Reset();
+
+	void AddSample( EDriverEntryPoint eEntryPoint, uint64_t ulNs );
+
+	/** Counts a presented frame for the achieved frame rate */
+	void AddPresent( uint64_t ulNowNs );
+
+	/** Writes per entry point cost, achieved frame rate and the rate the driver alone could sustain */
+	void FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const;
+
+private:
+	struct EntryPointStats_t
+	{
+		std::atomic<uint64_t> ulCalls;
+		std::atomic<uint64_t> ulTotalNs;
+		std::atomic<uint64_t> ulMaxNs;
+	};
+
+	EntryPointStats_t m_entryPoints[ EntryPoint_Count ];
+	std::atomic<uint64_t> m_ulFirstPresentNs;
+	std::atomic<uint64_t> m_ulLastPresentNs;
+	std::atomic<uint64_t> m_ulPresents;
+};
+
+
+// --------------------------------------------------------------------------
+// Purpose: Adds the lifetime of the scope to one entry point. A scope opened
+//			inside another on the same thread is charged to its own entry
+//			point only and taken out of the enclosing one, so the per-frame
+//			sum counts every nanosecond once.
+// --------------------------------------------------------------------------
+class CScopedDriverProfile
+{
+public:
+	CScopedDriverProfile( CDriverProfile &profile, EDriverEntryPoint eEntryPoint );
+	~CScopedDriverProfile();
+
+private:
+	CDriverProfile &m_profile;
+	EDriverEntryPoint m_eEntryPoint;
+	uint64_t m_ulStartNs;
+	uint64_t m_ulNestedNs;					// spent in scopes opened inside this one
+	CScopedDriverProfile *m_pEnclosing;
+};
+
+
+#endif // DRIVERPROFILE_H
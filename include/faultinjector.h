@@ -0,0 +1,107 @@
+#ifndef FAULTINJECTOR_H
+#define FAULTINJECTOR_H
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <atomic>
+
+enum EFaultKind
+{
+	Fault_LateVsync,		// the vsync happens late by a fixed amount
+	Fault_SkippedScanout,	// the vsync never happens; the frame slips to the next one
+	Fault_WaitOverrun,		// WaitForPresent() returns late by a fixed amount
+
+	Fault_Count
+};
+
+enum EJitterDistribution
+{
+	Jitter_None,
+	Jitter_Uniform,		// uniform in [-amount, amount]
+	Jitter_Normal,		// normal with standard deviation amount
+	Jitter_Exponential,	// exponential with mean amount, always late
+};
+
+struct FaultConfig_t
+{
+	uint64_t ulSeed;
+
+	float flLateProbability;
+	uint64_t ulLateNs;
+
+	float flSkipProbability;
+
+	float flOverrunProbability;
+	uint64_t ulOverrunNs;
+
+	EJitterDistribution eJitter;
+	uint64_t ulJitterNs;
+
+	// comma separated "<frame>:late[:<us>]", "<frame>:skip" or "<frame>:overrun[:<us>]" events,
+	// frames counted from when injection was enabled
+	std::string sScript;
+	uint32_t unScriptLoopFrames;	// replay the script every this many frames, 0 to play it once
+};
+
+struct VsyncFault_t
+{
+	bool bSkipped;
+	bool bLate;			// a late vsync fault (as opposed to plain jitter) fired
+	int64_t nOffsetNs;	// how far the vsync moved from its nominal time
+};
+
+
+// --------------------------------------------------------------------------
+// Purpose: Deterministic fault model for the vsync timeline. Every decision is
+//			a pure function of the seed and the vsync index, so a run replays
+//			exactly no matter how often or from which thread it is queried.
+// --------------------------------------------------------------------------
+class CFaultInjector
+{
+public:
+	CFaultInjector();
+
+	/** Replaces the model. Call before Enable(); returns false with a reason if the script does not parse. */
+	bool Configure( const FaultConfig_t &config, std::string *psError );
+
+	/** Starts injecting, with scripted frame 0 at ulBaseFrame */
+	void Enable( uint64_t ulBaseFrame );
+	void Disable();
+	bool IsEnabled() const { return m_bEnabled.load( std::memory_order_relaxed ); }
+
+	/** Fault on vsync ulFrame. Offsets are clamped so vsyncs stay in order. */
+	VsyncFault_t GetVsyncFault( uint64_t ulFrame, uint64_t ulPeriodNs ) const;
+
+	/** Extra time WaitForPresent() should block for the frame targeting ulFrame */
+	uint64_t GetWaitOverrunNs( uint64_t ulFrame ) const;
+
+	/** Counts a fault that actually took effect */
+	void CountInjected( EFaultKind eKind ) { m_rulInjected[ eKind ].fetch_add( 1, std::memory_order_relaxed ); }
+
+	void FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const;
+
+private:
+	struct ScriptEvent_t
+	{
+		uint64_t ulFrame;
+		EFaultKind eKind;
+		uint64_t ulAmountNs;
+
+		bool operator<( const ScriptEvent_t &other ) const { return ulFrame < other.ulFrame || ( ulFrame == other.ulFrame && eKind < other.eKind ); }
+	};
+
+	const ScriptEvent_t *FindScriptEvent( uint64_t ulFrame, EFaultKind eKind ) const;
+	double Uniform( uint64_t ulFrame, uint64_t ulStream ) const;
+
+	FaultConfig_t m_config;
+	std::vector<ScriptEvent_t> m_vecScript;
+	std::atomic<bool> m_bEnabled;
+	std::atomic<uint64_t> m_ulBaseFrame;
+	std::atomic<uint64_t> m_rulInjected[ Fault_Count ];
+};
+
+
+#endif // FAULTINJECTOR_H
@@ -0,0 +1,115 @@
+#ifndef FRAMESINK_H
+#define FRAMESINK_H
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include <openvr_driver.h>
+#include <spscqueue.h>
+
+// --------------------------------------------------------------------------
+// Purpose: What Present() hands downstream for one frame
+// --------------------------------------------------------------------------
+struct FrameDescriptor_t
+{
+	vr::SharedTextureHandle_t hTexture;
+	uint64_t nFrameId;
+	uint64_t ulTargetFrame;			// vsync the frame scans out on
+	uint64_t ulTargetVsyncNs;		// monotonic time of that vsync
+	uint64_t ulPresentNs;
+	uint64_t ulPoseSampleNs;		// when the head pose below was sampled
+	double rvecPosition[3];			// head pose the frame was rendered with
+	vr::HmdQuaternion_t qRotation;
+};
+
+
+// --------------------------------------------------------------------------
+// Purpose: A downstream consumer of presented frames. Each sink runs on its own
+//			thread and sees every frame that fit in its queue, in order.
+// --------------------------------------------------------------------------
+class IFrameSink
+{
+public:
+	virtual ~IFrameSink() {}
+
+	virtual const char *GetName() const = 0;
+
+	virtual void ConsumeFrame( const FrameDescriptor_t &frame ) = 0;
+
+	/** Sink specific results, one "key=value" line or more */
+	virtual void FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const
+	{
+		if ( unBufferSize )
+			pchBuffer[0] = 0;
+	}
+};
+
+/** Counts frames, frame id gaps and present cadence */
+extern IFrameSink *CreateStatisticsFrameSink();
+
+/** Stands in for a video encoder by burning ulCostNs of CPU per frame */
+extern IFrameSink *CreateEncoderFrameSink( uint64_t ulCostNs );
+
+/** Appends every descriptor to a binary file; returns nullptr if it cannot be opened */
+extern IFrameSink *CreateRecorderFrameSink( const char *pchPath );
+
+
+// --------------------------------------------------------------------------
+// Purpose: Fans presented frames out to the sinks. Submit() only copies the
+//			descriptor into each sink's lock-free queue, so Present() costs the
+//			same however slow the sinks are; a sink that falls behind drops frames.
+// --------------------------------------------------------------------------
+class CFrameSinkPipeline
+{
+public:
+	CFrameSinkPipeline();
+	~CFrameSinkPipeline();
+
+	/** Takes ownership of pSink. Only valid while stopped. */
+	void AddSink( IFrameSink *pSink );
+
+	void Start();
+	void Stop();
+
+	uint32_t GetSinkCount() const { return (uint32_t)m_vecStages.size(); }
+
+	/** Called from Present(); never blocks */
+	void Submit( const FrameDescriptor_t &frame );
+
+	void FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const;
+
+private:
+	static const uint32_t k_unQueueDepth = 256;
+
+	struct SinkStage_t
+	{
+		IFrameSink *pSink;
+		CSpscQueue< FrameDescriptor_t, k_unQueueDepth > queue;
+		std::thread *pThread;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::atomic<bool> bWaiting;
+
+		std::atomic<uint64_t> ulSubmitted;
+		std::atomic<uint64_t> ulDropped;
+		std::atomic<uint64_t> ulConsumed;
+		std::atomic<uint64_t> ulQueueNsTotal;
+		std::atomic<uint64_t> ulQueueNsMax;
+		std::atomic<uint64_t> ulWorkNsTotal;
+		std::atomic<uint64_t> ulWorkNsMax;
+	};
+
+	void SinkThreadFunction( SinkStage_t *pStage );
+
+	std::vector< SinkStage_t * > m_vecStages;
+	std::atomic<bool> m_bRunning;
+};
+
+
+#endif // FRAMESINK_H
@@ -0,0 +1,80 @@
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// --------------------------------------------------------------------------
+// Purpose: One presented frame as seen by the virtual display
+// --------------------------------------------------------------------------
+struct FrameRecord_t
+{
+	uint64_t ulPresentNs;		// monotonic time Present() was called
+	uint64_t nFrameId;			// PresentInfo_t::nFrameId
+	uint64_t ulTargetFrame;		// vsync the frame scans out on
+	uint64_t ulWaitNs;			// time blocked in the following WaitForPresent()
+	uint32_t unMissedVsyncs;	// vsyncs since the previous frame's target that repeated it
+	uint32_t unFlags;			// EFrameRecordFlags
+};
+
+enum EFrameRecordFlags
+{
+	FrameRecord_Missed = 0x1,		// at least one vsync repeated the previous frame
+	FrameRecord_Duplicated = 0x2,	// targets the same vsync as the previous frame, which is never shown
+	FrameRecord_Late = 0x4,			// scans out after the vsync the compositor asked for
+};
+
+
+// --------------------------------------------------------------------------
+// Purpose: Fixed-size ring of the most recent frame records. Present()/
+//			WaitForPresent() are the only writer and never wait; readers copy
+//			slots out under a per-slot sequence number and retry torn reads.
+// --------------------------------------------------------------------------
+class CFrameStatsRing
+{
+public:
+	static const uint32_t k_unCapacity = 4096;
+
+	CFrameStatsRing();
+
+	/** Appends a frame, filling in the missed/duplicated flags from the previous one */
+	void PushFrame( uint64_t ulPresentNs, uint64_t nFrameId, uint64_t ulTargetFrame, uint64_t ulRequestedFrame );
+
+	/** Records how long WaitForPresent() blocked for the most recent frame */
+	void SetLastWait( uint64_t ulWaitNs );
+
+	/** Copies up to unMaxRecords of the most recent frames, oldest first. Returns the number copied. */
+	uint32_t Snapshot( FrameRecord_t *pRecords, uint32_t unMaxRecords ) const;
+
+	/** Writes a human readable summary of the ring into pchBuffer */
+	void FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const;
+
+private:
+	struct Slot_t
+	{
+		std::atomic<uint32_t> unSequence;
+		std::atomic<uint64_t> ulPresentNs;
+		std::atomic<uint64_t> nFrameId;
+		std::atomic<uint64_t> ulTargetFrame;
+		std::atomic<uint64_t> ulWaitNs;
+		std::atomic<uint32_t> unMissedVsyncs;
+		std::atomic<uint32_t> unFlags;
+	};
+
+	Slot_t m_slots[ k_unCapacity ];
+	std::atomic<uint64_t> m_ulWriteCount;
+
+	// writer-only state
+	uint64_t m_ulPrevTargetFrame;
+
+	// lifetime totals
+	std::atomic<uint64_t> m_ulMissedVsyncs;
+	std::atomic<uint64_t> m_ulDuplicatedFrames;
+	std::atomic<uint64_t> m_ulLateFrames;
+};
+
+
+#endif // FRAMESTATS_H
@@ -0,0 +1,95 @@
+#ifndef FRAMETIMINGCOLLECTOR_H
+#define FRAMETIMINGCOLLECTOR_H
+
+#pragma once
+
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <openvr_driver.h>
+
+// --------------------------------------------------------------------------
+// Purpose: Rolling view of the compositor's recent frames
+// --------------------------------------------------------------------------
+struct FrameTimingAggregates_t
+{
+	uint32_t unFrames;				// frames in the window
+	uint32_t unLastFrameIndex;
+
+	float flGpuMsMean;				// m_flTotalRenderGpuMs
+	float flGpuMsP95;
+	float flAppCpuMsMean;			// WaitGetPoses to the second Submit
+	float flAppCpuMsP95;
+	float flCompositorCpuMsMean;
+	float flIdleMsMean;				// time the application left unused
+
+	uint32_t unCpuReprojected;		// frames reprojected for each reason
+	uint32_t unGpuReprojected;
+	uint32_t unMotionSmoothed;
+	uint32_t unThrottled;			// frames with the application throttled
+	uint32_t unPredicted;			// frames predicted more than one frame ahead
+	uint32_t unDropped;
+	uint32_t unMisPresented;
+
+	uint32_t unLatestThrottledFrames;
+	uint32_t unLatestPredictedFrames;
+};
+
+
+// --------------------------------------------------------------------------
+// Purpose: Pulls Compositor_FrameTiming records from the runtime on a
+//			background thread. Each poll fetches a batch, keeps the frames it
+//			has not seen yet and folds them into a rolling window.
+// --------------------------------------------------------------------------
+class CFrameTimingCollector
+{
+public:
+	static const uint32_t k_unWindowFrames = 256;
+
+	CFrameTimingCollector();
+	~CFrameTimingCollector();
+
+	void Start( uint32_t unPollMs );
+	void Stop();
+
+	/** Adds a batch of records in ascending frame order; frames already seen are skipped */
+	void AddTimings( const vr::Compositor_FrameTiming *pTimings, uint32_t unCount );
+
+	/** Aggregates the window, or only its frames after unSinceFrameIndex when that is not 0; false if no frame qualifies */
+	bool GetAggregates( FrameTimingAggregates_t *pAggregates, uint32_t unSinceFrameIndex = 0 ) const;
+
+	void FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const;
+
+private:
+	struct Sample_t
+	{
+		uint32_t unFrameIndex;
+		float flGpuMs;
+		float flAppCpuMs;
+		float flCompositorCpuMs;
+		float flIdleMs;
+		uint32_t unReprojectionFlags;
+		uint32_t unDroppedFrames;
+		uint32_t unMisPresented;
+	};
+
+	void CollectorThread();
+
+	Sample_t m_rSamples[ k_unWindowFrames ];
+	uint64_t m_ulSamples;			// ever added; the window is the newest k_unWindowFrames
+	uint32_t m_unLastFrameIndex;
+	uint64_t m_ulPolls;
+	uint64_t m_ulDuplicates;
+	uint64_t m_ulMissedFrames;		// frame indices that scrolled out of the runtime's history between polls
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_stopCondition;
+	std::thread *m_pThread;
+	uint32_t m_unPollMs;
+	bool m_bStopping;
+};
+
+
+#endif // FRAMETIMINGCOLLECTOR_H
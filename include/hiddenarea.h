@@ -0,0 +1,54 @@
+#ifndef HIDDENAREA_H
+#define HIDDENAREA_H
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <openvr_driver.h>
+#include <distortion.h>
+#include <inversedistortion.h>
+
+// --------------------------------------------------------------------------
+// Purpose: Hidden area meshes of both eyes in render target UV space. A
+//			render target pixel is visible when some colour channel samples
+//			it for a display pixel that lies inside the viewport and inside
+//			the lens aperture. The outline of the visible region is found
+//			along rays from the lens centre, then turned into the three
+//			meshes OpenVR knows: hidden triangles, visible triangles and
+//			the outline as a line loop.
+// --------------------------------------------------------------------------
+class CHiddenAreaMeshes
+{
+public:
+	CHiddenAreaMeshes();
+
+	/** flApertureRadius is in lens units, where the viewport's top and bottom edges are at 1; 0 leaves only the viewport.
+		unVertexBudget caps the largest mesh, the hidden triangle list. */
+	void Generate( const CLensModel &model, const CInverseDistortion &inverse, float flApertureRadius, uint32_t unVertexBudget );
+
+	/** Identifies everything Generate() depends on, for caching */
+	static uint64_t HashConfig( const LensConfig_t &config, float flApertureRadius, uint32_t unVertexBudget );
+
+	/** Cache file; Load() rejects a file made for another hash or format version */
+	bool Load( const char *pchPath, uint64_t ulHash );
+	bool Save( const char *pchPath, uint64_t ulHash ) const;
+
+	bool IsValid() const { return !m_rrvecMeshes[0][ vr::k_eHiddenAreaMesh_LineLoop ].empty(); }
+	std::vector<vr::HmdVector2_t> &GetMesh( vr::EVREye eEye, vr::EHiddenAreaMeshType eType ) { return m_rrvecMeshes[ eEye == vr::Eye_Left ? 0 : 1 ][ eType ]; }
+
+	/** Share of the render target the hidden mesh covers */
+	float GetHiddenFraction( vr::EVREye eEye ) const;
+
+	/** "key=value" lines: vertex counts and hidden fraction per eye */
+	void FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const;
+
+private:
+	void GenerateEye( vr::EVREye eEye, const CLensModel &model, const CInverseDistortion &inverse, float flApertureRadius, uint32_t unRays );
+
+	std::vector<vr::HmdVector2_t> m_rrvecMeshes[2][ vr::k_eHiddenAreaMesh_Max ];
+};
+
+
+#endif // HIDDENAREA_H
@@ -0,0 +1,84 @@
+#ifndef INVERSEDISTORTION_H
+#define INVERSEDISTORTION_H
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <distortion.h>
+
+// --------------------------------------------------------------------------
+// Purpose: Inverse of a CLensModel: for texture coordinates of one colour
+//			channel, finds the viewport point whose distortion lands there.
+//			A coarse grid over texture space seeds a fixed number of Newton
+//			steps on the lens polynomial, which keeps the work the same for
+//			every point so batches vectorize without divergence.
+// --------------------------------------------------------------------------
+class CInverseDistortion
+{
+public:
+	static const uint32_t k_unDefaultSeedCells = 32;
+	static const uint32_t k_unDefaultIterations = 2;
+
+	CInverseDistortion();
+
+	/** Copies the model's terms and solves the seed grid; the model may change afterwards */
+	void Build( const CLensModel &model, uint32_t unSeedCells = k_unDefaultSeedCells );
+	bool IsValid() const { return m_unSeedCells != 0; }
+
+	/** Newton steps taken from the seed; more only helps strong distortion with a coarse seed grid */
+	void SetIterations( uint32_t unIterations ) { m_unIterations = unIterations; }
+	uint32_t GetIterations() const { return m_unIterations; }
+
+	void SetKernel( EDistortionKernel eKernel ) { m_eKernel = eKernel; }
+	EDistortionKernel GetKernel() const { return m_eKernel; }
+
+	/** Viewport coordinates for unCount texture coordinates of one channel. Returns the largest
+		residual, the distance in texture units between the distortion of an answer and its query. */
+	float SolveBatch( vr::EVREye eEye, ELensChannel eChannel, const float *pflU, const float *pflV, uint32_t unCount,
+		float *pflOutU, float *pflOutV ) const;
+
+	/** Single query; returns the residual */
+	float Solve( vr::EVREye eEye, ELensChannel eChannel, float fU, float fV, float *pfOutU, float *pfOutV ) const;
+
+	/** Residual bounds measured at Build() over the cell centres of the seed grid, from the seed alone and after the Newton steps */
+	float GetSeedError() const { return m_flSeedError; }
+	float GetMaxResidual() const { return m_flMaxResidual; }
+
+	/** "key=value" lines: seed grid, iterations and error bounds */
+	void FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const;
+
+	/** Solves unSamples queries with every supported kernel and writes samples per second and the largest residual */
+	void RunBenchmark( uint32_t unSamples, char *pchBuffer, uint32_t unBufferSize ) const;
+
+	// one eye and channel as the kernels consume it
+	struct Job_t
+	{
+		const CLensModel::EyeTerms_t *pTerms;
+		const float *pflRadial;			// k1, k2, k3 of the channel
+		const float *pflSeedX;			// lens coordinates at each seed node
+		const float *pflSeedY;
+		uint32_t unSeedCells;
+		uint32_t unIterations;
+	};
+
+private:
+	float MeasureResidual( uint32_t unIterations ) const;
+	Job_t GetJob( vr::EVREye eEye, ELensChannel eChannel, uint32_t unIterations ) const;
+
+	CLensModel::EyeTerms_t m_rTerms[2];
+	uint32_t m_unSeedCells;
+	uint32_t m_unIterations;
+	EDistortionKernel m_eKernel;
+
+	// (cells + 1)^2 seed nodes per eye and channel, in lens units
+	std::vector<float> m_rrvecSeedX[2][ LensChannel_Count ];
+	std::vector<float> m_rrvecSeedY[2][ LensChannel_Count ];
+
+	float m_flSeedError;
+	float m_flMaxResidual;
+};
+
+
+#endif // INVERSEDISTORTION_H
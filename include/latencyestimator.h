@@ -0,0 +1,61 @@
+#ifndef LATENCYESTIMATOR_H
+#define LATENCYESTIMATOR_H
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+#include <seqlock.h>
+
+// --------------------------------------------------------------------------
+// Purpose: Motion-to-photon latency of one frame
+// --------------------------------------------------------------------------
+struct FrameLatency_t
+{
+	uint64_t nFrameId;
+	uint64_t ulPoseSampleNs;		// when the pose the frame was rendered with was sampled
+	int64_t nPredictedNs;			// pose sample to photons at the vsync the compositor targeted
+	int64_t nActualNs;				// pose sample to photons at the vsync the frame really scanned out on
+};
+
+
+// --------------------------------------------------------------------------
+// Purpose: Per-frame motion-to-photon estimates and a rolling histogram over
+//			the last k_unWindow frames. One writer (Present), lock-free readers.
+// --------------------------------------------------------------------------
+class CLatencyEstimator
+{
+public:
+	static const uint32_t k_unWindow = 1024;
+	static const uint32_t k_unRecentFrames = 64;
+	static const uint32_t k_unBucketNs = 250000;
+	static const uint32_t k_unBuckets = 400;	// 0..100 ms, the last bucket collects everything above
+
+	static uint32_t BucketFor( int64_t nLatencyNs );
+
+	CLatencyEstimator();
+
+	/** ulRequestedVsyncNs may be 0 if the compositor did not say which vsync it targeted */
+	void AddFrame( uint64_t nFrameId, uint64_t ulPoseSampleNs, uint64_t ulRequestedVsyncNs, uint64_t ulScanoutVsyncNs, uint64_t ulPhotonDelayNs );
+
+	/** Copies up to unMaxFrames of the most recent estimates, newest first */
+	uint32_t GetRecentFrames( FrameLatency_t *pFrames, uint32_t unMaxFrames ) const;
+
+	/** Latency at fraction flFraction of the rolling window, in nanoseconds */
+	double GetPercentileNs( double flFraction ) const;
+
+	void FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const;
+
+private:
+	std::atomic<uint32_t> m_runBuckets[ k_unBuckets ];
+	int64_t m_rnWindowNs[ k_unWindow ];	// writer-only history used to age samples out
+	std::atomic<uint64_t> m_ulFrames;
+	std::atomic<int64_t> m_nWindowSumNs;
+	std::atomic<int64_t> m_nMaxNs;
+
+	CSeqLock<FrameLatency_t> m_recentFrames[ k_unRecentFrames ];
+};
+
+
+#endif // LATENCYESTIMATOR_H
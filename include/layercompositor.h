@@ -0,0 +1,101 @@
+#ifndef LAYERCOMPOSITOR_H
+#define LAYERCOMPOSITOR_H
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include <openvr_driver.h>
+#include <swaptextures.h>
+
+enum ECompositorKernel
+{
+	CompositorKernel_Scalar,
+	CompositorKernel_Sse2,
+	CompositorKernel_Avx2,
+
+	CompositorKernel_Count
+};
+
+
+// --------------------------------------------------------------------------
+// Purpose: Combines the layers submitted for a frame into one side by side
+//			RGBA8 image on the CPU. The first layer is copied, later layers are
+//			blended over it with their alpha. Rows are split into tiles that a
+//			pool of worker threads and the calling thread work through together.
+// --------------------------------------------------------------------------
+class CLayerCompositor
+{
+public:
+	static const uint32_t k_unMaxLayers = 16;
+
+	CLayerCompositor();
+	~CLayerCompositor();
+
+	/** unThreads counts the calling thread; 0 picks one per core */
+	void Start( uint32_t unThreads );
+	void Stop();
+	uint32_t GetThreadCount() const { return (uint32_t)m_vecWorkers.size() + 1; }
+
+	/** Resizes the output; only call between frames */
+	void SetEyeSize( uint32_t unEyeWidth, uint32_t unEyeHeight );
+
+	/** Queues a layer for the next Composite(); false if it is full or a texture is not 8 bit RGBA */
+	bool AddLayer( const SwapTextureMemory_t ( &rEyeMemory )[2], const vr::VRTextureBounds_t ( &rEyeBounds )[2] );
+	uint32_t GetLayerCount() const { return m_unLayerCount; }
+
+	/** Composites and then clears the queued layers */
+	void Composite();
+
+	/** Both eyes side by side, row pitch is twice the eye width */
+	const uint32_t *GetOutput() const { return m_vecOutput.data(); }
+
+	static bool IsKernelSupported( ECompositorKernel eKernel );
+	static const char *GetKernelName( ECompositorKernel eKernel );
+	void SetKernel( ECompositorKernel eKernel ) { m_eKernel = eKernel; }
+	ECompositorKernel GetKernel() const { return m_eKernel; }
+
+	/** Composites a full layer plus a cropped overlay per eye with every supported kernel and writes megapixels per second */
+	static void RunBenchmark( uint32_t unThreads, uint32_t unEyeWidth, uint32_t unEyeHeight, uint32_t unFrames, char *pchBuffer, uint32_t unBufferSize );
+
+private:
+	struct EyeLayer_t
+	{
+		SwapTextureMemory_t memory;
+		vr::VRTextureBounds_t bounds;
+		std::vector<int32_t> vecColumns;	// source column per output column
+		std::vector<int32_t> vecRows;		// source row per output row
+		bool bContiguous;					// columns are one unscaled run, no gather needed
+	};
+
+	void PrepareEyeLayer( EyeLayer_t &eyeLayer );
+	void CompositeTile( uint32_t unTile );
+	void RunTiles();
+	void WorkerThread();
+
+	ECompositorKernel m_eKernel;
+	uint32_t m_unEyeWidth;
+	uint32_t m_unEyeHeight;
+	std::vector<uint32_t> m_vecOutput;
+
+	EyeLayer_t m_rLayers[ k_unMaxLayers ][2];
+	uint32_t m_unLayerCount;
+
+	std::vector<std::thread> m_vecWorkers;
+	std::mutex m_mutex;
+	std::condition_variable m_startCondition;
+	std::condition_variable m_doneCondition;
+	uint64_t m_ulJobGeneration;
+	bool m_bStopping;
+	uint32_t m_unTileCount;
+	std::atomic<uint32_t> m_unNextTile;
+	std::atomic<uint32_t> m_unTilesDone;
+};
+
+
+#endif // LAYERCOMPOSITOR_H
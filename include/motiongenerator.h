@@ -0,0 +1,155 @@
+#ifndef MOTIONGENERATOR_H
+#define MOTIONGENERATOR_H
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <mutex>
+
+#include <openvr_driver.h>
+
+enum EMotionMode
+{
+	Motion_Still,		// holds the base pose
+	Motion_Sweep,		// sinusoids per axis at unrelated frequencies, a Lissajous scan
+	Motion_Spline,		// cubic B-spline through random control points
+	Motion_Walk,		// damped random walk with bounded acceleration
+	Motion_Script,		// Catmull-Rom through scripted keyframes
+
+	Motion_Count
+};
+
+enum EMotionProfile
+{
+	MotionProfile_Head,		// mostly yaw, little roll, small translation
+	MotionProfile_Hand,		// three times the translation and faster, free wrist rotation, held out in front
+};
+
+struct MotionConfig_t
+{
+	EMotionMode eMode;
+	EMotionProfile eProfile;
+	uint64_t ulSeed;
+
+	float flPositionAmplitude;	// meters, the largest axis
+	float flRotationAmplitude;	// degrees, the largest axis
+	float flFrequency;			// Hz; sweep period, spline knot rate and walk spring all scale with it
+
+	// "<seconds>:<x>,<y>,<z>,<yaw>,<pitch>,<roll>" keyframes separated by ';', meters and degrees
+	std::string sScript;
+	bool bScriptLoop;			// replay the script, otherwise hold the last keyframe
+};
+
+// a pose with the derivatives that belong to it, in driver world space
+struct MotionSample_t
+{
+	double rflPosition[3];
+	double rflVelocity[3];
+	double rflAcceleration[3];
+	vr::HmdQuaternion_t qRotation;
+	double rflAngularVelocity[3];
+	double rflAngularAcceleration[3];
+};
+
+
+// --------------------------------------------------------------------------
+// Purpose: Synthetic tracked device motion. Six channels, three positions and
+//			yaw, pitch and roll, each follow the configured trajectory; every
+//			derivative is taken from the same closed form, so velocity and
+//			acceleration are exactly what a predictor should extrapolate.
+//			Trajectories are a pure function of the seed and the time, and
+//			replay exactly for any sampling rate.
+// --------------------------------------------------------------------------
+class CMotionGenerator
+{
+public:
+	CMotionGenerator();
+
+	/** Replaces the trajectory; returns false with a reason if the script does not parse. Not safe against a concurrent Sample(). */
+	bool Configure( const MotionConfig_t &config, std::string *psError );
+
+	static const char *GetModeName( EMotionMode eMode );
+	/** Returns Motion_Count for an unknown name */
+	static EMotionMode FindMode( const char *pchName );
+
+	EMotionMode GetMode() const { return m_config.eMode; }
+
+	/** Motion at ulTimeNs after the start of the trajectory. Safe from any thread. */
+	MotionSample_t Sample( uint64_t ulTimeNs );
+
+	/** Copies a sample into the state fields of a pose */
+	static void ApplyToPose( const MotionSample_t &sample, vr::DriverPose_t *pPose );
+
+	/** "key=value" lines: mode, amplitudes and the sample at ulTimeNs */
+	void FormatSummary( uint64_t ulTimeNs, char *pchBuffer, uint32_t unBufferSize );
+
+	enum
+	{
+		Channel_X, Channel_Y, Channel_Z,
+		Channel_Yaw, Channel_Pitch, Channel_Roll,
+		Channel_Count
+	};
+
+private:
+	// value and its first two time derivatives
+	struct ChannelState_t
+	{
+		double flValue;
+		double flRate;
+		double flAcceleration;
+	};
+
+	struct Keyframe_t
+	{
+		double flSeconds;
+		double rflValues[ Channel_Count ];
+		double rflTangents[ Channel_Count ];	// per second
+		bool operator<( const Keyframe_t &other ) const { return flSeconds < other.flSeconds; }
+	};
+
+	ChannelState_t SampleSweep( uint32_t unChannel, double flSeconds ) const;
+	ChannelState_t SampleSpline( uint32_t unChannel, double flSeconds ) const;
+	ChannelState_t SampleScript( uint32_t unChannel, double flSeconds ) const;
+	// the walk integrates step by step; the state at the start of ulStep
+	struct WalkState_t
+	{
+		uint64_t ulStep;
+		double rflValue[ Channel_Count ];
+		double rflRate[ Channel_Count ];
+	};
+
+	ChannelState_t SampleWalk( const WalkState_t &walk, uint32_t unChannel, double flSeconds ) const;
+
+	/** Back to rest at step 0, with no checkpoints */
+	void ResetWalk();
+	/** Integrates pWalk up to the start of ulStep; touches nothing shared */
+	void IntegrateWalk( WalkState_t *pWalk, uint64_t ulStep ) const;
+	/** Integrates m_walk up to ulStep, checkpointing on the way; m_walkMutex must be held */
+	void AdvanceWalk( uint64_t ulStep );
+	/** The latest state at or before ulStep that is still known, else the rest state; m_walkMutex must be held */
+	WalkState_t FindWalkCheckpoint( uint64_t ulStep ) const;
+	double GetWalkAcceleration( uint32_t unChannel, uint64_t ulStep, double flValue, double flRate ) const;
+
+	/** Uniform in [-1, 1), a pure function of the seed, the channel and ulIndex */
+	double GetRandom( uint32_t unChannel, uint64_t ulIndex ) const;
+
+	MotionConfig_t m_config;
+	double m_rflAmplitude[ Channel_Count ];		// meters or radians
+	double m_rflFrequency[ Channel_Count ];		// Hz
+	double m_rflPhase[ Channel_Count ];			// radians
+	double m_rflBase[3];						// position the motion is centred on
+
+	std::vector<Keyframe_t> m_vecKeyframes;
+
+	// newest walk state, plus one every k_unWalkCheckpointSteps so a sample further back
+	// integrates from nearby rather than from the start
+	enum { k_unWalkCheckpoints = 64 };
+	std::mutex m_walkMutex;
+	WalkState_t m_walk;
+	WalkState_t m_rWalkCheckpoints[ k_unWalkCheckpoints ];
+};
+
+
+#endif // MOTIONGENERATOR_H
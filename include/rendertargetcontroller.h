@@ -0,0 +1,57 @@
+#ifndef RENDERTARGETCONTROLLER_H
+#define RENDERTARGETCONTROLLER_H
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+#include <frametimingcollector.h>
+
+// --------------------------------------------------------------------------
+// Purpose: Picks the recommended render target size from measured frame
+//			timing. GPU time near the frame budget or reprojected frames scale
+//			the target down straight away; it only scales back up after two
+//			calm readings in a row. Each reading covers only frames rendered
+//			at the current size that no earlier reading has seen, so two
+//			readings are independent evidence.
+// --------------------------------------------------------------------------
+class CRenderTargetController
+{
+public:
+	CRenderTargetController();
+
+	void Configure( uint32_t unBaseWidth, uint32_t unBaseHeight, float flMinScale, float flMaxScale );
+
+	/** Frames after this index were rendered at the current size and not yet read */
+	uint32_t GetLastReadFrameIndex() const { return m_unLastReadFrameIndex; }
+
+	/** Feeds timing of frames since GetLastReadFrameIndex(); true when the size changed */
+	bool Update( const FrameTimingAggregates_t &aggregates, float flFrameBudgetMs );
+
+	uint32_t GetWidth() const { return m_unWidth; }
+	uint32_t GetHeight() const { return m_unHeight; }
+
+	void FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const;
+
+private:
+	bool SetScale( float flScale, uint32_t unLastFrameIndex );
+
+	uint32_t m_unBaseWidth;
+	uint32_t m_unBaseHeight;
+	float m_flMinScale;
+	float m_flMaxScale;
+
+	std::atomic<uint32_t> m_unWidth;
+	std::atomic<uint32_t> m_unHeight;
+	std::atomic<float> m_flScale;
+	std::atomic<float> m_flLastLoad;	// GPU p95 over the budget at the last decision
+	std::atomic<uint32_t> m_unScaleDowns;
+	std::atomic<uint32_t> m_unScaleUps;
+
+	uint32_t m_unLastReadFrameIndex;
+	uint32_t m_unCalmReadings;
+};
+
+
+#endif // RENDERTARGETCONTROLLER_H
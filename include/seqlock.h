@@ -0,0 +1,77 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+
+// --------------------------------------------------------------------------
+// Purpose: Latest-value cell for one writer and any number of readers. The
+//			writer never waits; readers retry while a write is in progress.
+//			The value is kept in atomic words so torn reads are detected rather
+//			than undefined.
+// --------------------------------------------------------------------------
+template < typename T >
+class CSeqLock
+{
+	static_assert( std::is_trivially_copyable<T>::value, "CSeqLock needs a trivially copyable type" );
+
+public:
+	CSeqLock() : m_unSequence( 0 )
+	{
+		for ( uint32_t i = 0; i < k_unWords; i++ )
+		{
+			m_rulWords[i].store( 0, std::memory_order_relaxed );
+		}
+	}
+
+	void Store( const T &value )
+	{
+		uint64_t rulWords[ k_unWords ] = {};
+		memcpy( rulWords, &value, sizeof( T ) );
+
+		uint32_t unSequence = m_unSequence.load( std::memory_order_relaxed );
+		m_unSequence.store( unSequence + 1, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_release );
+		for ( uint32_t i = 0; i < k_unWords; i++ )
+		{
+			m_rulWords[i].store( rulWords[i], std::memory_order_relaxed );
+		}
+		m_unSequence.store( unSequence + 2, std::memory_order_release );
+	}
+
+	T Load() const
+	{
+		uint64_t rulWords[ k_unWords ];
+		uint32_t unBefore, unAfter;
+		do
+		{
+			unBefore = m_unSequence.load( std::memory_order_acquire );
+			for ( uint32_t i = 0; i < k_unWords; i++ )
+			{
+				rulWords[i] = m_rulWords[i].load( std::memory_order_relaxed );
+			}
+			std::atomic_thread_fence( std::memory_order_acquire );
+			unAfter = m_unSequence.load( std::memory_order_relaxed );
+		} while ( ( unBefore & 1 ) || unBefore != unAfter );
+
+		T value;
+		memcpy( &value, rulWords, sizeof( T ) );
+		return value;
+	}
+
+	/** Number of completed writes */
+	uint32_t GetVersion() const { return m_unSequence.load( std::memory_order_acquire ) / 2; }
+
+private:
+	static const uint32_t k_unWords = ( sizeof( T ) + sizeof( uint64_t ) - 1 ) / sizeof( uint64_t );
+
+	std::atomic<uint32_t> m_unSequence;
+	std::atomic<uint64_t> m_rulWords[ k_unWords ];
+};
+
+
+#endif // SEQLOCK_H
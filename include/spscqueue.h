@@ -0,0 +1,57 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// --------------------------------------------------------------------------
+// Purpose: Bounded single-producer single-consumer ring. Push and pop are wait
+//			free; a full queue rejects the push instead of blocking the producer.
+//			unCapacity must be a power of two.
+// --------------------------------------------------------------------------
+template < typename T, uint32_t unCapacity >
+class CSpscQueue
+{
+	static_assert( ( unCapacity & ( unCapacity - 1 ) ) == 0, "capacity must be a power of two" );
+
+public:
+	CSpscQueue() : m_ulHead( 0 ), m_ulTail( 0 ) {}
+
+	bool TryPush( const T &item )
+	{
+		uint64_t ulTail = m_ulTail.load( std::memory_order_relaxed );
+		if ( ulTail - m_ulHead.load( std::memory_order_acquire ) >= unCapacity )
+			return false;
+
+		m_items[ ulTail & ( unCapacity - 1 ) ] = item;
+		m_ulTail.store( ulTail + 1, std::memory_order_release );
+		return true;
+	}
+
+	bool TryPop( T *pItem )
+	{
+		uint64_t ulHead = m_ulHead.load( std::memory_order_relaxed );
+		if ( ulHead == m_ulTail.load( std::memory_order_acquire ) )
+			return false;
+
+		*pItem = m_items[ ulHead & ( unCapacity - 1 ) ];
+		m_ulHead.store( ulHead + 1, std::memory_order_release );
+		return true;
+	}
+
+	bool IsEmpty() const
+	{
+		return m_ulHead.load( std::memory_order_acquire ) == m_ulTail.load( std::memory_order_acquire );
+	}
+
+private:
+	// producer and consumer indices live on separate cache lines so they do not bounce
+	alignas( 64 ) std::atomic<uint64_t> m_ulHead;
+	alignas( 64 ) std::atomic<uint64_t> m_ulTail;
+	alignas( 64 ) T m_items[ unCapacity ];
+};
+
+
+#endif // SPSCQUEUE_H
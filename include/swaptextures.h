@@ -0,0 +1,117 @@
+#ifndef SWAPTEXTURES_H
+#define SWAPTEXTURES_H
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+#include <openvr_driver.h>
+
+// --------------------------------------------------------------------------
+// Purpose: CPU view of one swap texture
+// --------------------------------------------------------------------------
+struct SwapTextureMemory_t
+{
+	void *pData;
+	uint64_t ulSize;
+	uint32_t unWidth;
+	uint32_t unHeight;
+	uint32_t unFormat;
+	uint32_t unBytesPerPixel;
+	uint32_t unRowPitch;
+	int nFd;	// memfd; other processes map it through /proc/<driver pid>/fd/<nFd>
+};
+
+
+// --------------------------------------------------------------------------
+// Purpose: Swap texture sets backed by memfd shared memory instead of GPU
+//			textures. Handles encode a slot index and a generation, so lookup
+//			is O(1) and stale handles are rejected. Memory a client frees is
+//			recycled only for that client's next set of the same size, since
+//			the client may still have it mapped; memory of a client that is
+//			going away is unmapped.
+// --------------------------------------------------------------------------
+class CSwapTextureSetPool
+{
+public:
+	static const uint32_t k_unTexturesPerSet = 3;
+
+	CSwapTextureSetPool();
+	~CSwapTextureSetPool();
+
+	bool CreateSet( uint32_t unPid, const vr::IVRDriverDirectModeComponent::SwapTextureSetDesc_t &desc, vr::IVRDriverDirectModeComponent::SwapTextureSet_t *pOutSet );
+
+	/** Any of the set's handles identifies the set */
+	void DestroySet( vr::SharedTextureHandle_t hTexture );
+	void DestroyAllSets( uint32_t unPid );
+
+	/** Advances the set owning hTexture and returns the index to render into next, or -1 for an unknown handle */
+	int32_t AdvanceSet( vr::SharedTextureHandle_t hTexture );
+
+	/** Maps a handle back to its memory; false for unknown or stale handles */
+	bool GetTextureMemory( vr::SharedTextureHandle_t hTexture, SwapTextureMemory_t *pMemory ) const;
+
+	/** GetTextureMemory() for a reader that outlives the lock: the memory stays mapped until
+		UnpinTexture(), even if its set is destroyed in the meantime */
+	bool PinTexture( vr::SharedTextureHandle_t hTexture, SwapTextureMemory_t *pMemory );
+	void UnpinTexture( const SwapTextureMemory_t &memory );
+
+	void FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const;
+
+private:
+	struct Texture_t
+	{
+		SwapTextureMemory_t memory;
+		uint32_t unGeneration;
+		uint32_t unSet;
+		bool bInUse;
+	};
+
+	struct Set_t
+	{
+		uint32_t unPid;
+		uint32_t runTextures[ k_unTexturesPerSet ];
+		uint32_t unNextIndex;
+		bool bInUse;
+	};
+
+	static uint32_t BytesPerPixel( uint32_t unFormat );
+	static vr::SharedTextureHandle_t MakeHandle( uint32_t unSlot, uint32_t unGeneration );
+
+	// callers hold m_mutex
+	Texture_t *LookupTexture( vr::SharedTextureHandle_t hTexture );
+	const Texture_t *LookupTexture( vr::SharedTextureHandle_t hTexture ) const;
+	bool AllocateMemory( uint32_t unPid, uint64_t ulSize, SwapTextureMemory_t *pMemory );
+	void ReleaseMemory( uint32_t unPid, const SwapTextureMemory_t &memory, bool bRecycle );
+	void DestroySetLocked( uint32_t unSet, bool bRecycle );
+
+	mutable std::mutex m_mutex;
+	std::vector<Texture_t> m_vecTextures;
+	std::vector<uint32_t> m_vecFreeTextures;
+	std::vector<Set_t> m_vecSets;
+	std::vector<uint32_t> m_vecFreeSets;
+	std::unordered_map< uint32_t, std::vector<uint32_t> > m_mapSetsByPid;
+
+	struct Recycled_t
+	{
+		SwapTextureMemory_t memory;
+		uint32_t unPid;		// the only client it may go back to
+	};
+
+	// released memory kept mapped for reuse, oldest first
+	std::vector<Recycled_t> m_vecRecycled;
+
+	// pin counts by mapping, and memory whose set was destroyed while pinned; unmapped at the last unpin
+	std::unordered_map< void *, uint32_t > m_mapPins;
+	std::vector<SwapTextureMemory_t> m_vecOrphaned;
+
+	uint64_t m_ulLiveBytes;
+	uint64_t m_ulCreatedTextures;
+	uint64_t m_ulRecycledTextures;
+};
+
+
+#endif // SWAPTEXTURES_H
@@ -0,0 +1,104 @@
+#ifndef VSYNCTIMELINE_H
+#define VSYNCTIMELINE_H
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// --------------------------------------------------------------------------
+// Purpose: Current CLOCK_MONOTONIC time in nanoseconds. Every timestamp the
+//			display path produces or consumes is on this clock.
+// --------------------------------------------------------------------------
+extern uint64_t GetMonotonicNs();
+
+// --------------------------------------------------------------------------
+// Purpose: Blocks until the monotonic clock reaches ulDeadlineNs. Sleeps on an
+//			absolute deadline and busy-waits for the final ulSpinNs to hide
+//			scheduler wakeup latency. Returns immediately if the deadline passed.
+// --------------------------------------------------------------------------
+extern void SleepUntilNs( uint64_t ulDeadlineNs, uint64_t ulSpinNs = 0 );
+
+
+// --------------------------------------------------------------------------
+// Purpose: Phase-locked vsync clock of the virtual display. Vsync n happens at
+//			epoch + ( n - epochFrame ) * period, so the phase reported to the
+//			compositor and the frame counter come from the same timeline.
+//			Retime() re-anchors the epoch on the last vsync so the counter stays
+//			continuous across refresh rate changes. Readers never block; they
+//			retry if a retime raced with them.
+// --------------------------------------------------------------------------
+class CVsyncTimeline
+{
+public:
+	CVsyncTimeline();
+
+	/** Anchors vsync 0 at the current time and sets the refresh rate */
+	void Start( double flFrequencyHz );
+
+	/** Switches to a new refresh rate starting from the last vsync before ulNowNs */
+	void Retime( double flFrequencyHz, uint64_t ulNowNs );
+
+	/** Nanoseconds between two vsyncs */
+	uint64_t GetPeriodNs() const { return m_ulPeriodNs.load( std::memory_order_relaxed ); }
+
+	/** Index of the last vsync at or before ulNowNs */
+	uint64_t GetFrameAt( uint64_t ulNowNs ) const;
+
+	/** Index of the vsync closest to ulTimeNs */
+	uint64_t GetFrameNearest( uint64_t ulTimeNs ) const;
+
+	/** Monotonic time of vsync ulFrame */
+	uint64_t GetVsyncTimeNs( uint64_t ulFrame ) const;
+
+	/** Returns the index of the last vsync at or before ulNowNs and the time elapsed since it */
+	uint64_t Sample( uint64_t ulNowNs, uint64_t *pulNsSinceVsync ) const;
+
+private:
+	struct Anchor_t
+	{
+		uint64_t ulEpochNs;
+		uint64_t ulEpochFrame;
+		uint64_t ulPeriodNs;
+	};
+
+	Anchor_t LoadAnchor() const;
+	void StoreAnchor( const Anchor_t &anchor );
+
+	static uint64_t FrameAt( const Anchor_t &anchor, uint64_t ulNowNs );
+	static uint64_t VsyncTimeNs( const Anchor_t &anchor, uint64_t ulFrame );
+	static uint64_t PeriodFromFrequency( double flFrequencyHz );
+
+	std::atomic<uint32_t> m_unSequence;
+	std::atomic<uint64_t> m_ulEpochNs;
+	std::atomic<uint64_t> m_ulEpochFrame;
+	std::atomic<uint64_t> m_ulPeriodNs;
+};
+
+
+// --------------------------------------------------------------------------
+// Purpose: Running statistics of how late a periodic thread woke up relative to
+//			its deadline. Written by a single thread, readable from any thread.
+// --------------------------------------------------------------------------
+class CTickJitterStats
+{
+public:
+	CTickJitterStats() { Reset(); }
+
+	void Reset();
+	void AddSample( uint64_t ulLatenessNs );
+
+	uint64_t GetCount() const { return m_ulCount.load( std::memory_order_relaxed ); }
+	uint64_t GetMaxNs() const { return m_ulMaxNs.load( std::memory_order_relaxed ); }
+	double GetMeanNs() const;
+	double GetStdDevNs() const;
+
+private:
+	std::atomic<uint64_t> m_ulCount;
+	std::atomic<uint64_t> m_ulMaxNs;
+	std::atomic<double> m_flSumNs;
+	std::atomic<double> m_flSumSqNs;
+};
+
+
+#endif // VSYNCTIMELINE_H
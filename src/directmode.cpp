@@ -0,0 +1,281 @@
+#include <directmode.h>
+#include <driverlog.h>
+#include <vsynctimeline.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+
+// pid the benchmark allocates under; never a real process
+static const uint32_t k_unBenchmarkPid = 0xffffffffu;
+
+// VK_FORMAT_R8G8B8A8_SRGB
+static const uint32_t k_unBenchmarkFormat = 43;
+
+// with motion smoothing enabled, this many drops in the last 32 frames halves the frame rate;
+// it goes back up after a run of frames without a drop
+static const uint32_t k_unDropsToHalveRate = 4;
+static const uint32_t k_unCleanFramesToRestoreRate = 32;
+
+CSampleDirectModeComponent::CSampleDirectModeComponent( CDriverProfile &profile, IDirectModeDisplay &display )
+	: m_profile( profile ), m_display( display )
+{
+	m_ulCompositedFrames = 0;
+	m_ulRejectedLayers = 0;
+	m_unPinnedCount = 0;
+	m_ulTargetFrame = 0;
+	m_unNumMisPresented = 0;
+	m_unNumDroppedFrames = 0;
+	m_unRecentDrops = 0;
+	m_unFramesSinceDrop = 0;
+	m_unFrameInterval = 1;
+	m_unReprojectionFlags = 0;
+	m_ulMisPresentedFrames = 0;
+	m_ulDroppedFrames = 0;
+}
+
+void CSampleDirectModeComponent::Start( uint32_t unEyeWidth, uint32_t unEyeHeight, uint32_t unThreads )
+{
+	m_compositor.SetEyeSize( unEyeWidth, unEyeHeight );
+	m_compositor.Start( unThreads );
+	DriverLog( "driver_null: Compositor: %ux%u per eye, %u threads, %s kernel\n", unEyeWidth, unEyeHeight,
+		m_compositor.GetThreadCount(), CLayerCompositor::GetKernelName( m_compositor.GetKernel() ) );
+}
+
+void CSampleDirectModeComponent::Stop()
+{
+	m_compositor.Stop();
+	UnpinLayers();
+}
+
+void CSampleDirectModeComponent::UnpinLayers()
+{
+	for ( uint32_t i = 0; i < m_unPinnedCount; i++ )
+	{
+		m_swapTextures.UnpinTexture( m_rPinned[i] );
+	}
+	m_unPinnedCount = 0;
+}
+
+void CSampleDirectModeComponent::CreateSwapTextureSet( uint32_t unPid, const SwapTextureSetDesc_t *pSwapTextureSetDesc, SwapTextureSet_t *pOutSwapTextureSet )
+{
+	CScopedDriverProfile profile( m_profile, EntryPoint_CreateSwapTextureSet );
+
+	memset( pOutSwapTextureSet, 0, sizeof( *pOutSwapTextureSet ) );
+	if ( !m_swapTextures.CreateSet( unPid, *pSwapTextureSetDesc, pOutSwapTextureSet ) )
+	{
+		DriverLog( "CreateSwapTextureSet failed for pid %u (%ux%u format %u)\n", unPid,
+			pSwapTextureSetDesc->nWidth, pSwapTextureSetDesc->nHeight, pSwapTextureSetDesc->nFormat );
+	}
+}
+
+void CSampleDirectModeComponent::DestroySwapTextureSet( vr::SharedTextureHandle_t sharedTextureHandle )
+{
+	CScopedDriverProfile profile( m_profile, EntryPoint_DestroySwapTextureSet );
+	m_swapTextures.DestroySet( sharedTextureHandle );
+}
+
+void CSampleDirectModeComponent::DestroyAllSwapTextureSets( uint32_t unPid )
+{
+	CScopedDriverProfile profile( m_profile, EntryPoint_DestroySwapTextureSet );
+	m_swapTextures.DestroyAllSets( unPid );
+}
+
+void CSampleDirectModeComponent::GetNextSwapTextureSetIndex( vr::SharedTextureHandle_t sharedTextureHandles[ 2 ], uint32_t( *pIndices )[ 2 ] )
+{
+	CScopedDriverProfile profile( m_profile, EntryPoint_GetNextSwapTextureSetIndex );
+
+	for ( uint32_t unEye = 0; unEye < 2; unEye++ )
+	{
+		int32_t nIndex = m_swapTextures.AdvanceSet( sharedTextureHandles[ unEye ] );
+		( *pIndices )[ unEye ] = nIndex < 0 ? 0 : (uint32_t)nIndex;
+	}
+}
+
+void CSampleDirectModeComponent::SubmitLayer( const SubmitLayerPerEye_t( &perEye )[ 2 ] )
+{
+	CScopedDriverProfile profile( m_profile, EntryPoint_SubmitLayer );
+
+	if ( m_unPinnedCount + 2 > CLayerCompositor::k_unMaxLayers * 2 )
+	{
+		FrameDriverLog( "SubmitLayer: layer dropped (%u layers queued)\n", m_compositor.GetLayerCount() );
+		m_ulRejectedLayers++;
+		return;
+	}
+
+	// the textures stay pinned until Present() has composited them
+	SwapTextureMemory_t rMemory[2];
+	vr::VRTextureBounds_t rBounds[2];
+	for ( uint32_t unEye = 0; unEye < 2; unEye++ )
+	{
+		if ( !m_swapTextures.PinTexture( perEye[ unEye ].hTexture, &rMemory[ unEye ] ) )
+		{
+			FrameDriverLog( "SubmitLayer: unknown texture %llx\n", (unsigned long long)perEye[ unEye ].hTexture );
+			if ( unEye == 1 )
+				m_swapTextures.UnpinTexture( rMemory[0] );
+			m_ulRejectedLayers++;
+			return;
+		}
+		rBounds[ unEye ] = perEye[ unEye ].bounds;
+	}
+
+	if ( !m_compositor.AddLayer( rMemory, rBounds ) )
+	{
+		FrameDriverLog( "SubmitLayer: layer dropped (format %u, %u layers queued)\n", rMemory[0].unFormat, m_compositor.GetLayerCount() );
+		m_swapTextures.UnpinTexture( rMemory[0] );
+		m_swapTextures.UnpinTexture( rMemory[1] );
+		m_ulRejectedLayers++;
+		return;
+	}
+	m_rPinned[ m_unPinnedCount++ ] = rMemory[0];
+	m_rPinned[ m_unPinnedCount++ ] = rMemory[1];
+}
+
+void CSampleDirectModeComponent::Present( vr::SharedTextureHandle_t /* syncTexture */ )
+{
+	// the display's own Present below is a nested sample and is not counted twice
+	CScopedDriverProfile profile( m_profile, EntryPoint_Composite );
+	m_compositor.Composite();
+	UnpinLayers();
+	m_ulCompositedFrames++;
+
+	// the frame is due the configured number of vsyncs after the previous one
+	uint32_t unFrameInterval = m_unFrameInterval;
+	uint64_t ulPredictedFrame = m_ulTargetFrame ? m_ulTargetFrame + unFrameInterval : 0;
+	uint64_t ulTargetFrame = m_display.PresentDirectModeFrame( ulPredictedFrame );
+
+	m_unNumMisPresented = ulPredictedFrame && ulTargetFrame != ulPredictedFrame ? 1 : 0;
+	m_unNumDroppedFrames = ulPredictedFrame && ulTargetFrame > ulPredictedFrame ? (uint32_t)( ulTargetFrame - ulPredictedFrame ) : 0;
+	m_unRecentDrops = ( m_unRecentDrops << 1 ) | ( m_unNumDroppedFrames ? 1 : 0 );
+	m_unFramesSinceDrop = m_unNumDroppedFrames ? 0 : m_unFramesSinceDrop + 1;
+	m_ulMisPresentedFrames += m_unNumMisPresented;
+	m_ulDroppedFrames += m_unNumDroppedFrames;
+	m_ulTargetFrame = ulTargetFrame;
+}
+
+void CSampleDirectModeComponent::PostPresent()
+{
+	// the runtime starts on the next frame once we return, so hold it until the frame scans out
+	m_display.WaitForDirectModeFrame();
+}
+
+void CSampleDirectModeComponent::GetFrameTiming( vr::DriverDirectMode_FrameTiming *pFrameTiming )
+{
+	uint32_t unSize = pFrameTiming->m_nSize;
+	if ( unSize > sizeof( vr::DriverDirectMode_FrameTiming ) )
+		unSize = sizeof( vr::DriverDirectMode_FrameTiming );
+
+	// the reprojection flags come in from the runtime; older runtimes may not send them
+	uint32_t unReprojectionFlags = 0;
+	if ( unSize >= offsetof( vr::DriverDirectMode_FrameTiming, m_nReprojectionFlags ) + sizeof( uint32_t ) )
+		unReprojectionFlags = pFrameTiming->m_nReprojectionFlags;
+	UpdatePacing( unReprojectionFlags );
+
+	uint64_t ulLastScanout = m_display.GetLastScanoutFrame();
+
+	vr::DriverDirectMode_FrameTiming timing;
+	timing.m_nSize = pFrameTiming->m_nSize;
+	timing.m_nNumFramePresents = m_ulTargetFrame && ulLastScanout >= m_ulTargetFrame ? (uint32_t)( ulLastScanout - m_ulTargetFrame + 1 ) : 0;
+	timing.m_nNumMisPresented = m_unNumMisPresented;
+	timing.m_nNumDroppedFrames = m_unNumDroppedFrames;
+	timing.m_nReprojectionFlags = unReprojectionFlags;
+	memcpy( pFrameTiming, &timing, unSize );
+}
+
+void CSampleDirectModeComponent::UpdatePacing( uint32_t unReprojectionFlags )
+{
+	uint32_t unFrameInterval = m_unFrameInterval;
+	uint32_t unRecentDrops = (uint32_t)__builtin_popcount( m_unRecentDrops );
+
+	if ( unReprojectionFlags & ( vr::VRCompositor_ReprojectionMotion_AppThrottled | vr::VRCompositor_ReprojectionMotion_ForcedOn ) )
+	{
+		// the runtime reprojects every other frame anyway; presenting at half rate keeps the cadence even
+		unFrameInterval = 2;
+	}
+	else if ( unReprojectionFlags & vr::VRCompositor_ReprojectionMotion_Enabled )
+	{
+		if ( unRecentDrops >= k_unDropsToHalveRate )
+			unFrameInterval = 2;
+		else if ( m_unFramesSinceDrop >= k_unCleanFramesToRestoreRate )
+			unFrameInterval = 1;
+	}
+	else
+	{
+		unFrameInterval = 1;
+	}
+
+	if ( unFrameInterval != m_unFrameInterval )
+	{
+		DriverLog( "driver_null: Direct mode pacing: every %u vsyncs (reprojection flags 0x%x, %u recent drops)\n",
+			unFrameInterval, unReprojectionFlags, unRecentDrops );
+		m_unFrameInterval = unFrameInterval;
+
+		// start the drop history over so a rate change needs fresh evidence
+		m_unRecentDrops = 0;
+		m_unFramesSinceDrop = 0;
+	}
+	m_unReprojectionFlags = unReprojectionFlags;
+}
+
+void CSampleDirectModeComponent::FormatTimingSummary( char *pchBuffer, uint32_t unBufferSize ) const
+{
+	snprintf( pchBuffer, unBufferSize, "frames=%llu mis_presented=%llu dropped=%llu frame_interval=%u reprojection_flags=0x%x\n",
+		(unsigned long long)m_ulCompositedFrames.load(), (unsigned long long)m_ulMisPresentedFrames.load(),
+		(unsigned long long)m_ulDroppedFrames.load(), m_unFrameInterval.load(), m_unReprojectionFlags.load() );
+}
+
+void CSampleDirectModeComponent::FormatCompositorSummary( char *pchBuffer, uint32_t unBufferSize ) const
+{
+	snprintf( pchBuffer, unBufferSize, "kernel=%s threads=%u frames=%llu rejected_layers=%llu\n",
+		CLayerCompositor::GetKernelName( m_compositor.GetKernel() ), m_compositor.GetThreadCount(),
+		(unsigned long long)m_ulCompositedFrames.load(), (unsigned long long)m_ulRejectedLayers.load() );
+}
+
+void CSampleDirectModeComponent::RunSwapSetBenchmark( uint32_t unWidth, uint32_t unHeight, uint32_t unFrames, char *pchBuffer, uint32_t unBufferSize )
+{
+	SwapTextureSetDesc_t desc;
+	desc.nWidth = unWidth;
+	desc.nHeight = unHeight;
+	desc.nFormat = k_unBenchmarkFormat;
+	desc.nSampleCount = 1;
+
+	// the first pair maps fresh memory, the second pair reuses it
+	uint64_t rulCreateNs[2];
+	uint64_t ulFrameNs = 0;
+	for ( uint32_t unPass = 0; unPass < 2; unPass++ )
+	{
+		SwapTextureSet_t rSets[2];
+		uint64_t ulStartNs = GetMonotonicNs();
+		CreateSwapTextureSet( k_unBenchmarkPid, &desc, &rSets[0] );
+		CreateSwapTextureSet( k_unBenchmarkPid, &desc, &rSets[1] );
+		rulCreateNs[ unPass ] = GetMonotonicNs() - ulStartNs;
+
+		if ( rSets[0].rSharedTextureHandles[0] == 0 || rSets[1].rSharedTextureHandles[0] == 0 )
+		{
+			DestroyAllSwapTextureSets( k_unBenchmarkPid );
+			snprintf( pchBuffer, unBufferSize, "swap set allocation failed for %ux%u\n", unWidth, unHeight );
+			return;
+		}
+
+		if ( unPass == 1 )
+		{
+			vr::SharedTextureHandle_t rhTextures[2] = { rSets[0].rSharedTextureHandles[0], rSets[1].rSharedTextureHandles[0] };
+			uint32_t runIndices[2];
+			ulStartNs = GetMonotonicNs();
+			for ( uint32_t i = 0; i < unFrames; i++ )
+			{
+				GetNextSwapTextureSetIndex( rhTextures, &runIndices );
+			}
+			ulFrameNs = GetMonotonicNs() - ulStartNs;
+		}
+
+		// destroyed one by one like a client resizing, so the second pass can reuse the memory
+		DestroySwapTextureSet( rSets[0].rSharedTextureHandles[0] );
+		DestroySwapTextureSet( rSets[1].rSharedTextureHandles[0] );
+	}
+	DestroyAllSwapTextureSets( k_unBenchmarkPid );
+
+	snprintf( pchBuffer, unBufferSize, "size=%ux%u frames=%u next_index_ns=%.1f create_pair_us fresh=%.1f recycled=%.1f\n",
+		unWidth, unHeight, unFrames, unFrames ? (double)ulFrameNs / unFrames : 0.0,
+		rulCreateNs[0] / 1000.0, rulCreateNs[1] / 1000.0 );
+}
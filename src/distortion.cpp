@@ -0,0 +1,641 @@
+#include <distortion.h>
+#include <driverlog.h>
+#include <vsynctimeline.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <string>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#define DISTORTION_X86
+#include <immintrin.h>
+#elif defined( __aarch64__ )
+#define DISTORTION_NEON
+#include <arm_neon.h>
+#endif
+
+// batch benchmark points are evaluated in blocks that stay in the cache, like a mesh row would
+static const uint32_t k_unBenchmarkBlock = 4096;
+
+typedef void ( *PfnBatchKernel )( const CLensModel::EyeTerms_t &terms, const float *pflU, const float *pflV, uint32_t unCount,
+	float *const rpflOutU[3], float *const rpflOutV[3] );
+
+// --------------------------------------------------------------------------
+// Scalar kernel, also used for single points and for the tails of the
+// vector kernels. The vector kernels repeat its operations in the same order.
+// --------------------------------------------------------------------------
+static inline void EvaluatePoint( const CLensModel::EyeTerms_t &terms, float fU, float fV, float ( &rrflUV )[ LensChannel_Count ][2] )
+{
+	float x = ( fU - terms.flCentreU ) * terms.flLensScaleU;
+	float y = ( fV - terms.flCentreV ) * 2.f;
+	float xx = x * x;
+	float yy = y * y;
+	float xy = x * y;
+	float r2 = xx + yy;
+
+	float flTwoP1 = terms.flTangentialP1 * 2.f;
+	float flTwoP2 = terms.flTangentialP2 * 2.f;
+	float flTangentialX = flTwoP1 * xy + terms.flTangentialP2 * ( r2 + 2.f * xx );
+	float flTangentialY = terms.flTangentialP1 * ( r2 + 2.f * yy ) + flTwoP2 * xy;
+
+	for ( uint32_t unChannel = 0; unChannel < LensChannel_Count; unChannel++ )
+	{
+		const float *k = terms.rrflRadial[ unChannel ];
+		float flRadial = 1.f + r2 * ( k[0] + r2 * ( k[1] + r2 * k[2] ) );
+		rrflUV[ unChannel ][0] = terms.flCentreU + ( x * flRadial + flTangentialX ) * terms.flTextureScaleU;
+		rrflUV[ unChannel ][1] = terms.flCentreV + ( y * flRadial + flTangentialY ) * terms.flTextureScaleV;
+	}
+}
+
+static void EvaluateRange( const CLensModel::EyeTerms_t &terms, const float *pflU, const float *pflV, uint32_t unBegin, uint32_t unEnd,
+	float *const rpflOutU[3], float *const rpflOutV[3] )
+{
+	for ( uint32_t i = unBegin; i < unEnd; i++ )
+	{
+		float rrflUV[ LensChannel_Count ][2];
+		EvaluatePoint( terms, pflU[i], pflV[i], rrflUV );
+		for ( uint32_t unChannel = 0; unChannel < LensChannel_Count; unChannel++ )
+		{
+			rpflOutU[ unChannel ][i] = rrflUV[ unChannel ][0];
+			rpflOutV[ unChannel ][i] = rrflUV[ unChannel ][1];
+		}
+	}
+}
+
+static void EvaluateBatchScalar( const CLensModel::EyeTerms_t &terms, const float *pflU, const float *pflV, uint32_t unCount,
+	float *const rpflOutU[3], float *const rpflOutV[3] )
+{
+	EvaluateRange( terms, pflU, pflV, 0, unCount, rpflOutU, rpflOutV );
+}
+
+#if defined( DISTORTION_X86 )
+// --------------------------------------------------------------------------
+// AVX2 kernel, eight points at a time. Separate multiplies and adds rather
+// than FMA keep the rounding identical to the scalar kernel.
+// --------------------------------------------------------------------------
+__attribute__(( target( "avx2" ) ))
+static void EvaluateBatchAvx2( const CLensModel::EyeTerms_t &terms, const float *pflU, const float *pflV, uint32_t unCount,
+	float *const rpflOutU[3], float *const rpflOutV[3] )
+{
+	const __m256 centreU = _mm256_set1_ps( terms.flCentreU );
+	const __m256 centreV = _mm256_set1_ps( terms.flCentreV );
+	const __m256 lensScaleU = _mm256_set1_ps( terms.flLensScaleU );
+	const __m256 two = _mm256_set1_ps( 2.f );
+	const __m256 one = _mm256_set1_ps( 1.f );
+	const __m256 p1 = _mm256_set1_ps( terms.flTangentialP1 );
+	const __m256 p2 = _mm256_set1_ps( terms.flTangentialP2 );
+	const __m256 twoP1 = _mm256_set1_ps( terms.flTangentialP1 * 2.f );
+	const __m256 twoP2 = _mm256_set1_ps( terms.flTangentialP2 * 2.f );
+	const __m256 textureScaleU = _mm256_set1_ps( terms.flTextureScaleU );
+	const __m256 textureScaleV = _mm256_set1_ps( terms.flTextureScaleV );
+
+	uint32_t i = 0;
+	for ( ; i + 8 <= unCount; i += 8 )
+	{
+		__m256 x = _mm256_mul_ps( _mm256_sub_ps( _mm256_loadu_ps( pflU + i ), centreU ), lensScaleU );
+		__m256 y = _mm256_mul_ps( _mm256_sub_ps( _mm256_loadu_ps( pflV + i ), centreV ), two );
+		__m256 xx = _mm256_mul_ps( x, x );
+		__m256 yy = _mm256_mul_ps( y, y );
+		__m256 xy = _mm256_mul_ps( x, y );
+		__m256 r2 = _mm256_add_ps( xx, yy );
+
+		__m256 tangentialX = _mm256_add_ps( _mm256_mul_ps( twoP1, xy ), _mm256_mul_ps( p2, _mm256_add_ps( r2, _mm256_mul_ps( two, xx ) ) ) );
+		__m256 tangentialY = _mm256_add_ps( _mm256_mul_ps( p1, _mm256_add_ps( r2, _mm256_mul_ps( two, yy ) ) ), _mm256_mul_ps( twoP2, xy ) );
+
+		for ( uint32_t unChannel = 0; unChannel < LensChannel_Count; unChannel++ )
+		{
+			const float *k = terms.rrflRadial[ unChannel ];
+			__m256 radial = _mm256_add_ps( _mm256_set1_ps( k[1] ), _mm256_mul_ps( r2, _mm256_set1_ps( k[2] ) ) );
+			radial = _mm256_add_ps( _mm256_set1_ps( k[0] ), _mm256_mul_ps( r2, radial ) );
+			radial = _mm256_add_ps( one, _mm256_mul_ps( r2, radial ) );
+
+			__m256 outU = _mm256_add_ps( centreU, _mm256_mul_ps( _mm256_add_ps( _mm256_mul_ps( x, radial ), tangentialX ), textureScaleU ) );
+			__m256 outV = _mm256_add_ps( centreV, _mm256_mul_ps( _mm256_add_ps( _mm256_mul_ps( y, radial ), tangentialY ), textureScaleV ) );
+			_mm256_storeu_ps( rpflOutU[ unChannel ] + i, outU );
+			_mm256_storeu_ps( rpflOutV[ unChannel ] + i, outV );
+		}
+	}
+	EvaluateRange( terms, pflU, pflV, i, unCount, rpflOutU, rpflOutV );
+}
+#endif
+
+#if defined( DISTORTION_NEON )
+// --------------------------------------------------------------------------
+// NEON kernel, four points at a time, in the scalar kernel's operation order
+// --------------------------------------------------------------------------
+static void EvaluateBatchNeon( const CLensModel::EyeTerms_t &terms, const float *pflU, const float *pflV, uint32_t unCount,
+	float *const rpflOutU[3], float *const rpflOutV[3] )
+{
+	const float32x4_t centreU = vdupq_n_f32( terms.flCentreU );
+	const float32x4_t centreV = vdupq_n_f32( terms.flCentreV );
+	const float32x4_t lensScaleU = vdupq_n_f32( terms.flLensScaleU );
+	const float32x4_t two = vdupq_n_f32( 2.f );
+	const float32x4_t one = vdupq_n_f32( 1.f );
+	const float32x4_t p1 = vdupq_n_f32( terms.flTangentialP1 );
+	const float32x4_t p2 = vdupq_n_f32( terms.flTangentialP2 );
+	const float32x4_t twoP1 = vdupq_n_f32( terms.flTangentialP1 * 2.f );
+	const float32x4_t twoP2 = vdupq_n_f32( terms.flTangentialP2 * 2.f );
+	const float32x4_t textureScaleU = vdupq_n_f32( terms.flTextureScaleU );
+	const float32x4_t textureScaleV = vdupq_n_f32( terms.flTextureScaleV );
+
+	uint32_t i = 0;
+	for ( ; i + 4 <= unCount; i += 4 )
+	{
+		float32x4_t x = vmulq_f32( vsubq_f32( vld1q_f32( pflU + i ), centreU ), lensScaleU );
+		float32x4_t y = vmulq_f32( vsubq_f32( vld1q_f32( pflV + i ), centreV ), two );
+		float32x4_t xx = vmulq_f32( x, x );
+		float32x4_t yy = vmulq_f32( y, y );
+		float32x4_t xy = vmulq_f32( x, y );
+		float32x4_t r2 = vaddq_f32( xx, yy );
+
+		float32x4_t tangentialX = vaddq_f32( vmulq_f32( twoP1, xy ), vmulq_f32( p2, vaddq_f32( r2, vmulq_f32( two, xx ) ) ) );
+		float32x4_t tangentialY = vaddq_f32( vmulq_f32( p1, vaddq_f32( r2, vmulq_f32( two, yy ) ) ), vmulq_f32( twoP2, xy ) );
+
+		for ( uint32_t unChannel = 0; unChannel < LensChannel_Count; unChannel++ )
+		{
+			const float *k = terms.rrflRadial[ unChannel ];
+			float32x4_t radial = vaddq_f32( vdupq_n_f32( k[1] ), vmulq_f32( r2, vdupq_n_f32( k[2] ) ) );
+			radial = vaddq_f32( vdupq_n_f32( k[0] ), vmulq_f32( r2, radial ) );
+			radial = vaddq_f32( one, vmulq_f32( r2, radial ) );
+
+			float32x4_t outU = vaddq_f32( centreU, vmulq_f32( vaddq_f32( vmulq_f32( x, radial ), tangentialX ), textureScaleU ) );
+			float32x4_t outV = vaddq_f32( centreV, vmulq_f32( vaddq_f32( vmulq_f32( y, radial ), tangentialY ), textureScaleV ) );
+			vst1q_f32( rpflOutU[ unChannel ] + i, outU );
+			vst1q_f32( rpflOutV[ unChannel ] + i, outV );
+		}
+	}
+	EvaluateRange( terms, pflU, pflV, i, unCount, rpflOutU, rpflOutV );
+}
+#endif
+
+static PfnBatchKernel GetBatchKernel( EDistortionKernel eKernel )
+{
+	switch ( eKernel )
+	{
+#if defined( DISTORTION_X86 )
+	case DistortionKernel_Avx2:
+		return EvaluateBatchAvx2;
+#endif
+#if defined( DISTORTION_NEON )
+	case DistortionKernel_Neon:
+		return EvaluateBatchNeon;
+#endif
+	default:
+		return EvaluateBatchScalar;
+	}
+}
+
+
+void IDistortionModel::EvaluateBatch( vr::EVREye eEye, const float *pflU, const float *pflV, uint32_t unCount,
+	float *const rpflOutU[3], float *const rpflOutV[3] ) const
+{
+	for ( uint32_t i = 0; i < unCount; i++ )
+	{
+		vr::DistortionCoordinates_t coordinates = Evaluate( eEye, pflU[i], pflV[i] );
+		rpflOutU[ LensChannel_Red ][i] = coordinates.rfRed[0];
+		rpflOutV[ LensChannel_Red ][i] = coordinates.rfRed[1];
+		rpflOutU[ LensChannel_Green ][i] = coordinates.rfGreen[0];
+		rpflOutV[ LensChannel_Green ][i] = coordinates.rfGreen[1];
+		rpflOutU[ LensChannel_Blue ][i] = coordinates.rfBlue[0];
+		rpflOutV[ LensChannel_Blue ][i] = coordinates.rfBlue[1];
+	}
+}
+
+
+bool CLensModel::IsKernelSupported( EDistortionKernel eKernel )
+{
+	switch ( eKernel )
+	{
+	case DistortionKernel_Scalar:
+		return true;
+#if defined( DISTORTION_X86 )
+	case DistortionKernel_Avx2:
+		return __builtin_cpu_supports( "avx2" );
+#endif
+#if defined( DISTORTION_NEON )
+	case DistortionKernel_Neon:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+const char *CLensModel::GetKernelName( EDistortionKernel eKernel )
+{
+	switch ( eKernel )
+	{
+	case DistortionKernel_Scalar:	return "scalar";
+	case DistortionKernel_Avx2:		return "avx2";
+	case DistortionKernel_Neon:		return "neon";
+	default:						return "unknown";
+	}
+}
+
+CLensModel::CLensModel()
+{
+	m_eKernel = DistortionKernel_Scalar;
+	for ( uint32_t i = 0; i < DistortionKernel_Count; i++ )
+	{
+		if ( IsKernelSupported( (EDistortionKernel)i ) )
+			m_eKernel = (EDistortionKernel)i;
+	}
+
+	LensConfig_t config;
+	GetDefaultConfig( &config );
+	Configure( config );
+}
+
+void CLensModel::GetDefaultConfig( LensConfig_t *pConfig )
+{
+	memset( pConfig, 0, sizeof( *pConfig ) );
+	for ( uint32_t unEye = 0; unEye < 2; unEye++ )
+	{
+		pConfig->rrflCentre[ unEye ][0] = 0.5f;
+		pConfig->rrflCentre[ unEye ][1] = 0.5f;
+	}
+	pConfig->flAspect = 1.f;
+	pConfig->flScale = 1.f;
+}
+
+void CLensModel::Configure( const LensConfig_t &config )
+{
+	m_config = config;
+	if ( !( m_config.flAspect > 0.f ) )
+		m_config.flAspect = 1.f;
+
+	m_flScale = m_config.flScale;
+	if ( !( m_flScale > 0.f ) )
+	{
+		const float *pflGreen = m_config.rrflRadial[ LensChannel_Green ];
+		float flEdge = 1.f + pflGreen[0] + pflGreen[1] + pflGreen[2];
+		m_flScale = flEdge > 0.f ? 1.f / flEdge : 1.f;
+	}
+
+	for ( uint32_t unEye = 0; unEye < 2; unEye++ )
+	{
+		EyeTerms_t &terms = m_rEyeTerms[ unEye ];
+		terms.flCentreU = m_config.rrflCentre[ unEye ][0];
+		terms.flCentreV = m_config.rrflCentre[ unEye ][1];
+		terms.flLensScaleU = 2.f * m_config.flAspect;
+		terms.flTangentialP1 = m_config.flTangentialP1;
+
+		// the right lens is the left one mirrored, which flips the sign of the horizontal decentring
+		terms.flTangentialP2 = unEye == 0 ? m_config.flTangentialP2 : -m_config.flTangentialP2;
+		terms.flTextureScaleU = m_flScale / ( 2.f * m_config.flAspect );
+		terms.flTextureScaleV = m_flScale / 2.f;
+		memcpy( terms.rrflRadial, m_config.rrflRadial, sizeof( terms.rrflRadial ) );
+	}
+}
+
+void CLensModel::GetCentre( vr::EVREye eEye, float *pfU, float *pfV ) const
+{
+	const EyeTerms_t &terms = GetEyeTerms( eEye );
+	*pfU = terms.flCentreU;
+	*pfV = terms.flCentreV;
+}
+
+vr::DistortionCoordinates_t CLensModel::Evaluate( vr::EVREye eEye, float fU, float fV ) const
+{
+	float rrflUV[ LensChannel_Count ][2];
+	EvaluatePoint( GetEyeTerms( eEye ), fU, fV, rrflUV );
+
+	vr::DistortionCoordinates_t coordinates;
+	coordinates.rfRed[0] = rrflUV[ LensChannel_Red ][0];
+	coordinates.rfRed[1] = rrflUV[ LensChannel_Red ][1];
+	coordinates.rfGreen[0] = rrflUV[ LensChannel_Green ][0];
+	coordinates.rfGreen[1] = rrflUV[ LensChannel_Green ][1];
+	coordinates.rfBlue[0] = rrflUV[ LensChannel_Blue ][0];
+	coordinates.rfBlue[1] = rrflUV[ LensChannel_Blue ][1];
+	return coordinates;
+}
+
+void CLensModel::EvaluateBatch( vr::EVREye eEye, const float *pflU, const float *pflV, uint32_t unCount,
+	float *const rpflOutU[3], float *const rpflOutV[3] ) const
+{
+	GetBatchKernel( m_eKernel )( GetEyeTerms( eEye ), pflU, pflV, unCount, rpflOutU, rpflOutV );
+}
+
+void CLensModel::RunBatchBenchmark( uint32_t unSamples, char *pchBuffer, uint32_t unBufferSize ) const
+{
+	// golden ratio steps cover the viewport evenly without a pattern the cache would like
+	std::vector<float> vecU( k_unBenchmarkBlock );
+	std::vector<float> vecV( k_unBenchmarkBlock );
+	for ( uint32_t i = 0; i < k_unBenchmarkBlock; i++ )
+	{
+		vecU[i] = fmodf( i * 0.6180339887f, 1.f );
+		vecV[i] = fmodf( i * 0.7548776662f, 1.f );
+	}
+
+	// six output arrays per kernel, the scalar ones are the reference
+	std::vector<float> rvecOut[ DistortionKernel_Count ][6];
+	uint32_t unBlocks = std::max( ( unSamples + k_unBenchmarkBlock - 1 ) / k_unBenchmarkBlock, 1u );
+	uint32_t unUsed = snprintf( pchBuffer, unBufferSize, "samples=%u block=%u\n", unBlocks * k_unBenchmarkBlock, k_unBenchmarkBlock );
+	for ( uint32_t unKernel = 0; unKernel < DistortionKernel_Count && unUsed < unBufferSize; unKernel++ )
+	{
+		EDistortionKernel eKernel = (EDistortionKernel)unKernel;
+		if ( !IsKernelSupported( eKernel ) )
+			continue;
+
+		float *rpflOutU[3];
+		float *rpflOutV[3];
+		for ( uint32_t unChannel = 0; unChannel < LensChannel_Count; unChannel++ )
+		{
+			rvecOut[ unKernel ][ unChannel * 2 ].resize( k_unBenchmarkBlock );
+			rvecOut[ unKernel ][ unChannel * 2 + 1 ].resize( k_unBenchmarkBlock );
+			rpflOutU[ unChannel ] = rvecOut[ unKernel ][ unChannel * 2 ].data();
+			rpflOutV[ unChannel ] = rvecOut[ unKernel ][ unChannel * 2 + 1 ].data();
+		}
+
+		// alternate the eyes so both sets of terms are exercised; the last block is a left eye one for the comparison
+		PfnBatchKernel pfnKernel = GetBatchKernel( eKernel );
+		uint64_t ulStartNs = GetMonotonicNs();
+		for ( uint32_t unBlock = 0; unBlock < unBlocks; unBlock++ )
+		{
+			vr::EVREye eEye = ( ( unBlocks - 1 - unBlock ) & 1 ) ? vr::Eye_Right : vr::Eye_Left;
+			pfnKernel( GetEyeTerms( eEye ), vecU.data(), vecV.data(), k_unBenchmarkBlock, rpflOutU, rpflOutV );
+		}
+		double flSeconds = ( GetMonotonicNs() - ulStartNs ) / 1e9;
+
+		float flMaxDifference = 0.f;
+		for ( uint32_t unArray = 0; unArray < 6; unArray++ )
+		{
+			for ( uint32_t i = 0; i < k_unBenchmarkBlock; i++ )
+				flMaxDifference = std::max( flMaxDifference, fabsf( rvecOut[ unKernel ][ unArray ][i] - rvecOut[ DistortionKernel_Scalar ][ unArray ][i] ) );
+		}
+
+		double flSamples = (double)unBlocks * k_unBenchmarkBlock;
+		int nWritten = snprintf( pchBuffer + unUsed, unBufferSize - unUsed, "kernel=%s ns_per_sample=%.2f msamples_per_s=%.1f max_diff=%g\n",
+			GetKernelName( eKernel ), flSeconds * 1e9 / flSamples, flSamples / flSeconds / 1e6, flMaxDifference );
+		if ( nWritten > 0 )
+			unUsed += (uint32_t)nWritten;
+	}
+}
+
+
+// FNV-1a taken a 64 bit word at a time, which keeps checking a large mesh well under its read time
+static uint64_t ChecksumMeshWords( uint64_t ulHash, const void *pData, uint64_t ulBytes )
+{
+	const uint8_t *pubData = (const uint8_t *)pData;
+	for ( uint64_t i = 0; i + sizeof( uint64_t ) <= ulBytes; i += sizeof( uint64_t ) )
+	{
+		uint64_t ulWord;
+		memcpy( &ulWord, pubData + i, sizeof( ulWord ) );
+		ulHash = ( ulHash ^ ulWord ) * 0x100000001b3ull;
+	}
+	return ulHash;
+}
+
+static const uint64_t k_ulChecksumBasis = 0xcbf29ce484222325ull;
+
+// pMapping is a whole mesh file whose header is already validated
+static bool MeshChecksumMatches( const void *pMapping, uint64_t ulSize )
+{
+	const DistortionMeshHeader_t *pHeader = (const DistortionMeshHeader_t *)pMapping;
+	return ChecksumMeshWords( k_ulChecksumBasis, (const uint8_t *)pMapping + pHeader->unHeaderSize, ulSize - pHeader->unHeaderSize ) == pHeader->ulChecksum;
+}
+
+
+CDistortionGrid::CDistortionGrid()
+{
+	m_unCells = 0;
+	m_rpNodes[0] = nullptr;
+	m_rpNodes[1] = nullptr;
+	m_pMapping = nullptr;
+	m_ulMappingSize = 0;
+	m_bChecksumPending = false;
+}
+
+CDistortionGrid::~CDistortionGrid()
+{
+	Unmap();
+}
+
+void CDistortionGrid::Unmap()
+{
+	if ( m_pMapping )
+		munmap( m_pMapping, m_ulMappingSize );
+	m_pMapping = nullptr;
+	m_ulMappingSize = 0;
+	m_bChecksumPending = false;
+}
+
+void CDistortionGrid::Build( const IDistortionModel &model, uint32_t unCells )
+{
+	Unmap();
+
+	// a row of nodes is one batch; the model writes each channel's coordinates to its own array
+	uint32_t unNodes = unCells + 1;
+	std::vector<float> vecU( unNodes );
+	std::vector<float> vecV( unNodes );
+	std::vector<float> vecOut( unNodes * 6 );
+	float *rpflOutU[3] = { &vecOut[0], &vecOut[ unNodes * 2 ], &vecOut[ unNodes * 4 ] };
+	float *rpflOutV[3] = { &vecOut[ unNodes ], &vecOut[ unNodes * 3 ], &vecOut[ unNodes * 5 ] };
+	for ( uint32_t x = 0; x < unNodes; x++ )
+	{
+		vecU[x] = (float)x / unCells;
+	}
+
+	for ( uint32_t unEye = 0; unEye < 2; unEye++ )
+	{
+		vr::EVREye eEye = unEye == 0 ? vr::Eye_Left : vr::Eye_Right;
+		std::vector<Node_t> &vecNodes = m_rvecNodes[ unEye ];
+		vecNodes.resize( unNodes * unNodes );
+		for ( uint32_t y = 0; y < unNodes; y++ )
+		{
+			std::fill( vecV.begin(), vecV.end(), (float)y / unCells );
+			model.EvaluateBatch( eEye, vecU.data(), vecV.data(), unNodes, rpflOutU, rpflOutV );
+			for ( uint32_t x = 0; x < unNodes; x++ )
+			{
+				Node_t &node = vecNodes[ y * unNodes + x ];
+				for ( uint32_t unChannel = 0; unChannel < LensChannel_Count; unChannel++ )
+				{
+					node.rflUV[ unChannel * 2 ] = rpflOutU[ unChannel ][x];
+					node.rflUV[ unChannel * 2 + 1 ] = rpflOutV[ unChannel ][x];
+				}
+			}
+		}
+		m_rpNodes[ unEye ] = vecNodes.data();
+	}
+	m_unCells = unCells;
+}
+
+bool CDistortionGrid::Load( const char *pchPath )
+{
+	int nFd = open( pchPath, O_RDONLY | O_CLOEXEC );
+	if ( nFd < 0 )
+	{
+		DriverLog( "driver_null: Distortion mesh %s: cannot open\n", pchPath );
+		return false;
+	}
+
+	struct stat fileStat;
+	if ( fstat( nFd, &fileStat ) != 0 || (uint64_t)fileStat.st_size < sizeof( DistortionMeshHeader_t ) )
+	{
+		DriverLog( "driver_null: Distortion mesh %s: too short for a header\n", pchPath );
+		close( nFd );
+		return false;
+	}
+
+	// the mapping outlives the descriptor
+	uint64_t ulSize = (uint64_t)fileStat.st_size;
+	void *pMapping = mmap( nullptr, ulSize, PROT_READ, MAP_PRIVATE, nFd, 0 );
+	close( nFd );
+	if ( pMapping == MAP_FAILED )
+	{
+		DriverLog( "driver_null: Distortion mesh %s: mmap failed\n", pchPath );
+		return false;
+	}
+
+	const DistortionMeshHeader_t *pHeader = (const DistortionMeshHeader_t *)pMapping;
+	uint64_t ulEyeBytes = (uint64_t)( pHeader->unCells + 1 ) * ( pHeader->unCells + 1 ) * sizeof( Node_t );
+	const char *pchError = nullptr;
+	if ( pHeader->unMagic != k_unDistortionMeshMagic )
+		pchError = "not a distortion mesh";
+	else if ( pHeader->unVersion != k_unDistortionMeshVersion )
+		pchError = "unsupported version";
+	else if ( pHeader->unHeaderSize < sizeof( DistortionMeshHeader_t ) || pHeader->unHeaderSize > ulSize || ( ulSize - pHeader->unHeaderSize ) % sizeof( uint64_t ) != 0 )
+		pchError = "bad header size";
+	else if ( pHeader->unCells == 0 || pHeader->unCells > k_unDistortionMeshMaxCells || pHeader->unChannels != LensChannel_Count )
+		pchError = "bad grid dimensions";
+
+	for ( uint32_t unEye = 0; unEye < 2 && !pchError; unEye++ )
+	{
+		uint64_t ulOffset = pHeader->rulEyeOffset[ unEye ];
+		if ( ulOffset < pHeader->unHeaderSize || ulOffset % sizeof( float ) != 0 || ulOffset > ulSize || ulSize - ulOffset < ulEyeBytes )
+			pchError = "eye nodes outside the file";
+	}
+
+	// reading every node costs about as much as the file is large, so only small files pay for it here
+	bool bChecksumPending = ulSize > k_ulDistortionMeshVerifyBytes;
+	if ( !pchError && !bChecksumPending && !MeshChecksumMatches( pMapping, ulSize ) )
+		pchError = "checksum mismatch";
+
+	if ( pchError )
+	{
+		DriverLog( "driver_null: Distortion mesh %s: %s\n", pchPath, pchError );
+		munmap( pMapping, ulSize );
+		return false;
+	}
+
+	Unmap();
+	for ( uint32_t unEye = 0; unEye < 2; unEye++ )
+	{
+		std::vector<Node_t>().swap( m_rvecNodes[ unEye ] );
+		m_rpNodes[ unEye ] = (const Node_t *)( (const uint8_t *)pMapping + pHeader->rulEyeOffset[ unEye ] );
+	}
+	m_pMapping = pMapping;
+	m_ulMappingSize = ulSize;
+	m_bChecksumPending = bChecksumPending;
+	m_unCells = pHeader->unCells;
+	return true;
+}
+
+bool CDistortionGrid::VerifyChecksum() const
+{
+	if ( !m_pMapping )
+		return true;
+
+	return MeshChecksumMatches( m_pMapping, m_ulMappingSize );
+}
+
+bool CDistortionGrid::Save( const char *pchPath ) const
+{
+	if ( !IsValid() )
+		return false;
+
+	uint64_t ulEyeBytes = (uint64_t)( m_unCells + 1 ) * ( m_unCells + 1 ) * sizeof( Node_t );
+	DistortionMeshHeader_t header;
+	memset( &header, 0, sizeof( header ) );
+	header.unMagic = k_unDistortionMeshMagic;
+	header.unVersion = k_unDistortionMeshVersion;
+	header.unHeaderSize = sizeof( header );
+	header.unCells = m_unCells;
+	header.unChannels = LensChannel_Count;
+	header.rulEyeOffset[0] = sizeof( header );
+	header.rulEyeOffset[1] = sizeof( header ) + ulEyeBytes;
+	header.ulChecksum = ChecksumMeshWords( ChecksumMeshWords( k_ulChecksumBasis, m_rpNodes[0], ulEyeBytes ), m_rpNodes[1], ulEyeBytes );
+
+	// written aside and renamed, so a driver starting meanwhile never maps half a file
+	std::string sTempPath = std::string( pchPath ) + ".tmp";
+	FILE *pFile = fopen( sTempPath.c_str(), "wb" );
+	if ( !pFile )
+		return false;
+
+	bool bWritten = fwrite( &header, sizeof( header ), 1, pFile ) == 1
+		&& fwrite( m_rpNodes[0], ulEyeBytes, 1, pFile ) == 1
+		&& fwrite( m_rpNodes[1], ulEyeBytes, 1, pFile ) == 1;
+	bWritten = fclose( pFile ) == 0 && bWritten;
+	if ( !bWritten || rename( sTempPath.c_str(), pchPath ) != 0 )
+	{
+		unlink( sTempPath.c_str() );
+		return false;
+	}
+	return true;
+}
+
+vr::DistortionCoordinates_t CDistortionGrid::Sample( vr::EVREye eEye, float fU, float fV ) const
+{
+	// outside the viewport the edge cells are extrapolated
+	float flX = fU * m_unCells;
+	float flY = fV * m_unCells;
+	int32_t nCell = (int32_t)m_unCells - 1;
+	int32_t nX = std::min( std::max( (int32_t)floorf( flX ), 0 ), nCell );
+	int32_t nY = std::min( std::max( (int32_t)floorf( flY ), 0 ), nCell );
+	float flFracX = flX - nX;
+	float flFracY = flY - nY;
+
+	uint32_t unNodes = m_unCells + 1;
+	const Node_t *pRow = &m_rpNodes[ eEye == vr::Eye_Left ? 0 : 1 ][ nY * unNodes + nX ];
+	const Node_t &n00 = pRow[0];
+	const Node_t &n10 = pRow[1];
+	const Node_t &n01 = pRow[ unNodes ];
+	const Node_t &n11 = pRow[ unNodes + 1 ];
+
+	float rflUV[6];
+	for ( uint32_t i = 0; i < 6; i++ )
+	{
+		float flTop = n00.rflUV[i] + ( n10.rflUV[i] - n00.rflUV[i] ) * flFracX;
+		float flBottom = n01.rflUV[i] + ( n11.rflUV[i] - n01.rflUV[i] ) * flFracX;
+		rflUV[i] = flTop + ( flBottom - flTop ) * flFracY;
+	}
+
+	vr::DistortionCoordinates_t coordinates;
+	coordinates.rfRed[0] = rflUV[0];
+	coordinates.rfRed[1] = rflUV[1];
+	coordinates.rfGreen[0] = rflUV[2];
+	coordinates.rfGreen[1] = rflUV[3];
+	coordinates.rfBlue[0] = rflUV[4];
+	coordinates.rfBlue[1] = rflUV[5];
+	return coordinates;
+}
+
+float CDistortionGrid::MeasureMaxError( const IDistortionModel &model ) const
+{
+	float flMaxError = 0.f;
+	for ( uint32_t unEye = 0; unEye < 2 && IsValid(); unEye++ )
+	{
+		vr::EVREye eEye = unEye == 0 ? vr::Eye_Left : vr::Eye_Right;
+		for ( uint32_t y = 0; y < m_unCells; y++ )
+		{
+			for ( uint32_t x = 0; x < m_unCells; x++ )
+			{
+				float fU = ( x + 0.5f ) / m_unCells;
+				float fV = ( y + 0.5f ) / m_unCells;
+				vr::DistortionCoordinates_t exact = model.Evaluate( eEye, fU, fV );
+				vr::DistortionCoordinates_t sampled = Sample( eEye, fU, fV );
+				flMaxError = std::max( flMaxError, hypotf( exact.rfRed[0] - sampled.rfRed[0], exact.rfRed[1] - sampled.rfRed[1] ) );
+				flMaxError = std::max( flMaxError, hypotf( exact.rfGreen[0] - sampled.rfGreen[0], exact.rfGreen[1] - sampled.rfGreen[1] ) );
+				flMaxError = std::max( flMaxError, hypotf( exact.rfBlue[0] - sampled.rfBlue[0], exact.rfBlue[1] - sampled.rfBlue[1] ) );
+			}
+		}
+	}
+	return flMaxError;
+}
@@ -2,13 +2,38 @@
 
 #include <openvr_driver.h>
 #include <driverlog.h>
+#include <vsynctimeline.h>
+#include <framestats.h>
+#include <driverprofile.h>
+#include <faultinjector.h>
+#include <framesink.h>
+#include <seqlock.h>
+#include <latencyestimator.h>
+#include <directmode.h>
+#include <frametimingcollector.h>
+#include <rendertargetcontroller.h>
+#include <distortion.h>
+#include <inversedistortion.h>
+#include <hiddenarea.h>
+#include <motiongenerator.h>
 
 #include <vector>
 #include <thread>
 #include <chrono>
 #include <random>
+#include <algorithm>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 
 #include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include <pthread.h>
+#include <sys/stat.h>
 
 #if defined(__GNUC__) || defined(COMPILER_GCC) || defined(__APPLE__)
 #define HMD_DLL_EXPORT extern "C" __attribute__((visibility("default")))
@@ -56,6 +81,108 @@ static const char * const k_pch_Test_RenderWidth_Int32 = "renderWidth";
 static const char * const k_pch_Test_RenderHeight_Int32 = "renderHeight";
 static const char * const k_pch_Test_SecondsFromVsyncToPhotons_Float = "secondsFromVsyncToPhotons";
 static const char * const k_pch_Test_DisplayFrequency_Float = "displayFrequency";
+static const char * const k_pch_Test_WaitSpinMicroseconds_Int32 = "waitSpinMicroseconds";
+static const char * const k_pch_Test_SupportedRefreshRates_String = "supportedRefreshRates";
+static const char * const k_pch_Test_StressMode_Bool = "stressMode";
+static const char * const k_pch_Test_StressFrequency_Float = "stressFrequency";
+static const char * const k_pch_Test_FaultInjection_Bool = "faultInjection";
+static const char * const k_pch_Test_FaultSeed_Int32 = "faultSeed";
+static const char * const k_pch_Test_FaultLateProbability_Float = "faultLateProbability";
+static const char * const k_pch_Test_FaultLateMicroseconds_Float = "faultLateMicroseconds";
+static const char * const k_pch_Test_FaultSkipProbability_Float = "faultSkipProbability";
+static const char * const k_pch_Test_FaultOverrunProbability_Float = "faultOverrunProbability";
+static const char * const k_pch_Test_FaultOverrunMicroseconds_Float = "faultOverrunMicroseconds";
+static const char * const k_pch_Test_FaultJitter_String = "faultJitter";
+static const char * const k_pch_Test_FaultJitterMicroseconds_Float = "faultJitterMicroseconds";
+static const char * const k_pch_Test_FaultScript_String = "faultScript";
+static const char * const k_pch_Test_FaultScriptLoopFrames_Int32 = "faultScriptLoopFrames";
+static const char * const k_pch_Test_FrameSinks_String = "frameSinks";
+static const char * const k_pch_Test_EncoderMicroseconds_Float = "encoderMicroseconds";
+static const char * const k_pch_Test_RecorderPath_String = "recorderPath";
+static const char * const k_pch_Test_DirectMode_Bool = "directMode";
+static const char * const k_pch_Test_CompositorThreads_Int32 = "compositorThreads";
+static const char * const k_pch_Test_FrameTimingPollMilliseconds_Int32 = "frameTimingPollMilliseconds";
+static const char * const k_pch_Test_DynamicResolution_Bool = "dynamicResolution";
+static const char * const k_pch_Test_RenderScaleMin_Float = "renderScaleMin";
+static const char * const k_pch_Test_RenderScaleMax_Float = "renderScaleMax";
+static const char * const k_pch_Test_RenderSupersample_Float = "renderSupersample";
+static const char * const k_pch_Test_DistortionGridCells_Int32 = "distortionGridCells";
+static const char * const k_pch_Test_DistortionMesh_String = "distortionMesh";
+static const char * const k_pch_Test_HiddenArea_Bool = "hiddenArea";
+static const char * const k_pch_Test_HiddenAreaVertexBudget_Int32 = "hiddenAreaVertexBudget";
+static const char * const k_pch_Test_HiddenAreaCacheDir_String = "hiddenAreaCacheDir";
+static const char * const k_pch_Test_LensApertureRadius_Float = "lensApertureRadius";
+static const char * const k_pch_Test_FovTangentsLeft_String = "fovTangentsLeft";
+static const char * const k_pch_Test_FovTangentsRight_String = "fovTangentsRight";
+static const char * const k_pch_Test_EyeCantDegrees_Float = "eyeCantDegrees";
+static const char * const k_pch_Test_PoseRateHz_Int32 = "poseRateHz";
+static const char * const k_pch_Test_MotionMode_String = "motionMode";
+static const char * const k_pch_Test_MotionSeed_Int32 = "motionSeed";
+static const char * const k_pch_Test_MotionPositionAmplitude_Float = "motionPositionAmplitude";
+static const char * const k_pch_Test_MotionRotationAmplitude_Float = "motionRotationAmplitude";
+static const char * const k_pch_Test_MotionFrequency_Float = "motionFrequency";
+static const char * const k_pch_Test_MotionScript_String = "motionScript";
+static const char * const k_pch_Test_MotionScriptLoop_Bool = "motionScriptLoop";
+static const char * const k_pch_Test_ControllerMotion_Bool = "controllerMotion";
+static const char * const k_pch_Test_DistortionRed_String = "distortionRed";
+static const char * const k_pch_Test_DistortionGreen_String = "distortionGreen";
+static const char * const k_pch_Test_DistortionBlue_String = "distortionBlue";
+static const char * const k_pch_Test_DistortionP1_Float = "distortionP1";
+static const char * const k_pch_Test_DistortionP2_Float = "distortionP2";
+static const char * const k_pch_Test_DistortionScale_Float = "distortionScale";
+static const char * const k_pch_Test_LensCenterLeft_String = "lensCenterLeft";
+static const char * const k_pch_Test_LensCenterRight_String = "lensCenterRight";
+
+static const char * const k_pchDefaultRefreshRates = "72,80,90,120,144";
+static const uint32_t k_unMaxRefreshRates = 32;
+
+// radial k1,k2,k3 per channel; blue bends more than red, like a single element lens
+static const char * const k_pchDefaultDistortionRed = "0.20,0.22,0";
+static const char * const k_pchDefaultDistortionGreen = "0.22,0.24,0";
+static const char * const k_pchDefaultDistortionBlue = "0.24,0.26,0";
+static const float k_flMaxDisplayFrequency = 1000.f;
+
+// how often the render target controller looks at the collected frame timing
+static const uint64_t k_ulRenderTargetUpdateNs = 250000000;
+
+// the pose thread's highest rate; 0 publishes from RunFrame instead
+static const int32_t k_nMaxPoseRateHz = 1000;
+
+// furthest past the next scan-out a present may target; anything later is taken as a bad vsync time
+static const uint64_t k_ulMaxPresentAheadFrames = 4;
+
+// bounds a run of injected skipped scan-outs so a skip probability of 1 cannot stall the display path
+static const uint32_t k_unMaxSkippedScanouts = 8;
+
+// settings readers that fall back to a default when the key is not set
+static float GetTestSettingFloat( const char *pchKey, float flDefault )
+{
+	vr::EVRSettingsError eError = vr::VRSettingsError_None;
+	float flValue = vr::VRSettings()->GetFloat( k_pch_Test_Section, pchKey, &eError );
+	return eError == vr::VRSettingsError_None ? flValue : flDefault;
+}
+
+static bool GetTestSettingBool( const char *pchKey, bool bDefault )
+{
+	vr::EVRSettingsError eError = vr::VRSettingsError_None;
+	bool bValue = vr::VRSettings()->GetBool( k_pch_Test_Section, pchKey, &eError );
+	return eError == vr::VRSettingsError_None ? bValue : bDefault;
+}
+
+static int32_t GetTestSettingInt32( const char *pchKey, int32_t nDefault )
+{
+	vr::EVRSettingsError eError = vr::VRSettingsError_None;
+	int32_t nValue = vr::VRSettings()->GetInt32( k_pch_Test_Section, pchKey, &eError );
+	return eError == vr::VRSettingsError_None ? nValue : nDefault;
+}
+
+static std::string GetTestSettingString( const char *pchKey, const char *pchDefault )
+{
+	char buf[1024];
+	vr::EVRSettingsError eError = vr::VRSettingsError_None;
+	vr::VRSettings()->GetString( k_pch_Test_Section, pchKey, buf, sizeof( buf ), &eError );
+	return eError == vr::VRSettingsError_None && buf[0] ? std::string( buf ) : std::string( pchDefault );
+}
 
 //-----------------------------------------------------------------------------
 // Purpose:
@@ -124,13 +251,65 @@ void CWatchdogDriver_Sample::Cleanup()
 	CleanupDriverLog();
 }
 
+// reads up to unMax comma separated floats, returns how many were read
+static uint32_t ParseFloatList( const char *pchList, float *pflValues, uint32_t unMax )
+{
+	uint32_t unCount = 0;
+	const char *pch = pchList;
+	while ( *pch && unCount < unMax )
+	{
+		char *pchEnd;
+		float flValue = strtof( pch, &pchEnd );
+		if ( pchEnd == pch )
+			break;
+		pflValues[ unCount++ ] = flValue;
+		pch = pchEnd;
+		while ( *pch == ',' || *pch == ' ' )
+			pch++;
+	}
+	return unCount;
+}
+
+// motion settings are shared by the head and the hand; the hand follows its own profile and the next seed
+static void ConfigureMotion( CMotionGenerator *pMotion, EMotionProfile eProfile )
+{
+	const char *pchDevice = eProfile == MotionProfile_Hand ? "Hand" : "Head";
+
+	MotionConfig_t config;
+	std::string sMode = GetTestSettingString( k_pch_Test_MotionMode_String, "still" );
+	config.eMode = CMotionGenerator::FindMode( sMode.c_str() );
+	if ( config.eMode == Motion_Count )
+	{
+		DriverLog( "driver_null: Unknown motion mode '%s', holding still\n", sMode.c_str() );
+		config.eMode = Motion_Still;
+	}
+	config.eProfile = eProfile;
+	config.ulSeed = (uint64_t)GetTestSettingInt32( k_pch_Test_MotionSeed_Int32, 0 ) + ( eProfile == MotionProfile_Hand ? 1 : 0 );
+	config.flPositionAmplitude = GetTestSettingFloat( k_pch_Test_MotionPositionAmplitude_Float, 0.05f );
+	config.flRotationAmplitude = GetTestSettingFloat( k_pch_Test_MotionRotationAmplitude_Float, 30.f );
+	config.flFrequency = GetTestSettingFloat( k_pch_Test_MotionFrequency_Float, 0.2f );
+	config.sScript = GetTestSettingString( k_pch_Test_MotionScript_String, "" );
+	config.bScriptLoop = GetTestSettingBool( k_pch_Test_MotionScriptLoop_Bool, true );
+
+	std::string sError;
+	if ( !pMotion->Configure( config, &sError ) )
+	{
+		DriverLog( "driver_null: Motion script rejected: %s\n", sError.c_str() );
+		config.eMode = Motion_Still;
+		config.sScript.clear();
+		pMotion->Configure( config, nullptr );
+	}
+	DriverLog( "driver_null: %s motion: %s\n", pchDevice, CMotionGenerator::GetModeName( pMotion->GetMode() ) );
+}
+
 //-----------------------------------------------------------------------------
 // Purpose:
 //-----------------------------------------------------------------------------
-class CSampleDeviceDriver : public vr::ITrackedDeviceServerDriver, public vr::IVRDisplayComponent, public vr::IVRVirtualDisplay
+class CSampleDeviceDriver : public vr::ITrackedDeviceServerDriver, public vr::IVRDisplayComponent, public vr::IVRVirtualDisplay, public IDirectModeDisplay
 {
 public:
 	CSampleDeviceDriver(  )
+		: m_directMode( m_profile, *this )
 	{
 		m_unObjectId = vr::k_unTrackedDeviceIndexInvalid;
 		m_ulPropertyContainer = vr::k_ulInvalidPropertyContainer;
@@ -152,22 +331,124 @@ public:
 		//m_nRenderHeight = vr::VRSettings()->GetInt32( k_pch_Test_Section, k_pch_Test_RenderHeight_Int32 );
 		m_nRenderWidth = m_nWindowWidth;
 		m_nRenderHeight = m_nWindowHeight;
-		//m_flSecondsFromVsyncToPhotons = vr::VRSettings()->GetFloat( k_pch_Test_Section, k_pch_Test_SecondsFromVsyncToPhotons_Float );
-		m_flSecondsFromVsyncToPhotons = 0.0005f;
-		//m_flDisplayFrequency = vr::VRSettings()->GetFloat( k_pch_Test_Section, k_pch_Test_DisplayFrequency_Float );
-		m_flDisplayFrequency = 90.0f;
+		float flSecondsFromVsyncToPhotons = GetTestSettingFloat( k_pch_Test_SecondsFromVsyncToPhotons_Float, 0.0005f );
+		float flDisplayFrequency = GetTestSettingFloat( k_pch_Test_DisplayFrequency_Float, 90.0f );
+		if ( !( flDisplayFrequency > 0.f ) || flDisplayFrequency > k_flMaxDisplayFrequency )
+			flDisplayFrequency = 90.0f;
+
+		// stress mode turns the display into a high-rate timing source for compositor throughput tests;
+		// build with DRIVER_STRESS_BUILD as well so the per-frame logging is gone too
+		m_bStressMode = GetTestSettingBool( k_pch_Test_StressMode_Bool, false );
+		if ( m_bStressMode )
+		{
+			float flStressFrequency = GetTestSettingFloat( k_pch_Test_StressFrequency_Float, k_flMaxDisplayFrequency );
+			if ( flStressFrequency > 0.f && flStressFrequency <= k_flMaxDisplayFrequency )
+				flDisplayFrequency = flStressFrequency;
+		}
+		m_flSecondsFromVsyncToPhotons = flSecondsFromVsyncToPhotons;
+		m_flDisplayFrequency = flDisplayFrequency;
+
+		// the panel lights up a fixed fraction of the way into each frame, so keep that
+		// fraction when the refresh rate changes
+		m_flVsyncToPhotonsFrames = flSecondsFromVsyncToPhotons * flDisplayFrequency;
+
+		ParseRefreshRates( GetTestSettingString( k_pch_Test_SupportedRefreshRates_String, k_pchDefaultRefreshRates ).c_str() );
+
+		m_vsyncTimeline.Start( flDisplayFrequency );
+		m_ulPresentTargetFrame = 0;
+		m_vSyncCounter = 0;
+		m_pScanoutThread = nullptr;
+		m_bScanoutRunning = false;
+		m_pPoseThread = nullptr;
+		m_bPoseThreadRunning = false;
+		m_ulPoseMissedTicks = 0;
+
+		// poses on a thread of their own, at a fixed rate rather than whenever RunFrame gets called
+		int32_t nPoseRateHz = GetTestSettingInt32( k_pch_Test_PoseRateHz_Int32, 0 );
+		m_unPoseRateHz = (uint32_t)std::min( std::max( nPoseRateHz, 0 ), k_nMaxPoseRateHz );
+
+		ConfigureMotion( &m_motion, MotionProfile_Head );
+		m_ulMotionStartNs = GetMonotonicNs();
+		m_eWaitVSync = vr::VSync_WaitRender;
+		for ( uint32_t i = 0; i < k_unVSyncModeCount; i++ )
+		{
+			m_rulPresentCount[i] = 0;
+		}
+		m_ulClampedPresents = 0;
+		m_ulFrameStartPoseFrames = 0;
+		m_ulLatestPoseFrames = 0;
+
+		int32_t nWaitSpinUs = GetTestSettingInt32( k_pch_Test_WaitSpinMicroseconds_Int32, 0 );
+		m_ulWaitSpinNs = nWaitSpinUs > 0 ? (uint64_t)nWaitSpinUs * 1000 : 0;
+
+		ConfigureFaultInjection();
+		ConfigureFrameSinks();
+
+		// direct mode replaces the virtual display; the runtime hands frames over as swap textures
+		m_bDirectMode = GetTestSettingBool( k_pch_Test_DirectMode_Bool, false );
+		m_ulDirectModeFrameId = 0;
+
+		// 0 turns the frame timing collector off
+		int32_t nFrameTimingPollMs = GetTestSettingInt32( k_pch_Test_FrameTimingPollMilliseconds_Int32, 100 );
+		m_unFrameTimingPollMs = nFrameTimingPollMs > 0 ? (uint32_t)nFrameTimingPollMs : 0;
+
+		// dynamic resolution runs on the collected frame timing
+		m_bDynamicResolution = GetTestSettingBool( k_pch_Test_DynamicResolution_Bool, false ) && m_unFrameTimingPollMs;
+		m_flRenderScaleMin = GetTestSettingFloat( k_pch_Test_RenderScaleMin_Float, 0.5f );
+		m_flRenderScaleMax = GetTestSettingFloat( k_pch_Test_RenderScaleMax_Float, 1.2f );
+		m_renderTarget.Configure( m_nRenderWidth, m_nRenderHeight, m_flRenderScaleMin, m_flRenderScaleMax );
+		m_ulNextRenderTargetUpdateNs = 0;
+
+		m_flRenderSupersample = GetTestSettingFloat( k_pch_Test_RenderSupersample_Float, 1.0f );
+		if ( !( m_flRenderSupersample >= 0.25f && m_flRenderSupersample <= 4.f ) )
+			m_flRenderSupersample = 1.0f;
+
+		ConfigureLensModel();
+		ConfigureProjection();
+
+		// 0 answers ComputeDistortion from the lens model directly
+		int32_t nDistortionGridCells = GetTestSettingInt32( k_pch_Test_DistortionGridCells_Int32, 64 );
+		m_unDistortionGridCells = (uint32_t)std::min( std::max( nDistortionGridCells, 0 ), 1024 );
+		m_ulDistortionGridBuildNs = 0;
+		m_pDistortionVerifyThread = nullptr;
+		m_bDistortionMeshRejected = false;
+
+		// a measured mesh file replaces the grid built from the lens model
+		m_sDistortionMesh = GetTestSettingString( k_pch_Test_DistortionMesh_String, "" );
+
+		// the aperture is in lens units, 1 being the top and bottom edges of the viewport; 0 hides only what falls outside the viewport
+		m_bHiddenArea = GetTestSettingBool( k_pch_Test_HiddenArea_Bool, true );
+		m_flLensApertureRadius = std::max( GetTestSettingFloat( k_pch_Test_LensApertureRadius_Float, 1.1f ), 0.f );
+		m_unHiddenAreaVertexBudget = (uint32_t)std::min( std::max( GetTestSettingInt32( k_pch_Test_HiddenAreaVertexBudget_Int32, 384 ), 48 ), 65536 );
+		m_sHiddenAreaCacheDir = GetTestSettingString( k_pch_Test_HiddenAreaCacheDir_String, "" );
+		m_ulHiddenAreaBuildNs = 0;
+		m_bHiddenAreaCached = false;
+
+		int32_t nCompositorThreads = GetTestSettingInt32( k_pch_Test_CompositorThreads_Int32, 0 );
+		m_unCompositorThreads = nCompositorThreads > 0 ? (uint32_t)nCompositorThreads : 0;
 
 		DriverLog( "driver_null: Serial Number: %s\n", m_sSerialNumber.c_str() );
 		DriverLog( "driver_null: Model Number: %s\n", m_sModelNumber.c_str() );
 		DriverLog( "driver_null: Window: %d %d %d %d\n", m_nWindowX, m_nWindowY, m_nWindowWidth, m_nWindowHeight );
 		DriverLog( "driver_null: Render Target: %d %d\n", m_nRenderWidth, m_nRenderHeight );
-		DriverLog( "driver_null: Seconds from Vsync to Photons: %f\n", m_flSecondsFromVsyncToPhotons );
-		DriverLog( "driver_null: Display Frequency: %f\n", m_flDisplayFrequency );
+		DriverLog( "driver_null: Seconds from Vsync to Photons: %f\n", m_flSecondsFromVsyncToPhotons.load() );
+		DriverLog( "driver_null: Display Frequency: %f\n", m_flDisplayFrequency.load() );
 		DriverLog( "driver_null: IPD: %f\n", m_flIPD );
+		DriverLog( "driver_null: Vsync wait spin: %llu ns\n", (unsigned long long)m_ulWaitSpinNs );
+		DriverLog( "driver_null: Stress mode: %s\n", m_bStressMode ? "on" : "off" );
+		DriverLog( "driver_null: Direct mode: %s\n", m_bDirectMode ? "on" : "off" );
+		DriverLog( "driver_null: Dynamic resolution: %s\n", m_bDynamicResolution ? "on" : "off" );
+		if ( m_unPoseRateHz )
+			DriverLog( "driver_null: Pose thread: %u Hz\n", m_unPoseRateHz );
+		else
+			DriverLog( "driver_null: Pose thread: off, poses follow RunFrame\n" );
 	}
 
 	virtual ~CSampleDeviceDriver()
 	{
+		StopPoseThread();
+		StopScanoutThread();
+		JoinDistortionVerifyThread();
 	}
 
 
@@ -182,8 +463,13 @@ public:
 		vr::VRProperties()->SetStringProperty( m_ulPropertyContainer, vr::Prop_RenderModelName_String, m_sModelNumber.c_str() );
 		vr::VRProperties()->SetFloatProperty( m_ulPropertyContainer, vr::Prop_UserIpdMeters_Float, m_flIPD );
 		vr::VRProperties()->SetFloatProperty( m_ulPropertyContainer, vr::Prop_UserHeadToEyeDepthMeters_Float, 0.f );
-		vr::VRProperties()->SetFloatProperty( m_ulPropertyContainer, vr::Prop_DisplayFrequency_Float, m_flDisplayFrequency );
-		vr::VRProperties()->SetFloatProperty( m_ulPropertyContainer, vr::Prop_SecondsFromVsyncToPhotons_Float, m_flSecondsFromVsyncToPhotons );
+		vr::VRProperties()->SetFloatProperty( m_ulPropertyContainer, vr::Prop_DisplayFrequency_Float, m_flDisplayFrequency.load() );
+		vr::VRProperties()->SetFloatProperty( m_ulPropertyContainer, vr::Prop_SecondsFromVsyncToPhotons_Float, m_flSecondsFromVsyncToPhotons.load() );
+		vr::VRProperties()->SetPropertyVector( m_ulPropertyContainer, vr::Prop_DisplayAvailableFrameRates_Float_Array, vr::k_unFloatPropertyTag, &m_vecRefreshRates );
+		vr::VRProperties()->SetBoolProperty( m_ulPropertyContainer, vr::Prop_DisplaySupportsMultipleFramerates_Bool, m_vecRefreshRates.size() > 1 );
+		vr::VRProperties()->SetBoolProperty( m_ulPropertyContainer, vr::Prop_DisplaySupportsRuntimeFramerateChange_Bool, true );
+		vr::VRProperties()->SetBoolProperty( m_ulPropertyContainer, vr::Prop_DriverDirectModeSendsVsyncEvents_Bool, m_bDirectMode );
+		PublishDisplayGeometry();
 
 		// return a constant that's not 0 (invalid) or 1 (reserved for Oculus)
 		vr::VRProperties()->SetUint64Property( m_ulPropertyContainer, vr::Prop_CurrentUniverseId_Uint64, 2 );
@@ -229,7 +515,23 @@ public:
 			vr::VRProperties()->SetStringProperty( m_ulPropertyContainer, vr::Prop_NamedIconPathDeviceAlertLow_String, "{sample}/icons/headset_sample_status_ready_low.png" );
 		}
 
-		srand(0);
+		BuildDistortionGrid();
+		m_inverseDistortion.Build( m_lensModel );
+		ComputeRecommendedRenderTargetSize();
+		if ( m_bHiddenArea )
+			PublishHiddenArea();
+
+		if ( m_bFaultInjection )
+			m_faultInjector.Enable( m_vsyncTimeline.GetFrameAt( GetMonotonicNs() ) );
+
+		StartScanoutThread();
+		if ( m_unPoseRateHz )
+			StartPoseThread();
+		m_frameSinks.Start();
+		if ( m_bDirectMode )
+			m_directMode.Start( m_nWindowWidth / 2, m_nWindowHeight, m_unCompositorThreads );
+		if ( m_unFrameTimingPollMs )
+			m_frameTimings.Start( m_unFrameTimingPollMs );
 
 		return vr::VRInitError_None;
 	}
@@ -237,6 +539,12 @@ public:
 	virtual void Deactivate() 
 	{
 		DriverLog("CSampleDeviceDriver::Deactivate() Called\n");
+		m_frameTimings.Stop();
+		m_directMode.Stop();
+		m_frameSinks.Stop();
+		StopPoseThread();
+		StopScanoutThread();
+		JoinDistortionVerifyThread();
 		m_unObjectId = vr::k_unTrackedDeviceIndexInvalid;
 	}
 
@@ -252,10 +560,14 @@ public:
 		{
 			return (vr::IVRDisplayComponent*)this;
 		}
-		if ( !strcmp( pchComponentNameAndVersion, vr::IVRVirtualDisplay_Version ) )
+		if ( !strcmp( pchComponentNameAndVersion, vr::IVRVirtualDisplay_Version ) && !m_bDirectMode )
 		{
 			return (vr::IVRVirtualDisplay*)this;
 		}
+		if ( !strcmp( pchComponentNameAndVersion, vr::IVRDriverDirectModeComponent_Version ) && m_bDirectMode )
+		{
+			return (vr::IVRDriverDirectModeComponent*)&m_directMode;
+		}
 
 		// override this to add a component to a driver
 		return NULL;
@@ -272,6 +584,225 @@ public:
 		DriverLog("CSampleDeviceDriver::DebugRequest() Called\n");
 		if( unResponseBufferSize >= 1 )
 			pchResponseBuffer[0] = 0;
+
+		if ( !strcmp( pchRequest, "framestats" ) )
+		{
+			m_frameStats.FormatSummary( pchResponseBuffer, unResponseBufferSize );
+		}
+		else if ( !strcmp( pchRequest, "vsync" ) )
+		{
+			snprintf( pchResponseBuffer, unResponseBufferSize,
+				"frequency=%.3f period_ns=%llu counter=%llu\n"
+				"scanout_jitter_us mean=%.1f stddev=%.1f max=%.1f\n"
+				"presents none=%llu wait_render=%llu no_wait_render=%llu clamped=%llu\n",
+				m_flDisplayFrequency.load(), (unsigned long long)m_vsyncTimeline.GetPeriodNs(), (unsigned long long)m_vSyncCounter.load(),
+				m_scanoutJitter.GetMeanNs() / 1000.0, m_scanoutJitter.GetStdDevNs() / 1000.0, m_scanoutJitter.GetMaxNs() / 1000.0,
+				(unsigned long long)m_rulPresentCount[ vr::VSync_None ].load(), (unsigned long long)m_rulPresentCount[ vr::VSync_WaitRender ].load(),
+				(unsigned long long)m_rulPresentCount[ vr::VSync_NoWaitRender ].load(), (unsigned long long)m_ulClampedPresents.load() );
+		}
+		else if ( !strcmp( pchRequest, "faults on" ) )
+		{
+			// scripted frame 0 is the next vsync
+			m_faultInjector.Enable( m_vsyncTimeline.GetFrameAt( GetMonotonicNs() ) + 1 );
+			m_faultInjector.FormatSummary( pchResponseBuffer, unResponseBufferSize );
+		}
+		else if ( !strcmp( pchRequest, "faults off" ) )
+		{
+			m_faultInjector.Disable();
+			m_faultInjector.FormatSummary( pchResponseBuffer, unResponseBufferSize );
+		}
+		else if ( !strcmp( pchRequest, "faults" ) )
+		{
+			m_faultInjector.FormatSummary( pchResponseBuffer, unResponseBufferSize );
+		}
+		else if ( !strcmp( pchRequest, "latency" ) )
+		{
+			// the pose a frame was rendered with is inferred, not reported by the runtime
+			int nUsed = snprintf( pchResponseBuffer, unResponseBufferSize, "pose_source=frame_start approximate=1 frame_start_frames=%llu newest_pose_frames=%llu\n",
+				(unsigned long long)m_ulFrameStartPoseFrames.load(), (unsigned long long)m_ulLatestPoseFrames.load() );
+			if ( nUsed >= 0 && (uint32_t)nUsed < unResponseBufferSize )
+				m_latency.FormatSummary( pchResponseBuffer + nUsed, unResponseBufferSize - (uint32_t)nUsed );
+		}
+		else if ( !strcmp( pchRequest, "sinks" ) )
+		{
+			m_frameSinks.FormatSummary( pchResponseBuffer, unResponseBufferSize );
+		}
+		else if ( !strcmp( pchRequest, "swapsets" ) )
+		{
+			m_directMode.GetSwapTextures().FormatSummary( pchResponseBuffer, unResponseBufferSize );
+		}
+		else if ( !strncmp( pchRequest, "swapsets bench", 14 ) )
+		{
+			// "swapsets bench [<width> <height> [<frames>]]", per eye
+			uint32_t unWidth = 2048, unHeight = 2048, unFrames = 100000;
+			sscanf( pchRequest + 14, "%u %u %u", &unWidth, &unHeight, &unFrames );
+			m_directMode.RunSwapSetBenchmark( unWidth, unHeight, unFrames, pchResponseBuffer, unResponseBufferSize );
+		}
+		else if ( !strcmp( pchRequest, "frametimings" ) )
+		{
+			m_frameTimings.FormatSummary( pchResponseBuffer, unResponseBufferSize );
+		}
+		else if ( !strcmp( pchRequest, "rendertarget" ) )
+		{
+			m_renderTarget.FormatSummary( pchResponseBuffer, unResponseBufferSize );
+		}
+		else if ( !strcmp( pchRequest, "distortion" ) )
+		{
+			snprintf( pchResponseBuffer, unResponseBufferSize, "grid_cells=%u source=%s build_ms=%.2f max_error=%g\n",
+				m_distortionGrid.GetCells(), m_bDistortionMeshRejected ? "rejected_mesh" : m_distortionGrid.IsMapped() ? "mesh" : "model", m_ulDistortionGridBuildNs / 1e6, m_distortionGrid.MeasureMaxError( m_lensModel ) );
+		}
+		else if ( !strcmp( pchRequest, "distortion verify" ) )
+		{
+			// the full mesh checksum, which Load leaves out
+			uint64_t ulStartNs = GetMonotonicNs();
+			bool bValid = m_distortionGrid.VerifyChecksum();
+			snprintf( pchResponseBuffer, unResponseBufferSize, "source=%s checksum_ok=%d verify_ms=%.2f\n",
+				m_distortionGrid.IsMapped() ? "mesh" : "model", bValid ? 1 : 0, ( GetMonotonicNs() - ulStartNs ) / 1e6 );
+		}
+		else if ( !strncmp( pchRequest, "distortion save ", 16 ) )
+		{
+			// "distortion save <path>" writes the current grid as a mesh file
+			bool bSaved = m_distortionGrid.Save( pchRequest + 16 );
+			snprintf( pchResponseBuffer, unResponseBufferSize, "saved=%d path=%s\n", bSaved ? 1 : 0, pchRequest + 16 );
+		}
+		else if ( !strncmp( pchRequest, "distortion bench", 16 ) )
+		{
+			// "distortion bench [<samples>]"
+			uint32_t unSamples = 1000000;
+			sscanf( pchRequest + 16, "%u", &unSamples );
+			RunDistortionBenchmark( unSamples, pchResponseBuffer, unResponseBufferSize );
+		}
+		else if ( !strcmp( pchRequest, "pose" ) )
+		{
+			PublishedPose_t published = m_latestPose.Load();
+			uint64_t ulNowNs = GetMonotonicNs();
+			double flAgeUs = published.ulSampleNs && ulNowNs > published.ulSampleNs ? ( ulNowNs - published.ulSampleNs ) / 1000.0 : 0.0;
+			snprintf( pchResponseBuffer, unResponseBufferSize,
+				"source=%s rate_hz=%u published=%u age_us=%.1f jitter_mean_us=%.1f jitter_stddev_us=%.1f jitter_max_us=%.1f missed_ticks=%llu\n",
+				m_unPoseRateHz ? "thread" : "runframe", m_unPoseRateHz, m_latestPose.GetVersion(), flAgeUs,
+				m_poseJitter.GetMeanNs() / 1000.0, m_poseJitter.GetStdDevNs() / 1000.0, m_poseJitter.GetMaxNs() / 1000.0,
+				(unsigned long long)m_ulPoseMissedTicks.load() );
+		}
+		else if ( !strcmp( pchRequest, "motion" ) )
+		{
+			uint64_t ulNowNs = GetMonotonicNs();
+			m_motion.FormatSummary( ulNowNs > m_ulMotionStartNs ? ulNowNs - m_ulMotionStartNs : 0, pchResponseBuffer, unResponseBufferSize );
+		}
+		else if ( !strcmp( pchRequest, "projection" ) )
+		{
+			uint32_t unUsed = 0;
+			for ( uint32_t unEye = 0; unEye < 2 && unUsed < unResponseBufferSize; unEye++ )
+			{
+				const float *pflTangents = m_rrflProjection[ unEye ];
+				float flHorizontal = ( atanf( pflTangents[1] ) - atanf( pflTangents[0] ) ) * 180.f / (float)M_PI;
+				float flVertical = ( atanf( pflTangents[3] ) - atanf( pflTangents[2] ) ) * 180.f / (float)M_PI;
+				int nWritten = snprintf( pchResponseBuffer + unUsed, unResponseBufferSize - unUsed,
+					"eye=%s tangents=%g,%g,%g,%g fov_h=%.1f fov_v=%.1f\n", unEye == 0 ? "left" : "right",
+					pflTangents[0], pflTangents[1], pflTangents[2], pflTangents[3], flHorizontal, flVertical );
+				if ( nWritten > 0 )
+					unUsed += (uint32_t)nWritten;
+			}
+			if ( unUsed < unResponseBufferSize )
+			{
+				std::lock_guard<std::mutex> lock( m_displayGeometryMutex );
+				snprintf( pchResponseBuffer + unUsed, unResponseBufferSize - unUsed, "cant_degrees=%g ipd=%g\n", m_flEyeCantDegrees, m_flIPD );
+			}
+		}
+		else if ( !strncmp( pchRequest, "ipd ", 4 ) )
+		{
+			// "ipd <meters>" behaves like an IPD change from the server
+			SetIPD( (float)atof( pchRequest + 4 ) );
+			std::lock_guard<std::mutex> lock( m_displayGeometryMutex );
+			snprintf( pchResponseBuffer, unResponseBufferSize, "ipd=%g\n", m_flIPD );
+		}
+		else if ( !strcmp( pchRequest, "hiddenarea" ) )
+		{
+			int nWritten = snprintf( pchResponseBuffer, unResponseBufferSize, "enabled=%d skipped_for_mesh=%d cached=%d build_ms=%.2f aperture=%g budget=%u\n",
+				m_bHiddenArea ? 1 : 0, m_bHiddenArea && m_distortionGrid.IsMapped() ? 1 : 0, m_bHiddenAreaCached ? 1 : 0, m_ulHiddenAreaBuildNs / 1e6, m_flLensApertureRadius, m_unHiddenAreaVertexBudget );
+			if ( nWritten > 0 && (uint32_t)nWritten < unResponseBufferSize )
+				m_hiddenArea.FormatSummary( pchResponseBuffer + nWritten, unResponseBufferSize - nWritten );
+		}
+		else if ( !strcmp( pchRequest, "undistort" ) )
+		{
+			m_inverseDistortion.FormatSummary( pchResponseBuffer, unResponseBufferSize );
+		}
+		else if ( !strncmp( pchRequest, "undistort bench", 15 ) )
+		{
+			// "undistort bench [<samples>]"
+			uint32_t unSamples = 1000000;
+			sscanf( pchRequest + 15, "%u", &unSamples );
+			m_inverseDistortion.RunBenchmark( unSamples, pchResponseBuffer, unResponseBufferSize );
+		}
+		else if ( !strncmp( pchRequest, "undistort ", 10 ) )
+		{
+			// "undistort <L|R> <u> <v>": the viewport point each channel samples texture (u, v) from
+			char chEye = 0;
+			float fU = 0.f, fV = 0.f;
+			if ( sscanf( pchRequest + 10, " %c %f %f", &chEye, &fU, &fV ) == 3 )
+			{
+				vr::EVREye eEye = ( chEye == 'R' || chEye == 'r' ) ? vr::Eye_Right : vr::Eye_Left;
+				const char * const rpchChannels[ LensChannel_Count ] = { "red", "green", "blue" };
+				uint32_t unUsed = 0;
+				for ( uint32_t unChannel = 0; unChannel < LensChannel_Count && unUsed < unResponseBufferSize; unChannel++ )
+				{
+					float fOutU, fOutV;
+					float flResidual = m_inverseDistortion.Solve( eEye, (ELensChannel)unChannel, fU, fV, &fOutU, &fOutV );
+					int nWritten = snprintf( pchResponseBuffer + unUsed, unResponseBufferSize - unUsed, "%s=%.6f,%.6f residual=%g\n",
+						rpchChannels[ unChannel ], fOutU, fOutV, flResidual );
+					if ( nWritten > 0 )
+						unUsed += (uint32_t)nWritten;
+				}
+			}
+		}
+		else if ( !strncmp( pchRequest, "distortion batch", 16 ) )
+		{
+			// "distortion batch [<samples>]"
+			uint32_t unSamples = 4000000;
+			sscanf( pchRequest + 16, "%u", &unSamples );
+			m_lensModel.RunBatchBenchmark( unSamples, pchResponseBuffer, unResponseBufferSize );
+		}
+		else if ( !strcmp( pchRequest, "frametiming" ) )
+		{
+			m_directMode.FormatTimingSummary( pchResponseBuffer, unResponseBufferSize );
+		}
+		else if ( !strcmp( pchRequest, "compositor" ) )
+		{
+			m_directMode.FormatCompositorSummary( pchResponseBuffer, unResponseBufferSize );
+		}
+		else if ( !strncmp( pchRequest, "compositor bench", 16 ) )
+		{
+			// "compositor bench [<width> <height> [<frames>]]", per eye
+			uint32_t unWidth = 2048, unHeight = 2048, unFrames = 20;
+			sscanf( pchRequest + 16, "%u %u %u", &unWidth, &unHeight, &unFrames );
+			CLayerCompositor::RunBenchmark( m_unCompositorThreads, unWidth, unHeight, unFrames, pchResponseBuffer, unResponseBufferSize );
+		}
+		else if ( !strcmp( pchRequest, "profile" ) )
+		{
+			m_profile.FormatSummary( pchResponseBuffer, unResponseBufferSize );
+		}
+		else if ( !strcmp( pchRequest, "profile reset" ) )
+		{
+			m_profile.Reset();
+		}
+		else if ( !strncmp( pchRequest, "refresh", 7 ) )
+		{
+			// "refresh" lists the rates, "refresh <hz>" switches to any rate, listed or not
+			const char *pchArg = pchRequest + 7;
+			if ( *pchArg == ' ' && !SetDisplayFrequency( (float)atof( pchArg + 1 ) ) )
+			{
+				snprintf( pchResponseBuffer, unResponseBufferSize, "invalid refresh rate '%s'\n", pchArg + 1 );
+				return;
+			}
+
+			std::string sRates;
+			for ( float flRate : m_vecRefreshRates )
+			{
+				char buf[32];
+				snprintf( buf, sizeof( buf ), sRates.empty() ? "%g" : ",%g", flRate );
+				sRates += buf;
+			}
+			snprintf( pchResponseBuffer, unResponseBufferSize, "frequency=%g supported=%s\n", m_flDisplayFrequency.load(), sRates.c_str() );
+		}
 	}
 
 	virtual void GetWindowBounds( int32_t *pnX, int32_t *pnY, uint32_t *pnWidth, uint32_t *pnHeight ) 
@@ -298,8 +829,8 @@ public:
 	virtual void GetRecommendedRenderTargetSize( uint32_t *pnWidth, uint32_t *pnHeight ) 
 	{
 		DriverLog("CSampleDeviceDriver::GetRecommendedRenderTargetSize() Called\n");
-		*pnWidth = m_nRenderWidth;
-		*pnHeight = m_nRenderHeight;
+		*pnWidth = m_renderTarget.GetWidth();
+		*pnHeight = m_renderTarget.GetHeight();
 	}
 
 	virtual void GetEyeOutputViewport( vr::EVREye eEye, uint32_t *pnX, uint32_t *pnY, uint32_t *pnWidth, uint32_t *pnHeight ) 
@@ -322,29 +853,35 @@ public:
 	virtual void GetProjectionRaw( vr::EVREye eEye, float *pfLeft, float *pfRight, float *pfTop, float *pfBottom ) 
 	{
 		DriverLog("CSampleDeviceDriver::GetProjectionRaw() Called\n");
-		*pfLeft = -1.0;
-		*pfRight = 1.0;
-		*pfTop = -1.0;
-		*pfBottom = 1.0;	
+		const float *pflTangents = m_rrflProjection[ eEye == vr::Eye_Left ? 0 : 1 ];
+		*pfLeft = pflTangents[0];
+		*pfRight = pflTangents[1];
+		*pfTop = pflTangents[2];
+		*pfBottom = pflTangents[3];
 	}
 
 	virtual vr::DistortionCoordinates_t ComputeDistortion( vr::EVREye eEye, float fU, float fV ) 
 	{
 		//DriverLog("CSampleDeviceDriver::ComputeDistortion() Called\n");
-		vr::DistortionCoordinates_t coordinates;
-		coordinates.rfBlue[0] = fU;
-		coordinates.rfBlue[1] = fV;
-		coordinates.rfGreen[0] = fU;
-		coordinates.rfGreen[1] = fV;
-		coordinates.rfRed[0] = fU;
-		coordinates.rfRed[1] = fV;
-		return coordinates;
+		if ( m_distortionGrid.IsValid() && !m_bDistortionMeshRejected )
+			return m_distortionGrid.Sample( eEye, fU, fV );
+		return m_lensModel.Evaluate( eEye, fU, fV );
 	}
 
 	virtual vr::DriverPose_t GetPose() 
 	{
 		// Called frequently
 		//DriverLog("CSampleDeviceDriver::GetPose() Called\n");
+		// the latest published pose, without waiting on the thread that publishes it
+		PublishedPose_t published = m_latestPose.Load();
+		if ( published.ulSampleNs )
+			return published.pose;
+		return SamplePose( GetMonotonicNs() );
+	}
+
+	/** Where the head is at ulNowNs */
+	vr::DriverPose_t SamplePose( uint64_t ulNowNs )
+	{
 		vr::DriverPose_t pose = { 0 };
 		pose.poseIsValid = true;
 		pose.result = vr::TrackingResult_Running_OK;
@@ -352,10 +889,9 @@ public:
 
 		pose.qWorldFromDriverRotation = HmdQuaternion_Init( 1, 0, 0, 0 );
 		pose.qDriverFromHeadRotation = HmdQuaternion_Init( 1, 0, 0, 0 );
-		pose.vecPosition[0] = 0.0;
-		pose.vecPosition[1] = double(rand() % 500) / 100000.0;
-		pose.vecPosition[2] = 0.0;
-		
+
+		MotionSample_t motion = m_motion.Sample( ulNowNs > m_ulMotionStartNs ? ulNowNs - m_ulMotionStartNs : 0 );
+		CMotionGenerator::ApplyToPose( motion, &pose );
 
 		return pose;
 	}
@@ -365,12 +901,401 @@ public:
 	{
 		// Called frequently
 		//DriverLog("CSampleDeviceDriver::RunFrame() Called\n");
-		// In a real driver, this should happen from some pose tracking thread.
 		// The RunFrame interval is unspecified and can be very irregular if some other
-		// driver blocks it for some periodic task.
+		// driver blocks it for some periodic task, so with poseRateHz set the pose thread publishes instead.
 		if ( m_unObjectId != vr::k_unTrackedDeviceIndexInvalid )
 		{
-			vr::VRServerDriverHost()->TrackedDevicePoseUpdated( m_unObjectId, GetPose(), sizeof( vr::DriverPose_t ) );
+			if ( !m_bPoseThreadRunning )
+				PublishPose();
+
+			// frame timing has its own clock, so resizing carries on whatever the pose thread does
+			if ( m_bDynamicResolution )
+				UpdateRenderTarget( GetMonotonicNs() );
+		}
+	}
+
+	/** Samples, stores and hands the runtime a pose */
+	void PublishPose()
+	{
+		uint64_t ulNowNs = GetMonotonicNs();
+		PublishedPose_t published;
+		published.pose = SamplePose( ulNowNs );
+		published.ulSampleNs = ulNowNs + (int64_t)( published.pose.poseTimeOffset * 1e9 );
+		m_latestPose.Store( published );
+		vr::VRServerDriverHost()->TrackedDevicePoseUpdated( m_unObjectId, published.pose, sizeof( vr::DriverPose_t ) );
+	}
+
+	/** Per eye frustum tangents, left, right, top and bottom, and the outward cant of each eye */
+	void ConfigureProjection()
+	{
+		// the right eye mirrors the left one unless it is set
+		float *pflLeft = m_rrflProjection[0];
+		float *pflRight = m_rrflProjection[1];
+		const float rflDefault[4] = { -1.f, 1.f, -1.f, 1.f };
+		memcpy( pflLeft, rflDefault, sizeof( rflDefault ) );
+		ParseFloatList( GetTestSettingString( k_pch_Test_FovTangentsLeft_String, "" ).c_str(), pflLeft, 4 );
+		if ( !( pflLeft[0] < pflLeft[1] && pflLeft[2] < pflLeft[3] ) )
+		{
+			DriverLog( "driver_null: fovTangentsLeft must be left < right and top < bottom, using +/-1\n" );
+			memcpy( pflLeft, rflDefault, sizeof( rflDefault ) );
+		}
+
+		pflRight[0] = -pflLeft[1];
+		pflRight[1] = -pflLeft[0];
+		pflRight[2] = pflLeft[2];
+		pflRight[3] = pflLeft[3];
+		ParseFloatList( GetTestSettingString( k_pch_Test_FovTangentsRight_String, "" ).c_str(), pflRight, 4 );
+		if ( !( pflRight[0] < pflRight[1] && pflRight[2] < pflRight[3] ) )
+		{
+			DriverLog( "driver_null: fovTangentsRight must be left < right and top < bottom, mirroring the left eye\n" );
+			pflRight[0] = -pflLeft[1];
+			pflRight[1] = -pflLeft[0];
+			pflRight[2] = pflLeft[2];
+			pflRight[3] = pflLeft[3];
+		}
+
+		m_flEyeCantDegrees = std::min( std::max( GetTestSettingFloat( k_pch_Test_EyeCantDegrees_Float, 0.f ), -45.f ), 45.f );
+		DriverLog( "driver_null: Projection: left %g %g %g %g, right %g %g %g %g, cant %g degrees\n",
+			pflLeft[0], pflLeft[1], pflLeft[2], pflLeft[3], pflRight[0], pflRight[1], pflRight[2], pflRight[3], m_flEyeCantDegrees );
+	}
+
+	/** Eye to head: half the IPD to each side, each eye yawed outward by the cant */
+	vr::HmdMatrix34_t GetEyeToHead( vr::EVREye eEye, float flIPD ) const
+	{
+		float flSign = eEye == vr::Eye_Left ? 1.f : -1.f;
+		float flYaw = flSign * m_flEyeCantDegrees * (float)M_PI / 180.f;
+		float flCos = cosf( flYaw );
+		float flSin = sinf( flYaw );
+
+		vr::HmdMatrix34_t matrix;
+		memset( &matrix, 0, sizeof( matrix ) );
+		matrix.m[0][0] = flCos;
+		matrix.m[0][2] = flSin;
+		matrix.m[1][1] = 1.f;
+		matrix.m[2][0] = -flSin;
+		matrix.m[2][2] = flCos;
+		matrix.m[0][3] = -flSign * flIPD / 2.f;
+		return matrix;
+	}
+
+	/** Hands the projection and the eye to head transforms to the server; again whenever the IPD changes */
+	void PublishDisplayGeometry()
+	{
+		if ( m_unObjectId == vr::k_unTrackedDeviceIndexInvalid )
+			return;
+
+		std::lock_guard<std::mutex> lock( m_displayGeometryMutex );
+		vr::HmdRect2_t rEyes[2];
+		for ( uint32_t unEye = 0; unEye < 2; unEye++ )
+		{
+			const float *pflTangents = m_rrflProjection[ unEye ];
+			rEyes[ unEye ].vTopLeft.v[0] = pflTangents[0];
+			rEyes[ unEye ].vTopLeft.v[1] = pflTangents[2];
+			rEyes[ unEye ].vBottomRight.v[0] = pflTangents[1];
+			rEyes[ unEye ].vBottomRight.v[1] = pflTangents[3];
+		}
+		vr::VRServerDriverHost()->SetDisplayProjectionRaw( m_unObjectId, rEyes[0], rEyes[1] );
+		vr::VRServerDriverHost()->SetDisplayEyeToHead( m_unObjectId, GetEyeToHead( vr::Eye_Left, m_flIPD ), GetEyeToHead( vr::Eye_Right, m_flIPD ) );
+	}
+
+	/** A new IPD moves the eyes; the frustums stay as they are */
+	void SetIPD( float flIPD )
+	{
+		if ( !( flIPD > 0.f ) || flIPD > 0.2f )
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock( m_displayGeometryMutex );
+			if ( flIPD == m_flIPD )
+				return;
+			m_flIPD = flIPD;
+		}
+
+		DriverLog( "driver_null: IPD: %f\n", flIPD );
+		if ( m_ulPropertyContainer != vr::k_ulInvalidPropertyContainer )
+			vr::VRProperties()->SetFloatProperty( m_ulPropertyContainer, vr::Prop_UserIpdMeters_Float, flIPD );
+		PublishDisplayGeometry();
+	}
+
+	void ProcessEvent( const vr::VREvent_t &vrEvent )
+	{
+		switch ( vrEvent.eventType )
+		{
+		case vr::VREvent_IpdChanged:
+			SetIPD( vrEvent.data.ipd.ipdMeters );
+			break;
+		case vr::VREvent_SteamVRSectionSettingChanged:
+			SetIPD( vr::VRSettings()->GetFloat( vr::k_pch_SteamVR_Section, vr::k_pch_SteamVR_IPD_Float ) );
+			break;
+		}
+	}
+
+	void ConfigureLensModel()
+	{
+		LensConfig_t config;
+		CLensModel::GetDefaultConfig( &config );
+
+		const char * const rpchChannelKeys[ LensChannel_Count ] = { k_pch_Test_DistortionRed_String, k_pch_Test_DistortionGreen_String, k_pch_Test_DistortionBlue_String };
+		const char * const rpchChannelDefaults[ LensChannel_Count ] = { k_pchDefaultDistortionRed, k_pchDefaultDistortionGreen, k_pchDefaultDistortionBlue };
+		for ( uint32_t unChannel = 0; unChannel < LensChannel_Count; unChannel++ )
+		{
+			ParseFloatList( GetTestSettingString( rpchChannelKeys[ unChannel ], rpchChannelDefaults[ unChannel ] ).c_str(), config.rrflRadial[ unChannel ], 3 );
+		}
+		config.flTangentialP1 = GetTestSettingFloat( k_pch_Test_DistortionP1_Float, 0.f );
+		config.flTangentialP2 = GetTestSettingFloat( k_pch_Test_DistortionP2_Float, 0.f );
+		config.flScale = GetTestSettingFloat( k_pch_Test_DistortionScale_Float, 0.f );
+		config.flAspect = (float)( m_nWindowWidth / 2 ) / (float)m_nWindowHeight;
+
+		// the right lens centre mirrors the left one unless it is set
+		ParseFloatList( GetTestSettingString( k_pch_Test_LensCenterLeft_String, "0.5,0.5" ).c_str(), config.rrflCentre[0], 2 );
+		config.rrflCentre[1][0] = 1.f - config.rrflCentre[0][0];
+		config.rrflCentre[1][1] = config.rrflCentre[0][1];
+		ParseFloatList( GetTestSettingString( k_pch_Test_LensCenterRight_String, "" ).c_str(), config.rrflCentre[1], 2 );
+
+		m_lensModel.Configure( config );
+		DriverLog( "driver_null: Lens: green k %g %g %g, p %g %g, centres (%g,%g) (%g,%g)\n",
+			config.rrflRadial[ LensChannel_Green ][0], config.rrflRadial[ LensChannel_Green ][1], config.rrflRadial[ LensChannel_Green ][2],
+			config.flTangentialP1, config.flTangentialP2,
+			config.rrflCentre[0][0], config.rrflCentre[0][1], config.rrflCentre[1][0], config.rrflCentre[1][1] );
+	}
+
+	/** Samples the lens model once so ComputeDistortion lookups cost the same whatever the model */
+	void BuildDistortionGrid()
+	{
+		JoinDistortionVerifyThread();
+		m_bDistortionMeshRejected = false;
+		if ( !m_sDistortionMesh.empty() && LoadDistortionMesh() )
+			return;
+
+		if ( m_unDistortionGridCells == 0 )
+			return;
+
+		uint64_t ulStartNs = GetMonotonicNs();
+		m_distortionGrid.Build( m_lensModel, m_unDistortionGridCells );
+		m_ulDistortionGridBuildNs = GetMonotonicNs() - ulStartNs;
+		DriverLog( "driver_null: Distortion grid: %u cells in %.2f ms\n", m_unDistortionGridCells, m_ulDistortionGridBuildNs / 1e6 );
+	}
+
+	/** Maps the mesh named by the distortionMesh setting, found through the driver's resources or as an absolute path */
+	bool LoadDistortionMesh()
+	{
+		char rchPath[ 4096 ];
+		uint32_t unLength = vr::VRResources() ? vr::VRResources()->GetResourceFullPath( m_sDistortionMesh.c_str(), "distortion", rchPath, sizeof( rchPath ) ) : 0;
+		if ( unLength == 0 || unLength > sizeof( rchPath ) )
+		{
+			if ( m_sDistortionMesh[0] != '/' || m_sDistortionMesh.size() >= sizeof( rchPath ) )
+			{
+				DriverLog( "driver_null: Distortion mesh %s not found, using the lens model\n", m_sDistortionMesh.c_str() );
+				return false;
+			}
+			strcpy( rchPath, m_sDistortionMesh.c_str() );
+		}
+
+		uint64_t ulStartNs = GetMonotonicNs();
+		if ( !m_distortionGrid.Load( rchPath ) )
+		{
+			DriverLog( "driver_null: Distortion mesh %s rejected, using the lens model\n", rchPath );
+			return false;
+		}
+		m_ulDistortionGridBuildNs = GetMonotonicNs() - ulStartNs;
+		DriverLog( "driver_null: Distortion mesh: %s, %u cells, mapped in %.2f ms\n", rchPath, m_distortionGrid.GetCells(), m_ulDistortionGridBuildNs / 1e6 );
+
+		// too large to checksum in Load; served meanwhile, and dropped for the lens model if it turns out corrupt
+		if ( m_distortionGrid.IsChecksumPending() )
+			m_pDistortionVerifyThread = new std::thread( &CSampleDeviceDriver::DistortionVerifyThreadFunction, this, std::string( rchPath ) );
+		return true;
+	}
+
+	void DistortionVerifyThreadFunction( std::string sPath )
+	{
+		uint64_t ulStartNs = GetMonotonicNs();
+		if ( m_distortionGrid.VerifyChecksum() )
+		{
+			DriverLog( "driver_null: Distortion mesh %s: checksum verified in %.2f ms\n", sPath.c_str(), ( GetMonotonicNs() - ulStartNs ) / 1e6 );
+			return;
+		}
+		m_bDistortionMeshRejected = true;
+		DriverLog( "driver_null: Distortion mesh %s: checksum mismatch, using the lens model\n", sPath.c_str() );
+	}
+
+	void JoinDistortionVerifyThread()
+	{
+		if ( !m_pDistortionVerifyThread )
+			return;
+
+		m_pDistortionVerifyThread->join();
+		delete m_pDistortionVerifyThread;
+		m_pDistortionVerifyThread = nullptr;
+	}
+
+	/** Cache directory for generated meshes: the setting, else the user's cache directory; empty if there is none */
+	std::string GetHiddenAreaCacheDir() const
+	{
+		if ( !m_sHiddenAreaCacheDir.empty() )
+			return m_sHiddenAreaCacheDir;
+
+		const char *pchXdgCache = getenv( "XDG_CACHE_HOME" );
+		if ( pchXdgCache && pchXdgCache[0] )
+			return std::string( pchXdgCache ) + "/steamvr-test";
+		const char *pchHome = getenv( "HOME" );
+		if ( pchHome && pchHome[0] )
+			return std::string( pchHome ) + "/.cache/steamvr-test";
+		return std::string();
+	}
+
+	/** Generates, or loads from the cache, the hidden area meshes of the lens model and sets them on the HMD */
+	void PublishHiddenArea()
+	{
+		// the meshes are traced through the lens model, which a mapped mesh replaces; a wrong hidden area
+		// would mask pixels the mesh shows, so the runtime keeps its default
+		if ( m_distortionGrid.IsMapped() )
+		{
+			DriverLog( "driver_null: Hidden area: not published, the lens model it is traced through is replaced by distortion mesh %s\n", m_sDistortionMesh.c_str() );
+			return;
+		}
+
+		uint64_t ulStartNs = GetMonotonicNs();
+		uint64_t ulHash = CHiddenAreaMeshes::HashConfig( m_lensModel.GetConfig(), m_flLensApertureRadius, m_unHiddenAreaVertexBudget );
+
+		std::string sPath;
+		std::string sCacheDir = GetHiddenAreaCacheDir();
+		if ( !sCacheDir.empty() )
+		{
+			char rchName[ 64 ];
+			snprintf( rchName, sizeof( rchName ), "/hiddenarea_%016llx.bin", (unsigned long long)ulHash );
+			sPath = sCacheDir + rchName;
+		}
+
+		m_bHiddenAreaCached = !sPath.empty() && m_hiddenArea.Load( sPath.c_str(), ulHash );
+		if ( !m_bHiddenAreaCached )
+		{
+			m_hiddenArea.Generate( m_lensModel, m_inverseDistortion, m_flLensApertureRadius, m_unHiddenAreaVertexBudget );
+
+			// the parent of the default directory may be missing on a fresh system too
+			if ( !sPath.empty() )
+			{
+				mkdir( sCacheDir.substr( 0, sCacheDir.rfind( '/' ) ).c_str(), 0755 );
+				mkdir( sCacheDir.c_str(), 0755 );
+				if ( !m_hiddenArea.Save( sPath.c_str(), ulHash ) )
+					DriverLog( "driver_null: Hidden area: cannot write cache %s\n", sPath.c_str() );
+			}
+		}
+		m_ulHiddenAreaBuildNs = GetMonotonicNs() - ulStartNs;
+
+		for ( uint32_t unEye = 0; unEye < 2; unEye++ )
+		{
+			vr::EVREye eEye = unEye == 0 ? vr::Eye_Left : vr::Eye_Right;
+			for ( uint32_t unType = 0; unType < vr::k_eHiddenAreaMesh_Max; unType++ )
+			{
+				std::vector<vr::HmdVector2_t> &vecMesh = m_hiddenArea.GetMesh( eEye, (vr::EHiddenAreaMeshType)unType );
+				vr::ETrackedPropertyError eError = vr::VRHiddenArea()->SetHiddenArea( eEye, (vr::EHiddenAreaMeshType)unType, vecMesh.data(), (uint32_t)vecMesh.size() );
+				if ( eError != vr::TrackedProp_Success )
+					DriverLog( "driver_null: Hidden area: setting mesh %u of eye %u failed with %d\n", unType, unEye, eError );
+			}
+		}
+
+		DriverLog( "driver_null: Hidden area: %s in %.2f ms, hides %.1f%% / %.1f%% of the render target\n",
+			m_bHiddenAreaCached ? "loaded from cache" : "generated", m_ulHiddenAreaBuildNs / 1e6,
+			m_hiddenArea.GetHiddenFraction( vr::Eye_Left ) * 100.f, m_hiddenArea.GetHiddenFraction( vr::Eye_Right ) * 100.f );
+	}
+
+	/** What ComputeDistortion answers, except that a grid built from the lens model defers to the model itself */
+	vr::DistortionCoordinates_t EvaluateLens( vr::EVREye eEye, float fU, float fV ) const
+	{
+		if ( m_distortionGrid.IsMapped() && !m_bDistortionMeshRejected )
+			return m_distortionGrid.Sample( eEye, fU, fV );
+		return m_lensModel.Evaluate( eEye, fU, fV );
+	}
+
+	/** Times ComputeDistortion from the grid against the lens model over unSamples scattered points */
+	void RunDistortionBenchmark( uint32_t unSamples, char *pchBuffer, uint32_t unBufferSize )
+	{
+		if ( !m_distortionGrid.IsValid() )
+		{
+			snprintf( pchBuffer, unBufferSize, "distortion grid disabled\n" );
+			return;
+		}
+
+		float flSink = 0.f;
+		uint64_t rulNs[2] = { 0, 0 };
+		for ( uint32_t unPass = 0; unPass < 2; unPass++ )
+		{
+			uint64_t ulStartNs = GetMonotonicNs();
+			for ( uint32_t i = 0; i < unSamples; i++ )
+			{
+				// golden ratio steps cover the viewport evenly without a pattern the cache would like
+				float fU = fmodf( i * 0.6180339887f, 1.f );
+				float fV = fmodf( i * 0.7548776662f, 1.f );
+				vr::EVREye eEye = ( i & 1 ) ? vr::Eye_Right : vr::Eye_Left;
+				vr::DistortionCoordinates_t coordinates = unPass == 0 ? m_lensModel.Evaluate( eEye, fU, fV ) : m_distortionGrid.Sample( eEye, fU, fV );
+				flSink += coordinates.rfGreen[0];
+			}
+			rulNs[ unPass ] = GetMonotonicNs() - ulStartNs;
+		}
+
+		snprintf( pchBuffer, unBufferSize, "samples=%u model_ns=%.1f grid_ns=%.1f checksum=%g\n", unSamples,
+			unSamples ? (double)rulNs[0] / unSamples : 0.0, unSamples ? (double)rulNs[1] / unSamples : 0.0, flSink );
+	}
+
+	/** Sizes the render target so that, at the lens centre, one rendered pixel covers one display pixel, times the supersample factor */
+	void ComputeRecommendedRenderTargetSize()
+	{
+		// central differences over the lens model itself, or the mesh if one was loaded; the densest channel of either eye wins
+		const float flStep = 1.0f / 1024.0f;
+		float flScaleU = 0.f, flScaleV = 0.f;
+		for ( uint32_t unEye = 0; unEye < 2; unEye++ )
+		{
+			vr::EVREye eEye = unEye == 0 ? vr::Eye_Left : vr::Eye_Right;
+			float flCentreU, flCentreV;
+			m_lensModel.GetCentre( eEye, &flCentreU, &flCentreV );
+			vr::DistortionCoordinates_t left = EvaluateLens( eEye, flCentreU - flStep, flCentreV );
+			vr::DistortionCoordinates_t right = EvaluateLens( eEye, flCentreU + flStep, flCentreV );
+			vr::DistortionCoordinates_t top = EvaluateLens( eEye, flCentreU, flCentreV - flStep );
+			vr::DistortionCoordinates_t bottom = EvaluateLens( eEye, flCentreU, flCentreV + flStep );
+
+			const float *rpflLeft[3] = { left.rfRed, left.rfGreen, left.rfBlue };
+			const float *rpflRight[3] = { right.rfRed, right.rfGreen, right.rfBlue };
+			const float *rpflTop[3] = { top.rfRed, top.rfGreen, top.rfBlue };
+			const float *rpflBottom[3] = { bottom.rfRed, bottom.rfGreen, bottom.rfBlue };
+			for ( uint32_t unChannel = 0; unChannel < 3; unChannel++ )
+			{
+				// texture distance covered per unit of display distance along each axis
+				float flDu = hypotf( rpflRight[ unChannel ][0] - rpflLeft[ unChannel ][0], rpflRight[ unChannel ][1] - rpflLeft[ unChannel ][1] ) / ( 2 * flStep );
+				float flDv = hypotf( rpflBottom[ unChannel ][0] - rpflTop[ unChannel ][0], rpflBottom[ unChannel ][1] - rpflTop[ unChannel ][1] ) / ( 2 * flStep );
+				if ( flDu > 0.f )
+					flScaleU = std::max( flScaleU, 1.f / flDu );
+				if ( flDv > 0.f )
+					flScaleV = std::max( flScaleV, 1.f / flDv );
+			}
+		}
+
+		// a degenerate model falls back to the display resolution
+		flScaleU = flScaleU > 0.f ? std::min( std::max( flScaleU, 0.25f ), 4.f ) : 1.f;
+		flScaleV = flScaleV > 0.f ? std::min( std::max( flScaleV, 0.25f ), 4.f ) : 1.f;
+
+		m_nRenderWidth = (int32_t)lroundf( m_nWindowWidth / 2 * flScaleU * m_flRenderSupersample );
+		m_nRenderHeight = (int32_t)lroundf( m_nWindowHeight * flScaleV * m_flRenderSupersample );
+		m_renderTarget.Configure( m_nRenderWidth, m_nRenderHeight, m_flRenderScaleMin, m_flRenderScaleMax );
+
+		DriverLog( "driver_null: Render Target: %d %d (lens centre density %.3f x %.3f, supersample %.2f)\n",
+			m_nRenderWidth, m_nRenderHeight, flScaleU, flScaleV, m_flRenderSupersample );
+	}
+
+	/** Lets the render target controller act on the frames rendered since its last change */
+	void UpdateRenderTarget( uint64_t ulNowNs )
+	{
+		if ( ulNowNs < m_ulNextRenderTargetUpdateNs )
+			return;
+		m_ulNextRenderTargetUpdateNs = ulNowNs + k_ulRenderTargetUpdateNs;
+
+		FrameTimingAggregates_t aggregates;
+		if ( !m_frameTimings.GetAggregates( &aggregates, m_renderTarget.GetLastReadFrameIndex() ) )
+			return;
+
+		if ( m_renderTarget.Update( aggregates, m_vsyncTimeline.GetPeriodNs() / 1e6f ) )
+		{
+			DriverLog( "driver_null: Render Target: %u %u (gpu p95 %.2f ms)\n", m_renderTarget.GetWidth(), m_renderTarget.GetHeight(), aggregates.flGpuMsP95 );
+			vr::VRServerDriverHost()->SetRecommendedRenderTargetSize( m_unObjectId, m_renderTarget.GetWidth(), m_renderTarget.GetHeight() );
 		}
 	}
 
@@ -378,36 +1303,521 @@ public:
 	/** Submits final backbuffer for display. */
 	virtual void Present( const vr::PresentInfo_t *pPresentInfo, uint32_t unPresentInfoSize )
 	{
-		DriverLog("########## Presenting!! ###########\n");
-		m_vSyncCounter++;
+		CScopedDriverProfile profile( m_profile, EntryPoint_Present );
+		FrameDriverLog("########## Presenting!! ###########\n");
+		uint64_t ulNowNs = GetMonotonicNs();
+		m_profile.AddPresent( ulNowNs );
+
+		PresentRecord_t record;
+		memset( &record, 0, sizeof( record ) );
+		record.eVSync = vr::VSync_WaitRender;
+		record.ulPresentNs = ulNowNs;
+		if ( pPresentInfo && unPresentInfoSize >= sizeof( vr::PresentInfo_t ) )
+		{
+			record.eVSync = pPresentInfo->vsync;
+			record.nFrameId = pPresentInfo->nFrameId;
+			// the runtime gives the vsync time in seconds on the same CLOCK_MONOTONIC as GetMonotonicNs()
+			if ( pPresentInfo->flVSyncTimeInSeconds > 0.0 )
+				record.ulRequestedVsyncNs = (uint64_t)( pPresentInfo->flVSyncTimeInSeconds * 1e9 );
+		}
+		uint64_t ulRequestedFrame = record.ulRequestedVsyncNs ? m_vsyncTimeline.GetFrameNearest( record.ulRequestedVsyncNs ) : 0;
+
+		// WaitForPresent() blocks until the target vsync, so a bogus far-future time would stall the caller for as long
+		uint64_t ulLastScanout = GetLastScanout( ulNowNs, nullptr );
+		uint64_t ulLatestFrame = ulLastScanout + 1 + k_ulMaxPresentAheadFrames;
+		if ( ulRequestedFrame > ulLatestFrame )
+		{
+			uint64_t ulClamped = ++m_ulClampedPresents;
+			if ( ulClamped == 1 || ulClamped % 1000 == 0 )
+			{
+				DriverLog( "driver_null: Present %llu targets vsync %llu, %llu past the next scan-out; clamped to %llu (%llu clamped so far)\n",
+					(unsigned long long)record.nFrameId, (unsigned long long)ulRequestedFrame, (unsigned long long)( ulRequestedFrame - ulLastScanout - 1 ),
+					(unsigned long long)ulLatestFrame, (unsigned long long)ulClamped );
+			}
+			ulRequestedFrame = ulLatestFrame;
+			record.ulRequestedVsyncNs = m_vsyncTimeline.GetVsyncTimeNs( ulRequestedFrame );
+		}
+
+		if ( record.eVSync == vr::VSync_None )
+		{
+			// no vsync: the buffer is flipped in immediately, tearing into the current scan-out
+			record.ulTargetFrame = ulLastScanout;
+		}
+		else
+		{
+			// the frame starts scanning out on the first vsync after it was handed to us,
+			// or later if the compositor targeted a later vsync
+			record.ulTargetFrame = std::max( ulLastScanout + 1, ulRequestedFrame );
+			record.ulTargetFrame = GetScanoutFrame( record.ulTargetFrame );
+		}
+
+		if ( (uint32_t)record.eVSync < k_unVSyncModeCount )
+			m_rulPresentCount[ record.eVSync ]++;
+
+		m_frameStats.PushFrame( record.ulPresentNs, record.nFrameId, record.ulTargetFrame, ulRequestedFrame );
+
+		// The runtime never tells the driver which pose a frame was rendered with, so take the newest pose at
+		// the moment the previous WaitForPresent() let the runtime start this frame. The newest pose right now
+		// is often sampled after the app rendered, and would understate motion-to-photon.
+		PublishedPose_t published = m_frameStartPose.Load();
+		if ( published.ulSampleNs )
+		{
+			PublishedPose_t consumed;
+			memset( &consumed, 0, sizeof( consumed ) );
+			m_frameStartPose.Store( consumed );
+			m_ulFrameStartPoseFrames++;
+		}
+		else
+		{
+			published = m_latestPose.Load();
+			m_ulLatestPoseFrames++;
+		}
+		uint64_t ulScanoutNs = record.eVSync == vr::VSync_None ? ulNowNs : GetFaultedVsyncNs( record.ulTargetFrame, nullptr );
+		if ( published.ulSampleNs )
+		{
+			uint64_t ulPhotonDelayNs = (uint64_t)( m_flSecondsFromVsyncToPhotons.load() * 1e9 );
+			m_latency.AddFrame( record.nFrameId, published.ulSampleNs, record.ulRequestedVsyncNs, ulScanoutNs, ulPhotonDelayNs );
+		}
+
+		if ( m_frameSinks.GetSinkCount() )
+		{
+			const vr::DriverPose_t &pose = published.pose;
+
+			FrameDescriptor_t frame;
+			frame.hTexture = pPresentInfo && unPresentInfoSize >= sizeof( vr::PresentInfo_t ) ? pPresentInfo->backbufferTextureHandle : 0;
+			frame.nFrameId = record.nFrameId;
+			frame.ulTargetFrame = record.ulTargetFrame;
+			frame.ulTargetVsyncNs = ulScanoutNs;
+			frame.ulPresentNs = record.ulPresentNs;
+			frame.ulPoseSampleNs = published.ulSampleNs;
+			frame.rvecPosition[0] = pose.vecPosition[0];
+			frame.rvecPosition[1] = pose.vecPosition[1];
+			frame.rvecPosition[2] = pose.vecPosition[2];
+			frame.qRotation = pose.qRotation;
+			m_frameSinks.Submit( frame );
+		}
+
+		m_eWaitVSync = record.eVSync;
+		m_ulPresentTargetFrame = record.ulTargetFrame;
 		return;
 	}
 
 	/** Block until the last presented buffer start scanning out. */
 	virtual void WaitForPresent()
 	{
-		DriverLog("CSampleDeviceDriver::WaitForPresent() Called\n");
-		DriverLog("Waiting for 5ms...\n");
-		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		FrameDriverLog("CSampleDeviceDriver::WaitForPresent() Called\n");
+		uint64_t ulWaitStartNs = GetMonotonicNs();
+		uint64_t ulTargetFrame = m_ulPresentTargetFrame;
+
+		// only VSync_WaitRender holds back the render work following the present
+		if ( ulTargetFrame == 0 || m_eWaitVSync != vr::VSync_WaitRender )
+		{
+			m_profile.AddSample( EntryPoint_WaitForPresent, GetMonotonicNs() - ulWaitStartNs );
+			MarkFrameStart();
+			return;
+		}
+
+		uint64_t ulDeadlineNs = GetFaultedVsyncNs( ulTargetFrame, nullptr );
+		if ( m_bScanoutRunning )
+		{
+			// the scan-out thread wakes us on the vsync; the timeline deadline plus one
+			// period bounds the wait should that thread ever stall
+			std::chrono::steady_clock::time_point timeout( std::chrono::nanoseconds( ulDeadlineNs + m_vsyncTimeline.GetPeriodNs() ) );
+			std::unique_lock<std::mutex> lock( m_vsyncMutex );
+			m_vsyncCondition.wait_until( lock, timeout, [&] { return m_vSyncCounter >= ulTargetFrame || !m_bScanoutRunning; } );
+		}
+		else
+		{
+			SleepUntilNs( ulDeadlineNs, m_ulWaitSpinNs );
+		}
+
+		uint64_t ulOverrunNs = m_faultInjector.GetWaitOverrunNs( ulTargetFrame );
+		if ( ulOverrunNs )
+		{
+			m_faultInjector.CountInjected( Fault_WaitOverrun );
+			ulDeadlineNs = std::max( ulDeadlineNs, GetMonotonicNs() ) + ulOverrunNs;
+			SleepUntilNs( ulDeadlineNs );
+		}
+
+		// anything past the vsync we were waiting for is our own overhead
+		uint64_t ulWaitNs = GetMonotonicNs() - ulWaitStartNs;
+		uint64_t ulIdealWaitNs = ulDeadlineNs > ulWaitStartNs ? std::min( ulDeadlineNs - ulWaitStartNs, ulWaitNs ) : 0;
+		m_profile.AddSample( EntryPoint_WaitForPresent, ulWaitNs - ulIdealWaitNs );
+		m_frameStats.SetLastWait( ulWaitNs );
+		MarkFrameStart();
 		return;
 	}
 
+	/** The runtime starts its next frame once WaitForPresent() returns; remember the pose it will most likely render with */
+	void MarkFrameStart()
+	{
+		m_frameStartPose.Store( m_latestPose.Load() );
+	}
+
 	/** Provides timing data for synchronizing with display. */
 	virtual bool GetTimeSinceLastVsync( float *pfSecondsSinceLastVsync, uint64_t *pulFrameCounter )
 	{
-		DriverLog("CSampleDeviceDriver::GetTimeSinceLastVsync() Called\n");
-		auto currentTime = std::chrono::system_clock::now();
-		auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime.time_since_epoch());
-		
-		*pfSecondsSinceLastVsync = millis.count() % 11 / 1000.0f;
-		*pulFrameCounter = m_vSyncCounter;
-		DriverLog("Reporting time since last VSync: %f\n", *pfSecondsSinceLastVsync);
+		CScopedDriverProfile profile( m_profile, EntryPoint_GetTimeSinceLastVsync );
+		FrameDriverLog("CSampleDeviceDriver::GetTimeSinceLastVsync() Called\n");
+		uint64_t ulNowNs = GetMonotonicNs();
+		uint64_t ulVsyncNs;
+		*pulFrameCounter = GetLastScanout( ulNowNs, &ulVsyncNs );
+		*pfSecondsSinceLastVsync = (float)( (double)( ulNowNs - ulVsyncNs ) * 1e-9 );
+		FrameDriverLog("Reporting time since last VSync: %f\n", *pfSecondsSinceLastVsync);
 		return true;
 	}
 
+	/** Direct mode frames go through the same present path as the virtual display */
+	virtual uint64_t PresentDirectModeFrame( uint64_t ulRequestedFrame )
+	{
+		vr::PresentInfo_t presentInfo;
+		memset( &presentInfo, 0, sizeof( presentInfo ) );
+		presentInfo.vsync = vr::VSync_WaitRender;
+		presentInfo.nFrameId = ++m_ulDirectModeFrameId;
+		if ( ulRequestedFrame )
+			presentInfo.flVSyncTimeInSeconds = m_vsyncTimeline.GetVsyncTimeNs( ulRequestedFrame ) * 1e-9;
+
+		Present( &presentInfo, sizeof( presentInfo ) );
+		return m_ulPresentTargetFrame;
+	}
+
+	virtual void WaitForDirectModeFrame()
+	{
+		WaitForPresent();
+	}
+
+	virtual uint64_t GetLastScanoutFrame()
+	{
+		return GetLastScanout( GetMonotonicNs(), nullptr );
+	}
+
 	std::string GetSerialNumber() const { return m_sSerialNumber; }
 
+	const CTickJitterStats &GetScanoutJitter() const { return m_scanoutJitter; }
+
+	/** Retimes the vsync generator to a new refresh rate without a frame counter discontinuity */
+	bool SetDisplayFrequency( float flFrequency )
+	{
+		if ( !( flFrequency > 0.f ) || flFrequency > k_flMaxDisplayFrequency )
+			return false;
+
+		float flSecondsFromVsyncToPhotons = m_flVsyncToPhotonsFrames / flFrequency;
+		m_vsyncTimeline.Retime( flFrequency, GetMonotonicNs() );
+		m_flDisplayFrequency = flFrequency;
+		m_flSecondsFromVsyncToPhotons = flSecondsFromVsyncToPhotons;
+
+		if ( m_ulPropertyContainer != vr::k_ulInvalidPropertyContainer )
+		{
+			vr::VRProperties()->SetFloatProperty( m_ulPropertyContainer, vr::Prop_DisplayFrequency_Float, flFrequency );
+			vr::VRProperties()->SetFloatProperty( m_ulPropertyContainer, vr::Prop_SecondsFromVsyncToPhotons_Float, flSecondsFromVsyncToPhotons );
+		}
+
+		DriverLog( "driver_null: Display Frequency: %f (Seconds from Vsync to Photons: %f)\n", flFrequency, flSecondsFromVsyncToPhotons );
+		return true;
+	}
+
 private:
+	void ParseRefreshRates( const char *pchRates )
+	{
+		float rflRates[ k_unMaxRefreshRates ];
+		uint32_t unRates = ParseFloatList( pchRates, rflRates, k_unMaxRefreshRates );
+
+		m_vecRefreshRates.clear();
+		for ( uint32_t i = 0; i < unRates; i++ )
+		{
+			if ( rflRates[i] > 0.f && rflRates[i] <= k_flMaxDisplayFrequency )
+				m_vecRefreshRates.push_back( rflRates[i] );
+		}
+
+		float flDisplayFrequency = m_flDisplayFrequency;
+		if ( std::find( m_vecRefreshRates.begin(), m_vecRefreshRates.end(), flDisplayFrequency ) == m_vecRefreshRates.end() )
+			m_vecRefreshRates.push_back( flDisplayFrequency );
+		std::sort( m_vecRefreshRates.begin(), m_vecRefreshRates.end() );
+	}
+
+	void StartScanoutThread()
+	{
+		if ( m_pScanoutThread )
+			return;
+
+		m_scanoutJitter.Reset();
+		m_vSyncCounter = m_vsyncTimeline.GetFrameAt( GetMonotonicNs() );
+		m_bScanoutRunning = true;
+		m_pScanoutThread = new std::thread( &CSampleDeviceDriver::ScanoutThreadFunction, this );
+
+		// vsync delivery is latency critical, so ask for real-time scheduling when we are allowed to
+		sched_param param;
+		param.sched_priority = 1;
+		if ( pthread_setschedparam( m_pScanoutThread->native_handle(), SCHED_FIFO, &param ) != 0 )
+		{
+			DriverLog( "driver_null: Scan-out thread running without real-time priority\n" );
+		}
+	}
+
+	void StopScanoutThread()
+	{
+		if ( !m_pScanoutThread )
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock( m_vsyncMutex );
+			m_bScanoutRunning = false;
+		}
+		m_vsyncCondition.notify_all();
+		m_pScanoutThread->join();
+		delete m_pScanoutThread;
+		m_pScanoutThread = nullptr;
+
+		DriverLog( "driver_null: Scan-out jitter over %llu vsyncs: mean %.1f us, stddev %.1f us, max %.1f us\n",
+			(unsigned long long)m_scanoutJitter.GetCount(), m_scanoutJitter.GetMeanNs() / 1000.0,
+			m_scanoutJitter.GetStdDevNs() / 1000.0, m_scanoutJitter.GetMaxNs() / 1000.0 );
+	}
+
+	void StartPoseThread()
+	{
+		if ( m_pPoseThread )
+			return;
+
+		m_poseJitter.Reset();
+		m_ulPoseMissedTicks = 0;
+		m_bPoseThreadRunning = true;
+		m_pPoseThread = new std::thread( &CSampleDeviceDriver::PoseThreadFunction, this );
+
+		// same as the scan-out thread: fresh poses matter more than anything else we run
+		sched_param param;
+		param.sched_priority = 1;
+		if ( pthread_setschedparam( m_pPoseThread->native_handle(), SCHED_FIFO, &param ) != 0 )
+		{
+			DriverLog( "driver_null: Pose thread running without real-time priority\n" );
+		}
+	}
+
+	void StopPoseThread()
+	{
+		if ( !m_pPoseThread )
+			return;
+
+		m_bPoseThreadRunning = false;
+		m_pPoseThread->join();
+		delete m_pPoseThread;
+		m_pPoseThread = nullptr;
+
+		DriverLog( "driver_null: Pose jitter over %llu poses: mean %.1f us, stddev %.1f us, max %.1f us, %llu ticks missed\n",
+			(unsigned long long)m_poseJitter.GetCount(), m_poseJitter.GetMeanNs() / 1000.0,
+			m_poseJitter.GetStdDevNs() / 1000.0, m_poseJitter.GetMaxNs() / 1000.0, (unsigned long long)m_ulPoseMissedTicks.load() );
+	}
+
+	void PoseThreadFunction()
+	{
+		// deadlines are counted from the start, so a late wake never shifts the ones after it
+		uint64_t ulPeriodNs = 1000000000ull / m_unPoseRateHz;
+		uint64_t ulStartNs = GetMonotonicNs();
+		uint64_t ulTick = 0;
+		while ( m_bPoseThreadRunning )
+		{
+			uint64_t ulDeadlineNs = ulStartNs + ulTick * ulPeriodNs;
+			SleepUntilNs( ulDeadlineNs, m_ulWaitSpinNs );
+
+			uint64_t ulNowNs = GetMonotonicNs();
+			m_poseJitter.AddSample( ulNowNs - ulDeadlineNs );
+			PublishPose();
+
+			// ticks slept through are skipped rather than published in a burst
+			uint64_t ulNextTick = ( ulNowNs - ulStartNs ) / ulPeriodNs + 1;
+			m_ulPoseMissedTicks += ulNextTick - ulTick - 1;
+			ulTick = ulNextTick;
+		}
+	}
+
+	void ScanoutThreadFunction()
+	{
+		while ( m_bScanoutRunning )
+		{
+			uint64_t ulNextFrame = GetScanoutFrame( m_vSyncCounter + 1 );
+			SleepUntilNs( GetFaultedVsyncNs( ulNextFrame, nullptr ), m_ulWaitSpinNs );
+
+			// a retime to a lower rate may have moved the vsync we slept for further out
+			uint64_t ulNowNs = GetMonotonicNs();
+			uint64_t ulVsyncNs = GetFaultedVsyncNs( ulNextFrame, nullptr );
+			if ( ulNowNs < ulVsyncNs )
+				continue;
+			m_scanoutJitter.AddSample( ulNowNs - ulVsyncNs );
+
+			// if we overslept by whole periods, those vsyncs are gone; catch up rather than replay them
+			uint64_t ulFrame = GetLastScanout( ulNowNs, &ulVsyncNs );
+			if ( ulFrame < ulNextFrame )
+			{
+				ulFrame = ulNextFrame;
+				ulVsyncNs = GetFaultedVsyncNs( ulFrame, nullptr );
+			}
+
+			if ( m_faultInjector.IsEnabled() )
+				CountScanoutFaults( m_vSyncCounter + 1, ulFrame );
+
+			{
+				std::lock_guard<std::mutex> lock( m_vsyncMutex );
+				m_vSyncCounter = ulFrame;
+			}
+			m_vsyncCondition.notify_all();
+
+			vr::VRServerDriverHost()->VsyncEvent( -(double)( ulNowNs - ulVsyncNs ) * 1e-9 );
+			m_profile.AddSample( EntryPoint_ScanoutTick, GetMonotonicNs() - ulNowNs );
+		}
+	}
+
+	void ConfigureFaultInjection()
+	{
+		FaultConfig_t config;
+		config.ulSeed = (uint64_t)GetTestSettingInt32( k_pch_Test_FaultSeed_Int32, 0 );
+		config.flLateProbability = GetTestSettingFloat( k_pch_Test_FaultLateProbability_Float, 0.f );
+		config.ulLateNs = (uint64_t)( std::max( GetTestSettingFloat( k_pch_Test_FaultLateMicroseconds_Float, 2000.f ), 0.f ) * 1000.0 );
+		config.flSkipProbability = GetTestSettingFloat( k_pch_Test_FaultSkipProbability_Float, 0.f );
+		config.flOverrunProbability = GetTestSettingFloat( k_pch_Test_FaultOverrunProbability_Float, 0.f );
+		config.ulOverrunNs = (uint64_t)( std::max( GetTestSettingFloat( k_pch_Test_FaultOverrunMicroseconds_Float, 5000.f ), 0.f ) * 1000.0 );
+		config.ulJitterNs = (uint64_t)( std::max( GetTestSettingFloat( k_pch_Test_FaultJitterMicroseconds_Float, 0.f ), 0.f ) * 1000.0 );
+		config.sScript = GetTestSettingString( k_pch_Test_FaultScript_String, "" );
+		config.unScriptLoopFrames = (uint32_t)std::max( GetTestSettingInt32( k_pch_Test_FaultScriptLoopFrames_Int32, 0 ), 0 );
+
+		std::string sJitter = GetTestSettingString( k_pch_Test_FaultJitter_String, "normal" );
+		config.eJitter = sJitter == "uniform" ? Jitter_Uniform : sJitter == "exponential" ? Jitter_Exponential : sJitter == "none" ? Jitter_None : Jitter_Normal;
+
+		m_bFaultInjection = GetTestSettingBool( k_pch_Test_FaultInjection_Bool, false );
+		std::string sError;
+		if ( !m_faultInjector.Configure( config, &sError ) )
+		{
+			DriverLog( "driver_null: Fault script rejected: %s\n", sError.c_str() );
+			m_bFaultInjection = false;
+		}
+		DriverLog( "driver_null: Fault injection: %s\n", m_bFaultInjection ? "on" : "off" );
+	}
+
+	/** Time of vsync ulFrame as the (possibly faulted) display produces it */
+	uint64_t GetFaultedVsyncNs( uint64_t ulFrame, bool *pbSkipped ) const
+	{
+		uint64_t ulNominalNs = m_vsyncTimeline.GetVsyncTimeNs( ulFrame );
+		VsyncFault_t fault = m_faultInjector.GetVsyncFault( ulFrame, m_vsyncTimeline.GetPeriodNs() );
+		if ( pbSkipped )
+			*pbSkipped = fault.bSkipped;
+		return (uint64_t)( (int64_t)ulNominalNs + fault.nOffsetNs );
+	}
+
+	/** First vsync at or after ulFrame that actually scans out */
+	uint64_t GetScanoutFrame( uint64_t ulFrame ) const
+	{
+		if ( !m_faultInjector.IsEnabled() )
+			return ulFrame;
+
+		for ( uint32_t i = 0; i < k_unMaxSkippedScanouts; i++ )
+		{
+			if ( !m_faultInjector.GetVsyncFault( ulFrame + i, m_vsyncTimeline.GetPeriodNs() ).bSkipped )
+				return ulFrame + i;
+		}
+		return ulFrame + k_unMaxSkippedScanouts;
+	}
+
+	/** Last vsync that scanned out at or before ulNowNs */
+	uint64_t GetLastScanout( uint64_t ulNowNs, uint64_t *pulVsyncNs ) const
+	{
+		if ( !m_faultInjector.IsEnabled() )
+		{
+			uint64_t ulFrame = m_vsyncTimeline.GetFrameAt( ulNowNs );
+			if ( pulVsyncNs )
+				*pulVsyncNs = std::min( m_vsyncTimeline.GetVsyncTimeNs( ulFrame ), ulNowNs );
+			return ulFrame;
+		}
+
+		// jitter can pull the next vsync up to half a period early
+		uint64_t ulFrame = m_vsyncTimeline.GetFrameAt( ulNowNs + m_vsyncTimeline.GetPeriodNs() / 2 );
+		for ( uint32_t i = 0; i < k_unMaxSkippedScanouts + 2 && ulFrame > 0; i++, ulFrame-- )
+		{
+			bool bSkipped;
+			uint64_t ulVsyncNs = GetFaultedVsyncNs( ulFrame, &bSkipped );
+			if ( !bSkipped && ulVsyncNs <= ulNowNs )
+			{
+				if ( pulVsyncNs )
+					*pulVsyncNs = ulVsyncNs;
+				return ulFrame;
+			}
+		}
+
+		if ( pulVsyncNs )
+			*pulVsyncNs = std::min( m_vsyncTimeline.GetVsyncTimeNs( ulFrame ), ulNowNs );
+		return ulFrame;
+	}
+
+	void CountScanoutFaults( uint64_t ulFirstFrame, uint64_t ulScanoutFrame )
+	{
+		for ( uint64_t ulFrame = ulFirstFrame; ulFrame <= ulScanoutFrame; ulFrame++ )
+		{
+			VsyncFault_t fault = m_faultInjector.GetVsyncFault( ulFrame, m_vsyncTimeline.GetPeriodNs() );
+			if ( fault.bSkipped )
+				m_faultInjector.CountInjected( Fault_SkippedScanout );
+			else if ( fault.bLate && ulFrame == ulScanoutFrame )
+				m_faultInjector.CountInjected( Fault_LateVsync );
+		}
+	}
+
+	void ConfigureFrameSinks()
+	{
+		std::string sSinks = GetTestSettingString( k_pch_Test_FrameSinks_String, "stats" );
+		size_t nStart = 0;
+		while ( nStart < sSinks.size() )
+		{
+			size_t nEnd = sSinks.find( ',', nStart );
+			if ( nEnd == std::string::npos )
+				nEnd = sSinks.size();
+			std::string sName = sSinks.substr( nStart, nEnd - nStart );
+			nStart = nEnd + 1;
+
+			IFrameSink *pSink = nullptr;
+			if ( sName == "stats" )
+			{
+				pSink = CreateStatisticsFrameSink();
+			}
+			else if ( sName == "encoder" )
+			{
+				float flCostUs = std::max( GetTestSettingFloat( k_pch_Test_EncoderMicroseconds_Float, 2000.f ), 0.f );
+				pSink = CreateEncoderFrameSink( (uint64_t)( flCostUs * 1000.0 ) );
+			}
+			else if ( sName == "recorder" )
+			{
+				std::string sPath = GetTestSettingString( k_pch_Test_RecorderPath_String, "" );
+				pSink = sPath.empty() ? nullptr : CreateRecorderFrameSink( sPath.c_str() );
+				if ( !pSink )
+					DriverLog( "driver_null: Frame recorder needs a writable %s setting\n", k_pch_Test_RecorderPath_String );
+			}
+			else if ( !sName.empty() )
+			{
+				DriverLog( "driver_null: Unknown frame sink '%s'\n", sName.c_str() );
+			}
+
+			if ( pSink )
+			{
+				DriverLog( "driver_null: Frame sink: %s\n", pSink->GetName() );
+				m_frameSinks.AddSink( pSink );
+			}
+		}
+	}
+
+	// a pose as handed to the runtime, with the monotonic time it describes
+	struct PublishedPose_t
+	{
+		vr::DriverPose_t pose;
+		uint64_t ulSampleNs;
+	};
+
+	// what Present() was asked to do with a frame, on the vsync timeline
+	struct PresentRecord_t
+	{
+		uint64_t nFrameId;
+		vr::EVSync eVSync;
+		uint64_t ulPresentNs;
+		uint64_t ulRequestedVsyncNs;	// PresentInfo_t::flVSyncTimeInSeconds, 0 if not given
+		uint64_t ulTargetFrame;			// vsync the frame starts scanning out on
+	};
+
+	static const uint32_t k_unVSyncModeCount = 3;
+
 	vr::TrackedDeviceIndex_t m_unObjectId;
 	vr::PropertyContainerHandle_t m_ulPropertyContainer;
 
@@ -420,11 +1830,90 @@ private:
 	int32_t m_nWindowHeight;
 	int32_t m_nRenderWidth;
 	int32_t m_nRenderHeight;
-	float m_flSecondsFromVsyncToPhotons;
-	float m_flDisplayFrequency;
+	// written by "refresh <hz>" on the debug request thread, read by Present and the debug requests
+	std::atomic<float> m_flSecondsFromVsyncToPhotons;
+	std::atomic<float> m_flDisplayFrequency;
+	float m_flVsyncToPhotonsFrames;
+	std::vector<float> m_vecRefreshRates;
 	float m_flIPD;
-
-	uint64_t m_vSyncCounter;
+	float m_rrflProjection[2][4];			// tangents per eye: left, right, top, bottom
+	float m_flEyeCantDegrees;
+	std::mutex m_displayGeometryMutex;		// m_flIPD and publishing it
+
+	CVsyncTimeline m_vsyncTimeline;
+	std::atomic<uint64_t> m_ulPresentTargetFrame;
+	std::atomic<vr::EVSync> m_eWaitVSync;
+	uint64_t m_ulWaitSpinNs;
+	std::atomic<uint64_t> m_rulPresentCount[ k_unVSyncModeCount ];
+	std::atomic<uint64_t> m_ulClampedPresents;		// presents whose requested vsync was too far out
+
+	// newest pose when WaitForPresent() released the runtime, consumed by the next Present(); both run on the runtime's present thread
+	CSeqLock<PublishedPose_t> m_frameStartPose;
+	std::atomic<uint64_t> m_ulFrameStartPoseFrames;	// frames timed from m_frameStartPose
+	std::atomic<uint64_t> m_ulLatestPoseFrames;		// frames with no WaitForPresent() before them, timed from the newest pose
+
+	// scan-out simulation
+	std::thread *m_pScanoutThread;
+	std::atomic<bool> m_bScanoutRunning;
+	std::atomic<uint64_t> m_vSyncCounter;
+	std::mutex m_vsyncMutex;
+	std::condition_variable m_vsyncCondition;
+	CTickJitterStats m_scanoutJitter;
+
+	CFrameStatsRing m_frameStats;
+
+	bool m_bStressMode;
+	CDriverProfile m_profile;
+
+	bool m_bFaultInjection;
+	CFaultInjector m_faultInjector;
+
+	CSeqLock<PublishedPose_t> m_latestPose;
+
+	// pose publishing, when it does not follow RunFrame
+	uint32_t m_unPoseRateHz;
+	std::thread *m_pPoseThread;
+	std::atomic<bool> m_bPoseThreadRunning;
+	CTickJitterStats m_poseJitter;
+	std::atomic<uint64_t> m_ulPoseMissedTicks;
+
+	// synthetic head motion, timed from m_ulMotionStartNs
+	CMotionGenerator m_motion;
+	uint64_t m_ulMotionStartNs;
+
+	CFrameSinkPipeline m_frameSinks;
+	CLatencyEstimator m_latency;
+
+	bool m_bDirectMode;
+	uint64_t m_ulDirectModeFrameId;
+	uint32_t m_unCompositorThreads;
+
+	uint32_t m_unFrameTimingPollMs;
+	CFrameTimingCollector m_frameTimings;
+
+	bool m_bDynamicResolution;
+	float m_flRenderScaleMin;
+	float m_flRenderScaleMax;
+	float m_flRenderSupersample;
+
+	CLensModel m_lensModel;
+	CDistortionGrid m_distortionGrid;
+	CInverseDistortion m_inverseDistortion;
+	CHiddenAreaMeshes m_hiddenArea;
+	bool m_bHiddenArea;
+	bool m_bHiddenAreaCached;
+	float m_flLensApertureRadius;
+	uint32_t m_unHiddenAreaVertexBudget;
+	std::string m_sHiddenAreaCacheDir;
+	uint64_t m_ulHiddenAreaBuildNs;
+	std::string m_sDistortionMesh;
+	uint32_t m_unDistortionGridCells;
+	uint64_t m_ulDistortionGridBuildNs;
+	std::thread *m_pDistortionVerifyThread;		// checksums a mesh too large for Load to
+	std::atomic<bool> m_bDistortionMeshRejected;	// the checksum failed; ComputeDistortion is back on the lens model
+	CRenderTargetController m_renderTarget;
+	uint64_t m_ulNextRenderTargetUpdateNs;
+	CSampleDirectModeComponent m_directMode;
 };
 
 //-----------------------------------------------------------------------------
@@ -441,6 +1930,12 @@ public:
 		m_sSerialNumber = "CTRL_1234";
 
 		m_sModelNumber = "MyController";
+
+		// the controller only reports a pose when it has synthetic motion to follow
+		m_bMotion = GetTestSettingBool( k_pch_Test_ControllerMotion_Bool, false );
+		if ( m_bMotion )
+			ConfigureMotion( &m_motion, MotionProfile_Hand );
+		m_ulMotionStartNs = GetMonotonicNs();
 	}
 
 	virtual ~CSampleControllerDriver()
@@ -463,7 +1958,7 @@ public:
 		vr::VRProperties()->SetBoolProperty( m_ulPropertyContainer, vr::Prop_IsOnDesktop_Bool, false );
 
 		// our sample device isn't actually tracked, so set this property to avoid having the icon blink in the status window
-		vr::VRProperties()->SetBoolProperty( m_ulPropertyContainer, vr::Prop_NeverTracked_Bool, true );
+		vr::VRProperties()->SetBoolProperty( m_ulPropertyContainer, vr::Prop_NeverTracked_Bool, !m_bMotion );
 
 		// even though we won't ever track we want to pretend to be the right hand so binding will work as expected
 		vr::VRProperties()->SetInt32Property( m_ulPropertyContainer, vr::Prop_ControllerRoleHint_Int32, vr::TrackedControllerRole_RightHand );
@@ -512,19 +2007,31 @@ public:
 	virtual vr::DriverPose_t GetPose()
 	{
 		vr::DriverPose_t pose = { 0 };
-		pose.poseIsValid = false;
-		pose.result = vr::TrackingResult_Calibrating_OutOfRange;
+		pose.poseIsValid = m_bMotion;
+		pose.result = m_bMotion ? vr::TrackingResult_Running_OK : vr::TrackingResult_Calibrating_OutOfRange;
 		pose.deviceIsConnected = true;
 
 		pose.qWorldFromDriverRotation = HmdQuaternion_Init( 1, 0, 0, 0 );
 		pose.qDriverFromHeadRotation = HmdQuaternion_Init( 1, 0, 0, 0 );
 
+		if ( m_bMotion )
+		{
+			uint64_t ulNowNs = GetMonotonicNs();
+			CMotionGenerator::ApplyToPose( m_motion.Sample( ulNowNs > m_ulMotionStartNs ? ulNowNs - m_ulMotionStartNs : 0 ), &pose );
+		}
+
 		return pose;
 	}
 
 
 	void RunFrame()
 	{
+		if ( m_bMotion && m_unObjectId != vr::k_unTrackedDeviceIndexInvalid )
+		{
+			vr::DriverPose_t pose = GetPose();
+			vr::VRServerDriverHost()->TrackedDevicePoseUpdated( m_unObjectId, pose, sizeof( vr::DriverPose_t ) );
+		}
+
 #if defined( _WINDOWS )
 		// Your driver would read whatever hardware state is associated with its input components and pass that
 		// in to UpdateBooleanComponent. This could happen in RunFrame or on a thread of your own that's reading USB
@@ -567,7 +2074,9 @@ private:
 	std::string m_sSerialNumber;
 	std::string m_sModelNumber;
 
-
+	bool m_bMotion;
+	CMotionGenerator m_motion;
+	uint64_t m_ulMotionStartNs;
 };
 
 //-----------------------------------------------------------------------------
@@ -632,6 +2141,10 @@ void CServerDriver_Sample::RunFrame()
 	vr::VREvent_t vrEvent;
 	while ( vr::VRServerDriverHost()->PollNextEvent( &vrEvent, sizeof( vrEvent ) ) )
 	{
+		if ( m_pNullHmdLatest )
+		{
+			m_pNullHmdLatest->ProcessEvent( vrEvent );
+		}
 		if ( m_pController )
 		{
 			m_pController->ProcessEvent( vrEvent );
@@ -0,0 +1,126 @@
+#include <driverprofile.h>
+#include <vsynctimeline.h>
+
+#include <stdio.h>
+#include <algorithm>
+
+static const char * const k_rpchEntryPointNames[ EntryPoint_Count ] =
+{
+	"present",
+	"wait_for_present",
+	"time_since_vsync",
+	"scanout_tick",
+	"create_swap_set",
+	"destroy_swap_set",
+	"next_swap_index",
+	"submit_layer",
+	"composite",
+};
+
+// entry points paid on every presented frame; the rest run on their own thread or only on setup
+static const bool k_rbEntryPointPerFrame[ EntryPoint_Count ] =
+{
+	true,
+	true,
+	true,
+	false,
+	false,
+	false,
+	true,
+	true,
+	true,
+};
+
+void CDriverProfile::Reset()
+{
+	for ( uint32_t i = 0; i < EntryPoint_Count; i++ )
+	{
+		m_entryPoints[i].ulCalls = 0;
+		m_entryPoints[i].ulTotalNs = 0;
+		m_entryPoints[i].ulMaxNs = 0;
+	}
+	m_ulFirstPresentNs = 0;
+	m_ulLastPresentNs = 0;
+	m_ulPresents = 0;
+}
+
+void CDriverProfile::AddSample( EDriverEntryPoint eEntryPoint, uint64_t ulNs )
+{
+	EntryPointStats_t &stats = m_entryPoints[ eEntryPoint ];
+	stats.ulCalls.fetch_add( 1, std::memory_order_relaxed );
+	stats.ulTotalNs.fetch_add( ulNs, std::memory_order_relaxed );
+
+	uint64_t ulMaxNs = stats.ulMaxNs.load( std::memory_order_relaxed );
+	while ( ulNs > ulMaxNs && !stats.ulMaxNs.compare_exchange_weak( ulMaxNs, ulNs, std::memory_order_relaxed ) )
+	{
+	}
+}
+
+void CDriverProfile::AddPresent( uint64_t ulNowNs )
+{
+	if ( m_ulPresents.fetch_add( 1, std::memory_order_relaxed ) == 0 )
+		m_ulFirstPresentNs.store( ulNowNs, std::memory_order_relaxed );
+	m_ulLastPresentNs.store( ulNowNs, std::memory_order_relaxed );
+}
+
+void CDriverProfile::FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const
+{
+	if ( unBufferSize == 0 )
+		return;
+	pchBuffer[0] = 0;
+
+	uint32_t unUsed = 0;
+	double flFrameCostNs = 0.0;
+	for ( uint32_t i = 0; i < EntryPoint_Count; i++ )
+	{
+		const EntryPointStats_t &stats = m_entryPoints[i];
+		uint64_t ulCalls = stats.ulCalls.load( std::memory_order_relaxed );
+		double flMeanNs = ulCalls ? (double)stats.ulTotalNs.load( std::memory_order_relaxed ) / (double)ulCalls : 0.0;
+
+		if ( k_rbEntryPointPerFrame[i] )
+			flFrameCostNs += flMeanNs;
+
+		if ( unUsed < unBufferSize )
+		{
+			int nWritten = snprintf( pchBuffer + unUsed, unBufferSize - unUsed, "%s calls=%llu mean_ns=%.0f max_ns=%llu\n",
+				k_rpchEntryPointNames[i], (unsigned long long)ulCalls, flMeanNs,
+				(unsigned long long)stats.ulMaxNs.load( std::memory_order_relaxed ) );
+			if ( nWritten > 0 )
+				unUsed += (uint32_t)nWritten;
+		}
+	}
+
+	uint64_t ulPresents = m_ulPresents.load( std::memory_order_relaxed );
+	uint64_t ulSpanNs = m_ulLastPresentNs.load( std::memory_order_relaxed ) - m_ulFirstPresentNs.load( std::memory_order_relaxed );
+	double flAchievedFps = ulPresents > 1 && ulSpanNs ? (double)( ulPresents - 1 ) * 1e9 / (double)ulSpanNs : 0.0;
+	double flDriverBoundFps = flFrameCostNs > 0.0 ? 1e9 / flFrameCostNs : 0.0;
+
+	if ( unUsed < unBufferSize )
+	{
+		snprintf( pchBuffer + unUsed, unBufferSize - unUsed, "achieved_fps=%.1f driver_frame_ns=%.0f driver_bound_fps=%.0f\n",
+			flAchievedFps, flFrameCostNs, flDriverBoundFps );
+	}
+}
+
+
+// innermost open scope on this thread
+static thread_local CScopedDriverProfile *t_pOpenScope = nullptr;
+
+CScopedDriverProfile::CScopedDriverProfile( CDriverProfile &profile, EDriverEntryPoint eEntryPoint )
+	: m_profile( profile ), m_eEntryPoint( eEntryPoint )
+{
+	m_ulNestedNs = 0;
+	m_pEnclosing = t_pOpenScope;
+	t_pOpenScope = this;
+	m_ulStartNs = GetMonotonicNs();
+}
+
+CScopedDriverProfile::~CScopedDriverProfile()
+{
+	uint64_t ulElapsedNs = GetMonotonicNs() - m_ulStartNs;
+	m_profile.AddSample( m_eEntryPoint, ulElapsedNs - std::min( m_ulNestedNs, ulElapsedNs ) );
+
+	t_pOpenScope = m_pEnclosing;
+	if ( m_pEnclosing )
+		m_pEnclosing->m_ulNestedNs += ulElapsedNs;
+}
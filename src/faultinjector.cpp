@@ -0,0 +1,236 @@
+#include <faultinjector.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+static const char * const k_rpchFaultNames[ Fault_Count ] =
+{
+	"late",
+	"skip",
+	"overrun",
+};
+
+// SplitMix64 finalizer; turns ( seed, frame, stream ) into an independent 64 bit draw
+static uint64_t MixBits( uint64_t ulValue )
+{
+	ulValue += 0x9e3779b97f4a7c15ull;
+	ulValue = ( ulValue ^ ( ulValue >> 30 ) ) * 0xbf58476d1ce4e5b9ull;
+	ulValue = ( ulValue ^ ( ulValue >> 27 ) ) * 0x94d049bb133111ebull;
+	return ulValue ^ ( ulValue >> 31 );
+}
+
+CFaultInjector::CFaultInjector()
+{
+	m_config.ulSeed = 0;
+	m_config.flLateProbability = 0.f;
+	m_config.ulLateNs = 0;
+	m_config.flSkipProbability = 0.f;
+	m_config.flOverrunProbability = 0.f;
+	m_config.ulOverrunNs = 0;
+	m_config.eJitter = Jitter_None;
+	m_config.ulJitterNs = 0;
+	m_config.unScriptLoopFrames = 0;
+	m_bEnabled = false;
+	m_ulBaseFrame = 0;
+	for ( uint32_t i = 0; i < Fault_Count; i++ )
+	{
+		m_rulInjected[i] = 0;
+	}
+}
+
+bool CFaultInjector::Configure( const FaultConfig_t &config, std::string *psError )
+{
+	std::vector<ScriptEvent_t> vecScript;
+	const char *pch = config.sScript.c_str();
+	while ( *pch )
+	{
+		while ( *pch == ' ' || *pch == ',' )
+			pch++;
+		if ( !*pch )
+			break;
+
+		const char *pchEvent = pch;
+		char *pchEnd;
+		ScriptEvent_t event;
+		event.ulFrame = strtoull( pch, &pchEnd, 10 );
+		if ( pchEnd == pch || *pchEnd != ':' )
+		{
+			if ( psError )
+				*psError = std::string( "expected <frame>: at '" ) + pchEvent + "'";
+			return false;
+		}
+		pch = pchEnd + 1;
+
+		uint32_t unKind = 0;
+		for ( ; unKind < Fault_Count; unKind++ )
+		{
+			size_t nLen = strlen( k_rpchFaultNames[ unKind ] );
+			if ( !strncmp( pch, k_rpchFaultNames[ unKind ], nLen ) && ( pch[ nLen ] == ':' || pch[ nLen ] == ',' || pch[ nLen ] == 0 ) )
+			{
+				pch += nLen;
+				break;
+			}
+		}
+		if ( unKind == Fault_Count )
+		{
+			if ( psError )
+				*psError = std::string( "unknown fault at '" ) + pchEvent + "'";
+			return false;
+		}
+		event.eKind = (EFaultKind)unKind;
+		event.ulAmountNs = event.eKind == Fault_LateVsync ? config.ulLateNs : event.eKind == Fault_WaitOverrun ? config.ulOverrunNs : 0;
+
+		if ( *pch == ':' )
+		{
+			double flAmountUs = strtod( pch + 1, &pchEnd );
+			if ( pchEnd == pch + 1 || flAmountUs < 0.0 )
+			{
+				if ( psError )
+					*psError = std::string( "bad amount at '" ) + pchEvent + "'";
+				return false;
+			}
+			event.ulAmountNs = (uint64_t)( flAmountUs * 1000.0 );
+			pch = pchEnd;
+		}
+
+		vecScript.push_back( event );
+	}
+	std::sort( vecScript.begin(), vecScript.end() );
+
+	m_config = config;
+	m_vecScript.swap( vecScript );
+	return true;
+}
+
+void CFaultInjector::Enable( uint64_t ulBaseFrame )
+{
+	m_ulBaseFrame.store( ulBaseFrame, std::memory_order_relaxed );
+	m_bEnabled.store( true, std::memory_order_release );
+}
+
+void CFaultInjector::Disable()
+{
+	m_bEnabled.store( false, std::memory_order_release );
+}
+
+double CFaultInjector::Uniform( uint64_t ulFrame, uint64_t ulStream ) const
+{
+	uint64_t ulBits = MixBits( m_config.ulSeed ^ MixBits( ulFrame * 4 + ulStream ) );
+	return (double)( ulBits >> 11 ) * ( 1.0 / 9007199254740992.0 );
+}
+
+const CFaultInjector::ScriptEvent_t *CFaultInjector::FindScriptEvent( uint64_t ulFrame, EFaultKind eKind ) const
+{
+	if ( m_vecScript.empty() )
+		return nullptr;
+
+	uint64_t ulBaseFrame = m_ulBaseFrame.load( std::memory_order_relaxed );
+	if ( ulFrame < ulBaseFrame )
+		return nullptr;
+
+	ScriptEvent_t key;
+	key.ulFrame = ulFrame - ulBaseFrame;
+	if ( m_config.unScriptLoopFrames )
+		key.ulFrame %= m_config.unScriptLoopFrames;
+	key.eKind = eKind;
+	key.ulAmountNs = 0;
+
+	std::vector<ScriptEvent_t>::const_iterator it = std::lower_bound( m_vecScript.begin(), m_vecScript.end(), key );
+	if ( it == m_vecScript.end() || it->ulFrame != key.ulFrame || it->eKind != eKind )
+		return nullptr;
+	return &*it;
+}
+
+VsyncFault_t CFaultInjector::GetVsyncFault( uint64_t ulFrame, uint64_t ulPeriodNs ) const
+{
+	VsyncFault_t fault;
+	fault.bSkipped = false;
+	fault.bLate = false;
+	fault.nOffsetNs = 0;
+	if ( !IsEnabled() )
+		return fault;
+
+	fault.bSkipped = FindScriptEvent( ulFrame, Fault_SkippedScanout ) != nullptr
+		|| ( m_config.flSkipProbability > 0.f && Uniform( ulFrame, 0 ) < m_config.flSkipProbability );
+
+	const ScriptEvent_t *pLate = FindScriptEvent( ulFrame, Fault_LateVsync );
+	if ( pLate )
+	{
+		fault.bLate = true;
+		fault.nOffsetNs += (int64_t)pLate->ulAmountNs;
+	}
+	else if ( m_config.flLateProbability > 0.f && Uniform( ulFrame, 1 ) < m_config.flLateProbability )
+	{
+		fault.bLate = true;
+		fault.nOffsetNs += (int64_t)m_config.ulLateNs;
+	}
+
+	if ( m_config.ulJitterNs )
+	{
+		double flJitterNs = (double)m_config.ulJitterNs;
+		double flU = Uniform( ulFrame, 2 );
+		switch ( m_config.eJitter )
+		{
+		case Jitter_Uniform:
+			fault.nOffsetNs += (int64_t)( ( flU * 2.0 - 1.0 ) * flJitterNs );
+			break;
+		case Jitter_Normal:
+		{
+			// Box-Muller
+			double flV = Uniform( ulFrame, 3 );
+			fault.nOffsetNs += (int64_t)( sqrt( -2.0 * log( 1.0 - flU ) ) * cos( 2.0 * M_PI * flV ) * flJitterNs );
+		}
+		break;
+		case Jitter_Exponential:
+			fault.nOffsetNs += (int64_t)( -log( 1.0 - flU ) * flJitterNs );
+			break;
+		default:
+			break;
+		}
+	}
+
+	// keep every vsync within ( previous, next ) so the timeline stays ordered;
+	// anything later than that is what a skipped scan-out is for
+	int64_t nMaxOffsetNs = (int64_t)ulPeriodNs / 2 - 1;
+	fault.nOffsetNs = std::max( -nMaxOffsetNs, std::min( fault.nOffsetNs, nMaxOffsetNs ) );
+	return fault;
+}
+
+uint64_t CFaultInjector::GetWaitOverrunNs( uint64_t ulFrame ) const
+{
+	if ( !IsEnabled() )
+		return 0;
+
+	const ScriptEvent_t *pOverrun = FindScriptEvent( ulFrame, Fault_WaitOverrun );
+	if ( pOverrun )
+		return pOverrun->ulAmountNs;
+	if ( m_config.flOverrunProbability > 0.f && Uniform( ulFrame, 4 ) < m_config.flOverrunProbability )
+		return m_config.ulOverrunNs;
+	return 0;
+}
+
+void CFaultInjector::FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const
+{
+	static const char * const k_rpchJitterNames[] = { "none", "uniform", "normal", "exponential" };
+
+	snprintf( pchBuffer, unBufferSize,
+		"enabled=%d seed=%llu base_frame=%llu\n"
+		"late p=%.4f us=%.1f\n"
+		"skip p=%.4f\n"
+		"overrun p=%.4f us=%.1f\n"
+		"jitter %s us=%.1f\n"
+		"script events=%u loop=%u\n"
+		"injected late=%llu skip=%llu overrun=%llu\n",
+		IsEnabled() ? 1 : 0, (unsigned long long)m_config.ulSeed, (unsigned long long)m_ulBaseFrame.load( std::memory_order_relaxed ),
+		m_config.flLateProbability, m_config.ulLateNs / 1000.0,
+		m_config.flSkipProbability,
+		m_config.flOverrunProbability, m_config.ulOverrunNs / 1000.0,
+		k_rpchJitterNames[ m_config.eJitter ], m_config.ulJitterNs / 1000.0,
+		(uint32_t)m_vecScript.size(), m_config.unScriptLoopFrames,
+		(unsigned long long)m_rulInjected[ Fault_LateVsync ].load( std::memory_order_relaxed ),
+		(unsigned long long)m_rulInjected[ Fault_SkippedScanout ].load( std::memory_order_relaxed ),
+		(unsigned long long)m_rulInjected[ Fault_WaitOverrun ].load( std::memory_order_relaxed ) );
+}
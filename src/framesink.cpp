@@ -0,0 +1,291 @@
+#include <framesink.h>
+#include <vsynctimeline.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+//-----------------------------------------------------------------------------
+// Purpose: Built-in sinks
+//-----------------------------------------------------------------------------
+class CStatisticsFrameSink : public IFrameSink
+{
+public:
+	CStatisticsFrameSink()
+	{
+		m_ulFrames = 0;
+		m_ulFrameIdGaps = 0;
+		m_ulLastFrameId = 0;
+		m_ulFirstPresentNs = 0;
+		m_ulLastPresentNs = 0;
+	}
+
+	virtual const char *GetName() const { return "stats"; }
+
+	virtual void ConsumeFrame( const FrameDescriptor_t &frame )
+	{
+		if ( m_ulFrames == 0 )
+			m_ulFirstPresentNs = frame.ulPresentNs;
+		else if ( frame.nFrameId > m_ulLastFrameId + 1 )
+			m_ulFrameIdGaps += frame.nFrameId - m_ulLastFrameId - 1;
+
+		m_ulLastFrameId = frame.nFrameId;
+		m_ulLastPresentNs = frame.ulPresentNs;
+		m_ulFrames++;
+	}
+
+	virtual void FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const
+	{
+		uint64_t ulFrames = m_ulFrames;
+		uint64_t ulSpanNs = m_ulLastPresentNs - m_ulFirstPresentNs;
+		snprintf( pchBuffer, unBufferSize, "frame_id_gaps=%llu present_fps=%.1f",
+			(unsigned long long)m_ulFrameIdGaps.load(), ulFrames > 1 && ulSpanNs ? (double)( ulFrames - 1 ) * 1e9 / (double)ulSpanNs : 0.0 );
+	}
+
+private:
+	std::atomic<uint64_t> m_ulFrames;
+	std::atomic<uint64_t> m_ulFrameIdGaps;
+	uint64_t m_ulLastFrameId;
+	std::atomic<uint64_t> m_ulFirstPresentNs;
+	std::atomic<uint64_t> m_ulLastPresentNs;
+};
+
+IFrameSink *CreateStatisticsFrameSink()
+{
+	return new CStatisticsFrameSink();
+}
+
+
+class CEncoderFrameSink : public IFrameSink
+{
+public:
+	CEncoderFrameSink( uint64_t ulCostNs ) : m_ulCostNs( ulCostNs ) {}
+
+	virtual const char *GetName() const { return "encoder"; }
+
+	virtual void ConsumeFrame( const FrameDescriptor_t &/* frame */ )
+	{
+		// busy rather than sleep: a real encoder occupies a core for its whole frame budget
+		uint64_t ulDoneNs = GetMonotonicNs() + m_ulCostNs;
+		while ( GetMonotonicNs() < ulDoneNs )
+		{
+		}
+	}
+
+	virtual void FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const
+	{
+		snprintf( pchBuffer, unBufferSize, "cost_us=%.1f", m_ulCostNs / 1000.0 );
+	}
+
+private:
+	uint64_t m_ulCostNs;
+};
+
+IFrameSink *CreateEncoderFrameSink( uint64_t ulCostNs )
+{
+	return new CEncoderFrameSink( ulCostNs );
+}
+
+
+class CRecorderFrameSink : public IFrameSink
+{
+public:
+	CRecorderFrameSink( FILE *pFile, const char *pchPath ) : m_pFile( pFile ), m_sPath( pchPath ), m_ulBytes( 0 ) {}
+
+	virtual ~CRecorderFrameSink()
+	{
+		fclose( m_pFile );
+	}
+
+	virtual const char *GetName() const { return "recorder"; }
+
+	virtual void ConsumeFrame( const FrameDescriptor_t &frame )
+	{
+		if ( fwrite( &frame, sizeof( frame ), 1, m_pFile ) == 1 )
+			m_ulBytes += sizeof( frame );
+	}
+
+	virtual void FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const
+	{
+		snprintf( pchBuffer, unBufferSize, "path=%s bytes=%llu", m_sPath.c_str(), (unsigned long long)m_ulBytes.load() );
+	}
+
+private:
+	FILE *m_pFile;
+	std::string m_sPath;
+	std::atomic<uint64_t> m_ulBytes;
+};
+
+IFrameSink *CreateRecorderFrameSink( const char *pchPath )
+{
+	FILE *pFile = fopen( pchPath, "wb" );
+	if ( !pFile )
+		return nullptr;
+	return new CRecorderFrameSink( pFile, pchPath );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Pipeline
+//-----------------------------------------------------------------------------
+static void UpdateMax( std::atomic<uint64_t> &ulMax, uint64_t ulValue )
+{
+	uint64_t ulCurrent = ulMax.load( std::memory_order_relaxed );
+	while ( ulValue > ulCurrent && !ulMax.compare_exchange_weak( ulCurrent, ulValue, std::memory_order_relaxed ) )
+	{
+	}
+}
+
+CFrameSinkPipeline::CFrameSinkPipeline()
+{
+	m_bRunning = false;
+}
+
+CFrameSinkPipeline::~CFrameSinkPipeline()
+{
+	Stop();
+	for ( SinkStage_t *pStage : m_vecStages )
+	{
+		delete pStage->pSink;
+		delete pStage;
+	}
+}
+
+void CFrameSinkPipeline::AddSink( IFrameSink *pSink )
+{
+	if ( m_bRunning || !pSink )
+		return;
+
+	SinkStage_t *pStage = new SinkStage_t;
+	pStage->pSink = pSink;
+	pStage->pThread = nullptr;
+	pStage->bWaiting = false;
+	pStage->ulSubmitted = 0;
+	pStage->ulDropped = 0;
+	pStage->ulConsumed = 0;
+	pStage->ulQueueNsTotal = 0;
+	pStage->ulQueueNsMax = 0;
+	pStage->ulWorkNsTotal = 0;
+	pStage->ulWorkNsMax = 0;
+	m_vecStages.push_back( pStage );
+}
+
+void CFrameSinkPipeline::Start()
+{
+	if ( m_bRunning )
+		return;
+
+	m_bRunning = true;
+	for ( SinkStage_t *pStage : m_vecStages )
+	{
+		pStage->pThread = new std::thread( &CFrameSinkPipeline::SinkThreadFunction, this, pStage );
+	}
+}
+
+void CFrameSinkPipeline::Stop()
+{
+	if ( !m_bRunning )
+		return;
+
+	m_bRunning = false;
+	for ( SinkStage_t *pStage : m_vecStages )
+	{
+		{
+			std::lock_guard<std::mutex> lock( pStage->mutex );
+		}
+		pStage->wake.notify_one();
+		pStage->pThread->join();
+		delete pStage->pThread;
+		pStage->pThread = nullptr;
+	}
+}
+
+void CFrameSinkPipeline::Submit( const FrameDescriptor_t &frame )
+{
+	if ( !m_bRunning )
+		return;
+
+	for ( SinkStage_t *pStage : m_vecStages )
+	{
+		pStage->ulSubmitted.fetch_add( 1, std::memory_order_relaxed );
+		if ( !pStage->queue.TryPush( frame ) )
+		{
+			pStage->ulDropped.fetch_add( 1, std::memory_order_relaxed );
+			continue;
+		}
+
+		// pairs with the fence in SinkThreadFunction: either the sink sees the frame
+		// before it sleeps, or we see that it is sleeping
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		if ( pStage->bWaiting.load( std::memory_order_relaxed ) )
+		{
+			{
+				std::lock_guard<std::mutex> lock( pStage->mutex );
+			}
+			pStage->wake.notify_one();
+		}
+	}
+}
+
+void CFrameSinkPipeline::SinkThreadFunction( SinkStage_t *pStage )
+{
+	for ( ;; )
+	{
+		FrameDescriptor_t frame;
+		if ( pStage->queue.TryPop( &frame ) )
+		{
+			uint64_t ulStartNs = GetMonotonicNs();
+			uint64_t ulQueueNs = ulStartNs > frame.ulPresentNs ? ulStartNs - frame.ulPresentNs : 0;
+
+			pStage->pSink->ConsumeFrame( frame );
+
+			uint64_t ulWorkNs = GetMonotonicNs() - ulStartNs;
+			pStage->ulQueueNsTotal.fetch_add( ulQueueNs, std::memory_order_relaxed );
+			UpdateMax( pStage->ulQueueNsMax, ulQueueNs );
+			pStage->ulWorkNsTotal.fetch_add( ulWorkNs, std::memory_order_relaxed );
+			UpdateMax( pStage->ulWorkNsMax, ulWorkNs );
+			pStage->ulConsumed.fetch_add( 1, std::memory_order_relaxed );
+			continue;
+		}
+
+		if ( !m_bRunning )
+			break;
+
+		std::unique_lock<std::mutex> lock( pStage->mutex );
+		pStage->bWaiting.store( true, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		pStage->wake.wait_for( lock, std::chrono::milliseconds( 5 ), [&] { return !pStage->queue.IsEmpty() || !m_bRunning; } );
+		pStage->bWaiting.store( false, std::memory_order_relaxed );
+	}
+}
+
+void CFrameSinkPipeline::FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const
+{
+	if ( unBufferSize == 0 )
+		return;
+	pchBuffer[0] = 0;
+
+	uint32_t unUsed = 0;
+	for ( const SinkStage_t *pStage : m_vecStages )
+	{
+		char rchSink[256];
+		pStage->pSink->FormatSummary( rchSink, sizeof( rchSink ) );
+
+		uint64_t ulConsumed = pStage->ulConsumed.load( std::memory_order_relaxed );
+		double flQueueUs = ulConsumed ? pStage->ulQueueNsTotal.load( std::memory_order_relaxed ) / 1000.0 / (double)ulConsumed : 0.0;
+		double flWorkUs = ulConsumed ? pStage->ulWorkNsTotal.load( std::memory_order_relaxed ) / 1000.0 / (double)ulConsumed : 0.0;
+
+		int nWritten = snprintf( pchBuffer + unUsed, unBufferSize - unUsed,
+			"%s submitted=%llu dropped=%llu consumed=%llu queue_us mean=%.1f max=%.1f work_us mean=%.1f max=%.1f %s\n",
+			pStage->pSink->GetName(),
+			(unsigned long long)pStage->ulSubmitted.load( std::memory_order_relaxed ),
+			(unsigned long long)pStage->ulDropped.load( std::memory_order_relaxed ),
+			(unsigned long long)ulConsumed,
+			flQueueUs, pStage->ulQueueNsMax.load( std::memory_order_relaxed ) / 1000.0,
+			flWorkUs, pStage->ulWorkNsMax.load( std::memory_order_relaxed ) / 1000.0,
+			rchSink );
+		if ( nWritten < 0 || (uint32_t)nWritten >= unBufferSize - unUsed )
+			break;
+		unUsed += (uint32_t)nWritten;
+	}
+}
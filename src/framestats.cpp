@@ -0,0 +1,160 @@
+#include <framestats.h>
+
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+
+CFrameStatsRing::CFrameStatsRing()
+{
+	for ( uint32_t i = 0; i < k_unCapacity; i++ )
+	{
+		m_slots[i].unSequence = 0;
+	}
+	m_ulWriteCount = 0;
+	m_ulPrevTargetFrame = 0;
+	m_ulMissedVsyncs = 0;
+	m_ulDuplicatedFrames = 0;
+	m_ulLateFrames = 0;
+}
+
+void CFrameStatsRing::PushFrame( uint64_t ulPresentNs, uint64_t nFrameId, uint64_t ulTargetFrame, uint64_t ulRequestedFrame )
+{
+	uint32_t unMissedVsyncs = 0;
+	uint32_t unFlags = 0;
+	if ( m_ulPrevTargetFrame != 0 )
+	{
+		if ( ulTargetFrame == m_ulPrevTargetFrame )
+		{
+			unFlags |= FrameRecord_Duplicated;
+		}
+		else if ( ulTargetFrame > m_ulPrevTargetFrame + 1 )
+		{
+			unMissedVsyncs = (uint32_t)( ulTargetFrame - m_ulPrevTargetFrame - 1 );
+			unFlags |= FrameRecord_Missed;
+		}
+	}
+	if ( ulRequestedFrame != 0 && ulTargetFrame > ulRequestedFrame )
+	{
+		unFlags |= FrameRecord_Late;
+	}
+	m_ulPrevTargetFrame = ulTargetFrame;
+
+	uint64_t ulIndex = m_ulWriteCount.load( std::memory_order_relaxed );
+	Slot_t &slot = m_slots[ ulIndex % k_unCapacity ];
+	uint32_t unSequence = slot.unSequence.load( std::memory_order_relaxed );
+	slot.unSequence.store( unSequence + 1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+	slot.ulPresentNs.store( ulPresentNs, std::memory_order_relaxed );
+	slot.nFrameId.store( nFrameId, std::memory_order_relaxed );
+	slot.ulTargetFrame.store( ulTargetFrame, std::memory_order_relaxed );
+	slot.ulWaitNs.store( 0, std::memory_order_relaxed );
+	slot.unMissedVsyncs.store( unMissedVsyncs, std::memory_order_relaxed );
+	slot.unFlags.store( unFlags, std::memory_order_relaxed );
+	slot.unSequence.store( unSequence + 2, std::memory_order_release );
+	m_ulWriteCount.store( ulIndex + 1, std::memory_order_release );
+
+	if ( unMissedVsyncs )
+		m_ulMissedVsyncs.fetch_add( unMissedVsyncs, std::memory_order_relaxed );
+	if ( unFlags & FrameRecord_Duplicated )
+		m_ulDuplicatedFrames.fetch_add( 1, std::memory_order_relaxed );
+	if ( unFlags & FrameRecord_Late )
+		m_ulLateFrames.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void CFrameStatsRing::SetLastWait( uint64_t ulWaitNs )
+{
+	uint64_t ulCount = m_ulWriteCount.load( std::memory_order_relaxed );
+	if ( ulCount == 0 )
+		return;
+
+	Slot_t &slot = m_slots[ ( ulCount - 1 ) % k_unCapacity ];
+	uint32_t unSequence = slot.unSequence.load( std::memory_order_relaxed );
+	slot.unSequence.store( unSequence + 1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+	slot.ulWaitNs.store( ulWaitNs, std::memory_order_relaxed );
+	slot.unSequence.store( unSequence + 2, std::memory_order_release );
+}
+
+uint32_t CFrameStatsRing::Snapshot( FrameRecord_t *pRecords, uint32_t unMaxRecords ) const
+{
+	uint64_t ulCount = m_ulWriteCount.load( std::memory_order_acquire );
+	uint64_t ulAvailable = std::min<uint64_t>( ulCount, k_unCapacity - 1 );
+	uint32_t unWanted = (uint32_t)std::min<uint64_t>( ulAvailable, unMaxRecords );
+
+	uint32_t unCopied = 0;
+	for ( uint64_t ulIndex = ulCount - unWanted; ulIndex < ulCount; ulIndex++ )
+	{
+		const Slot_t &slot = m_slots[ ulIndex % k_unCapacity ];
+		FrameRecord_t record;
+		uint32_t unBefore, unAfter;
+		do
+		{
+			unBefore = slot.unSequence.load( std::memory_order_acquire );
+			record.ulPresentNs = slot.ulPresentNs.load( std::memory_order_relaxed );
+			record.nFrameId = slot.nFrameId.load( std::memory_order_relaxed );
+			record.ulTargetFrame = slot.ulTargetFrame.load( std::memory_order_relaxed );
+			record.ulWaitNs = slot.ulWaitNs.load( std::memory_order_relaxed );
+			record.unMissedVsyncs = slot.unMissedVsyncs.load( std::memory_order_relaxed );
+			record.unFlags = slot.unFlags.load( std::memory_order_relaxed );
+			std::atomic_thread_fence( std::memory_order_acquire );
+			unAfter = slot.unSequence.load( std::memory_order_relaxed );
+		} while ( ( unBefore & 1 ) || unBefore != unAfter );
+
+		// the writer lapped us while copying; older slots now hold newer frames
+		if ( m_ulWriteCount.load( std::memory_order_acquire ) - ulIndex >= k_unCapacity )
+			continue;
+
+		pRecords[ unCopied++ ] = record;
+	}
+	return unCopied;
+}
+
+static double Percentile( const std::vector<uint64_t> &vecSorted, double flFraction )
+{
+	if ( vecSorted.empty() )
+		return 0.0;
+	size_t nIndex = (size_t)( flFraction * (double)( vecSorted.size() - 1 ) + 0.5 );
+	return (double)vecSorted[ std::min( nIndex, vecSorted.size() - 1 ) ];
+}
+
+void CFrameStatsRing::FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const
+{
+	if ( unBufferSize == 0 )
+		return;
+
+	std::vector<FrameRecord_t> vecRecords( k_unCapacity );
+	uint32_t unCount = Snapshot( vecRecords.data(), k_unCapacity );
+
+	std::vector<uint64_t> vecIntervals;
+	std::vector<uint64_t> vecWaits;
+	uint32_t unMissed = 0, unDuplicated = 0, unLate = 0;
+	for ( uint32_t i = 0; i < unCount; i++ )
+	{
+		const FrameRecord_t &record = vecRecords[i];
+		if ( i > 0 && record.ulPresentNs >= vecRecords[ i - 1 ].ulPresentNs )
+			vecIntervals.push_back( record.ulPresentNs - vecRecords[ i - 1 ].ulPresentNs );
+		vecWaits.push_back( record.ulWaitNs );
+		unMissed += record.unMissedVsyncs;
+		if ( record.unFlags & FrameRecord_Duplicated )
+			unDuplicated++;
+		if ( record.unFlags & FrameRecord_Late )
+			unLate++;
+	}
+	std::sort( vecIntervals.begin(), vecIntervals.end() );
+	std::sort( vecWaits.begin(), vecWaits.end() );
+
+	snprintf( pchBuffer, unBufferSize,
+		"frames=%u\n"
+		"interval_ms p50=%.3f p99=%.3f p99.9=%.3f max=%.3f\n"
+		"wait_ms p50=%.3f p99=%.3f max=%.3f\n"
+		"window missed_vsyncs=%u duplicated=%u late=%u\n"
+		"total missed_vsyncs=%llu duplicated=%llu late=%llu\n",
+		unCount,
+		Percentile( vecIntervals, 0.5 ) * 1e-6, Percentile( vecIntervals, 0.99 ) * 1e-6,
+		Percentile( vecIntervals, 0.999 ) * 1e-6, Percentile( vecIntervals, 1.0 ) * 1e-6,
+		Percentile( vecWaits, 0.5 ) * 1e-6, Percentile( vecWaits, 0.99 ) * 1e-6, Percentile( vecWaits, 1.0 ) * 1e-6,
+		unMissed, unDuplicated, unLate,
+		(unsigned long long)m_ulMissedVsyncs.load( std::memory_order_relaxed ),
+		(unsigned long long)m_ulDuplicatedFrames.load( std::memory_order_relaxed ),
+		(unsigned long long)m_ulLateFrames.load( std::memory_order_relaxed ) );
+}
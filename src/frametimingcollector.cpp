@@ -0,0 +1,214 @@
+#include <frametimingcollector.h>
+#include <vsynctimeline.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+// enough for 100 ms of polling at the highest refresh rate we run
+static const uint32_t k_unBatchFrames = 128;
+
+static float Percentile( float *pflValues, uint32_t unCount, float flFraction )
+{
+	if ( unCount == 0 )
+		return 0.f;
+	uint32_t unIndex = std::min( (uint32_t)( flFraction * unCount ), unCount - 1 );
+	std::nth_element( pflValues, pflValues + unIndex, pflValues + unCount );
+	return pflValues[ unIndex ];
+}
+
+CFrameTimingCollector::CFrameTimingCollector()
+{
+	m_ulSamples = 0;
+	m_unLastFrameIndex = 0;
+	m_ulPolls = 0;
+	m_ulDuplicates = 0;
+	m_ulMissedFrames = 0;
+	m_pThread = nullptr;
+	m_unPollMs = 100;
+	m_bStopping = false;
+}
+
+CFrameTimingCollector::~CFrameTimingCollector()
+{
+	Stop();
+}
+
+void CFrameTimingCollector::Start( uint32_t unPollMs )
+{
+	if ( m_pThread )
+		return;
+
+	m_unPollMs = unPollMs ? unPollMs : 1;
+	m_bStopping = false;
+	m_pThread = new std::thread( &CFrameTimingCollector::CollectorThread, this );
+}
+
+void CFrameTimingCollector::Stop()
+{
+	if ( !m_pThread )
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_bStopping = true;
+	}
+	m_stopCondition.notify_all();
+	m_pThread->join();
+	delete m_pThread;
+	m_pThread = nullptr;
+}
+
+void CFrameTimingCollector::CollectorThread()
+{
+	// only the first entry's size is read; the runtime infers the rest
+	vr::Compositor_FrameTiming *pTimings = new vr::Compositor_FrameTiming[ k_unBatchFrames ];
+	memset( pTimings, 0, sizeof( vr::Compositor_FrameTiming ) );
+	pTimings[0].m_nSize = sizeof( vr::Compositor_FrameTiming );
+
+	uint64_t ulNextPollNs = GetMonotonicNs();
+	for ( ;; )
+	{
+		ulNextPollNs += (uint64_t)m_unPollMs * 1000000;
+		{
+			std::unique_lock<std::mutex> lock( m_mutex );
+			std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point( std::chrono::nanoseconds( ulNextPollNs ) );
+			if ( m_stopCondition.wait_until( lock, deadline, [&] { return m_bStopping; } ) )
+				break;
+		}
+
+		// a stall should not turn into a burst of back to back polls
+		uint64_t ulNowNs = GetMonotonicNs();
+		if ( ulNextPollNs < ulNowNs )
+			ulNextPollNs = ulNowNs;
+
+		pTimings[0].m_nSize = sizeof( vr::Compositor_FrameTiming );
+		uint32_t unCount = vr::VRServerDriverHost()->GetFrameTimings( pTimings, k_unBatchFrames );
+		AddTimings( pTimings, std::min( unCount, k_unBatchFrames ) );
+	}
+
+	delete[] pTimings;
+}
+
+void CFrameTimingCollector::AddTimings( const vr::Compositor_FrameTiming *pTimings, uint32_t unCount )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	m_ulPolls++;
+
+	for ( uint32_t i = 0; i < unCount; i++ )
+	{
+		const vr::Compositor_FrameTiming &timing = pTimings[i];
+
+		// batches overlap; anything at or before the newest frame we have is a repeat
+		if ( m_ulSamples && (int32_t)( timing.m_nFrameIndex - m_unLastFrameIndex ) <= 0 )
+		{
+			m_ulDuplicates++;
+			continue;
+		}
+		if ( m_ulSamples && timing.m_nFrameIndex - m_unLastFrameIndex > 1 )
+			m_ulMissedFrames += timing.m_nFrameIndex - m_unLastFrameIndex - 1;
+
+		Sample_t &sample = m_rSamples[ m_ulSamples % k_unWindowFrames ];
+		sample.unFrameIndex = timing.m_nFrameIndex;
+		sample.flGpuMs = timing.m_flTotalRenderGpuMs;
+		sample.flAppCpuMs = std::max( timing.m_flNewFrameReadyMs - timing.m_flWaitGetPosesCalledMs, 0.f );
+		sample.flCompositorCpuMs = timing.m_flCompositorRenderCpuMs;
+		sample.flIdleMs = timing.m_flCompositorIdleCpuMs;
+		sample.unReprojectionFlags = timing.m_nReprojectionFlags;
+		sample.unDroppedFrames = timing.m_nNumDroppedFrames;
+		sample.unMisPresented = timing.m_nNumMisPresented;
+
+		m_unLastFrameIndex = timing.m_nFrameIndex;
+		m_ulSamples++;
+	}
+}
+
+bool CFrameTimingCollector::GetAggregates( FrameTimingAggregates_t *pAggregates, uint32_t unSinceFrameIndex ) const
+{
+	memset( pAggregates, 0, sizeof( *pAggregates ) );
+
+	float rflGpuMs[ k_unWindowFrames ];
+	float rflAppCpuMs[ k_unWindowFrames ];
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+	if ( m_ulSamples == 0 )
+		return false;
+
+	uint32_t unWindow = (uint32_t)std::min<uint64_t>( m_ulSamples, k_unWindowFrames );
+	uint32_t unFrames = 0;
+	double flGpuMs = 0.0, flAppCpuMs = 0.0, flCompositorCpuMs = 0.0, flIdleMs = 0.0;
+	for ( uint32_t i = 0; i < unWindow; i++ )
+	{
+		const Sample_t &sample = m_rSamples[i];
+		if ( unSinceFrameIndex && (int32_t)( sample.unFrameIndex - unSinceFrameIndex ) <= 0 )
+			continue;
+
+		rflGpuMs[ unFrames ] = sample.flGpuMs;
+		rflAppCpuMs[ unFrames ] = sample.flAppCpuMs;
+		unFrames++;
+		flGpuMs += sample.flGpuMs;
+		flAppCpuMs += sample.flAppCpuMs;
+		flCompositorCpuMs += sample.flCompositorCpuMs;
+		flIdleMs += sample.flIdleMs;
+
+		if ( sample.unReprojectionFlags & vr::VRCompositor_ReprojectionReason_Cpu )
+			pAggregates->unCpuReprojected++;
+		if ( sample.unReprojectionFlags & vr::VRCompositor_ReprojectionReason_Gpu )
+			pAggregates->unGpuReprojected++;
+		if ( sample.unReprojectionFlags & vr::VRCompositor_ReprojectionMotion )
+			pAggregates->unMotionSmoothed++;
+		if ( sample.unReprojectionFlags & vr::VRCompositor_ThrottleMask )
+			pAggregates->unThrottled++;
+		if ( sample.unReprojectionFlags & vr::VRCompositor_PredictionMask )
+			pAggregates->unPredicted++;
+		pAggregates->unDropped += sample.unDroppedFrames;
+		pAggregates->unMisPresented += sample.unMisPresented;
+	}
+	if ( unFrames == 0 )
+		return false;
+
+	const Sample_t &latest = m_rSamples[ ( m_ulSamples - 1 ) % k_unWindowFrames ];
+	pAggregates->unLatestThrottledFrames = ( latest.unReprojectionFlags & vr::VRCompositor_ThrottleMask ) >> 6;
+	pAggregates->unLatestPredictedFrames = ( latest.unReprojectionFlags & vr::VRCompositor_PredictionMask ) >> 4;
+
+	pAggregates->unFrames = unFrames;
+	pAggregates->unLastFrameIndex = m_unLastFrameIndex;
+	pAggregates->flGpuMsMean = (float)( flGpuMs / unFrames );
+	pAggregates->flGpuMsP95 = Percentile( rflGpuMs, unFrames, 0.95f );
+	pAggregates->flAppCpuMsMean = (float)( flAppCpuMs / unFrames );
+	pAggregates->flAppCpuMsP95 = Percentile( rflAppCpuMs, unFrames, 0.95f );
+	pAggregates->flCompositorCpuMsMean = (float)( flCompositorCpuMs / unFrames );
+	pAggregates->flIdleMsMean = (float)( flIdleMs / unFrames );
+	return true;
+}
+
+void CFrameTimingCollector::FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const
+{
+	FrameTimingAggregates_t aggregates;
+	GetAggregates( &aggregates );
+
+	uint64_t ulPolls, ulDuplicates, ulMissedFrames;
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		ulPolls = m_ulPolls;
+		ulDuplicates = m_ulDuplicates;
+		ulMissedFrames = m_ulMissedFrames;
+	}
+
+	snprintf( pchBuffer, unBufferSize,
+		"frames=%u last_frame_index=%u polls=%llu duplicates=%llu missed=%llu\n"
+		"gpu_ms mean=%.2f p95=%.2f\n"
+		"app_cpu_ms mean=%.2f p95=%.2f\n"
+		"compositor_cpu_ms mean=%.2f idle_ms mean=%.2f\n"
+		"reprojected cpu=%u gpu=%u motion=%u\n"
+		"throttled=%u predicted=%u dropped=%u mis_presented=%u latest_throttle=%u latest_predicted=%u\n",
+		aggregates.unFrames, aggregates.unLastFrameIndex, (unsigned long long)ulPolls, (unsigned long long)ulDuplicates, (unsigned long long)ulMissedFrames,
+		aggregates.flGpuMsMean, aggregates.flGpuMsP95,
+		aggregates.flAppCpuMsMean, aggregates.flAppCpuMsP95,
+		aggregates.flCompositorCpuMsMean, aggregates.flIdleMsMean,
+		aggregates.unCpuReprojected, aggregates.unGpuReprojected, aggregates.unMotionSmoothed,
+		aggregates.unThrottled, aggregates.unPredicted, aggregates.unDropped, aggregates.unMisPresented,
+		aggregates.unLatestThrottledFrames, aggregates.unLatestPredictedFrames );
+}
@@ -0,0 +1,284 @@
+#include <hiddenarea.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+static const uint32_t k_unHiddenAreaMagic = 0x41485653;	// "SVHA"
+
+// bump when the generator changes, so cached meshes of an older one are regenerated
+static const uint32_t k_unHiddenAreaVersion = 1;
+
+static const uint32_t k_unMinRays = 8;
+static const uint32_t k_unBisectionSteps = 24;
+
+// an inverse solve further off than this did not converge and counts as not visible
+static const float k_flMaxInverseResidual = 1e-4f;
+
+struct HiddenAreaFileHeader_t
+{
+	uint32_t unMagic;
+	uint32_t unVersion;
+	uint64_t ulHash;
+	uint32_t rrunVertexCount[2][ vr::k_eHiddenAreaMesh_Max ];
+};
+
+static uint64_t HashBytes( uint64_t ulHash, const void *pData, uint32_t unBytes )
+{
+	const uint8_t *pubData = (const uint8_t *)pData;
+	for ( uint32_t i = 0; i < unBytes; i++ )
+	{
+		ulHash = ( ulHash ^ pubData[i] ) * 0x100000001b3ull;
+	}
+	return ulHash;
+}
+
+static vr::HmdVector2_t MakeVector( float x, float y )
+{
+	vr::HmdVector2_t v;
+	v.v[0] = x;
+	v.v[1] = y;
+	return v;
+}
+
+/** Whether any channel samples render target point (fU, fV) for a display pixel inside the viewport and the aperture */
+static bool IsVisible( vr::EVREye eEye, const CLensModel::EyeTerms_t &terms, const CInverseDistortion &inverse, float flApertureRadius, float fU, float fV )
+{
+	for ( uint32_t unChannel = 0; unChannel < LensChannel_Count; unChannel++ )
+	{
+		float fDisplayU, fDisplayV;
+		if ( !( inverse.Solve( eEye, (ELensChannel)unChannel, fU, fV, &fDisplayU, &fDisplayV ) <= k_flMaxInverseResidual ) )
+			continue;
+		if ( fDisplayU < 0.f || fDisplayU > 1.f || fDisplayV < 0.f || fDisplayV > 1.f )
+			continue;
+
+		float x = ( fDisplayU - terms.flCentreU ) * terms.flLensScaleU;
+		float y = ( fDisplayV - terms.flCentreV ) * 2.f;
+		if ( flApertureRadius > 0.f && x * x + y * y > flApertureRadius * flApertureRadius )
+			continue;
+		return true;
+	}
+	return false;
+}
+
+
+CHiddenAreaMeshes::CHiddenAreaMeshes()
+{
+}
+
+uint64_t CHiddenAreaMeshes::HashConfig( const LensConfig_t &config, float flApertureRadius, uint32_t unVertexBudget )
+{
+	uint64_t ulHash = 0xcbf29ce484222325ull;
+	ulHash = HashBytes( ulHash, &k_unHiddenAreaVersion, sizeof( k_unHiddenAreaVersion ) );
+	ulHash = HashBytes( ulHash, &config, sizeof( config ) );
+	ulHash = HashBytes( ulHash, &flApertureRadius, sizeof( flApertureRadius ) );
+	ulHash = HashBytes( ulHash, &unVertexBudget, sizeof( unVertexBudget ) );
+	return ulHash;
+}
+
+void CHiddenAreaMeshes::Generate( const CLensModel &model, const CInverseDistortion &inverse, float flApertureRadius, uint32_t unVertexBudget )
+{
+	// every ray can add two hidden triangles, six vertices
+	uint32_t unRays = std::max( unVertexBudget / 6, k_unMinRays );
+	GenerateEye( vr::Eye_Left, model, inverse, flApertureRadius, unRays );
+	GenerateEye( vr::Eye_Right, model, inverse, flApertureRadius, unRays );
+}
+
+void CHiddenAreaMeshes::GenerateEye( vr::EVREye eEye, const CLensModel &model, const CInverseDistortion &inverse, float flApertureRadius, uint32_t unRays )
+{
+	const CLensModel::EyeTerms_t &terms = model.GetEyeTerms( eEye );
+	float flCentreU = terms.flCentreU;
+	float flCentreV = terms.flCentreV;
+
+	// evenly spread rays plus one through each corner, so the border between neighbouring rays is a straight edge
+	std::vector<float> vecAngles;
+	for ( uint32_t i = 0; i + 4 < unRays; i++ )
+	{
+		vecAngles.push_back( (float)( 2.0 * M_PI * i / ( unRays - 4 ) ) );
+	}
+	const float rrflCorners[4][2] = { { 0.f, 0.f }, { 1.f, 0.f }, { 1.f, 1.f }, { 0.f, 1.f } };
+	for ( uint32_t i = 0; i < 4; i++ )
+	{
+		float flAngle = atan2f( rrflCorners[i][1] - flCentreV, rrflCorners[i][0] - flCentreU );
+		vecAngles.push_back( flAngle < 0.f ? flAngle + (float)( 2.0 * M_PI ) : flAngle );
+	}
+	std::sort( vecAngles.begin(), vecAngles.end() );
+
+	// outline and border point of each ray
+	uint32_t unCount = (uint32_t)vecAngles.size();
+	std::vector<vr::HmdVector2_t> vecOutline( unCount );
+	std::vector<vr::HmdVector2_t> vecBorder( unCount );
+	std::vector<bool> vecClipped( unCount );
+	for ( uint32_t i = 0; i < unCount; i++ )
+	{
+		float flDirU = cosf( vecAngles[i] );
+		float flDirV = sinf( vecAngles[i] );
+		float flBorder = INFINITY;
+		if ( fabsf( flDirU ) > 1e-6f )
+			flBorder = std::min( flBorder, ( flDirU > 0.f ? 1.f - flCentreU : -flCentreU ) / flDirU );
+		if ( fabsf( flDirV ) > 1e-6f )
+			flBorder = std::min( flBorder, ( flDirV > 0.f ? 1.f - flCentreV : -flCentreV ) / flDirV );
+		flBorder = std::max( flBorder, 0.f );
+
+		// visibility falls off once along a ray from the centre, so bisect for the edge
+		float flVisible = flBorder;
+		if ( !IsVisible( eEye, terms, inverse, flApertureRadius, flCentreU + flDirU * flBorder, flCentreV + flDirV * flBorder ) )
+		{
+			float flLow = 0.f;
+			float flHigh = flBorder;
+			for ( uint32_t unStep = 0; unStep < k_unBisectionSteps; unStep++ )
+			{
+				float flMid = 0.5f * ( flLow + flHigh );
+				if ( IsVisible( eEye, terms, inverse, flApertureRadius, flCentreU + flDirU * flMid, flCentreV + flDirV * flMid ) )
+					flLow = flMid;
+				else
+					flHigh = flMid;
+			}
+			flVisible = flLow;
+		}
+
+		vecOutline[i] = MakeVector( flCentreU + flDirU * flVisible, flCentreV + flDirV * flVisible );
+		vecBorder[i] = MakeVector( flCentreU + flDirU * flBorder, flCentreV + flDirV * flBorder );
+		vecClipped[i] = flVisible < flBorder;
+	}
+
+	uint32_t unEye = eEye == vr::Eye_Left ? 0 : 1;
+	std::vector<vr::HmdVector2_t> &vecHidden = m_rrvecMeshes[ unEye ][ vr::k_eHiddenAreaMesh_Standard ];
+	std::vector<vr::HmdVector2_t> &vecVisible = m_rrvecMeshes[ unEye ][ vr::k_eHiddenAreaMesh_Inverse ];
+	std::vector<vr::HmdVector2_t> &vecLoop = m_rrvecMeshes[ unEye ][ vr::k_eHiddenAreaMesh_LineLoop ];
+	vecHidden.clear();
+	vecVisible.clear();
+	vecLoop = vecOutline;
+
+	vr::HmdVector2_t centre = MakeVector( flCentreU, flCentreV );
+	for ( uint32_t i = 0; i < unCount; i++ )
+	{
+		uint32_t j = ( i + 1 ) % unCount;
+		vecVisible.push_back( centre );
+		vecVisible.push_back( vecOutline[i] );
+		vecVisible.push_back( vecOutline[j] );
+
+		// wedges where the whole ray reaches the border hide nothing
+		if ( !vecClipped[i] && !vecClipped[j] )
+			continue;
+		vecHidden.push_back( vecOutline[i] );
+		vecHidden.push_back( vecBorder[i] );
+		vecHidden.push_back( vecBorder[j] );
+		vecHidden.push_back( vecOutline[i] );
+		vecHidden.push_back( vecBorder[j] );
+		vecHidden.push_back( vecOutline[j] );
+	}
+}
+
+float CHiddenAreaMeshes::GetHiddenFraction( vr::EVREye eEye ) const
+{
+	const std::vector<vr::HmdVector2_t> &vecHidden = m_rrvecMeshes[ eEye == vr::Eye_Left ? 0 : 1 ][ vr::k_eHiddenAreaMesh_Standard ];
+	double flArea = 0.0;
+	for ( size_t i = 0; i + 3 <= vecHidden.size(); i += 3 )
+	{
+		const float *a = vecHidden[i].v;
+		const float *b = vecHidden[ i + 1 ].v;
+		const float *c = vecHidden[ i + 2 ].v;
+		flArea += fabs( ( b[0] - a[0] ) * ( c[1] - a[1] ) - ( c[0] - a[0] ) * ( b[1] - a[1] ) ) * 0.5;
+	}
+	return (float)flArea;
+}
+
+bool CHiddenAreaMeshes::Load( const char *pchPath, uint64_t ulHash )
+{
+	FILE *pFile = fopen( pchPath, "rb" );
+	if ( !pFile )
+		return false;
+
+	HiddenAreaFileHeader_t header;
+	bool bLoaded = fread( &header, sizeof( header ), 1, pFile ) == 1
+		&& header.unMagic == k_unHiddenAreaMagic
+		&& header.unVersion == k_unHiddenAreaVersion
+		&& header.ulHash == ulHash;
+
+	std::vector<vr::HmdVector2_t> rrvecMeshes[2][ vr::k_eHiddenAreaMesh_Max ];
+	for ( uint32_t unEye = 0; unEye < 2 && bLoaded; unEye++ )
+	{
+		for ( uint32_t unType = 0; unType < vr::k_eHiddenAreaMesh_Max && bLoaded; unType++ )
+		{
+			// a few thousand vertices is plenty; anything larger is a damaged file
+			uint32_t unVertices = header.rrunVertexCount[ unEye ][ unType ];
+			bLoaded = unVertices <= 1000000;
+			if ( bLoaded && unVertices )
+			{
+				rrvecMeshes[ unEye ][ unType ].resize( unVertices );
+				bLoaded = fread( rrvecMeshes[ unEye ][ unType ].data(), sizeof( vr::HmdVector2_t ), unVertices, pFile ) == unVertices;
+			}
+		}
+	}
+	fclose( pFile );
+
+	bLoaded = bLoaded && !rrvecMeshes[0][ vr::k_eHiddenAreaMesh_LineLoop ].empty();
+	if ( !bLoaded )
+		return false;
+
+	for ( uint32_t unEye = 0; unEye < 2; unEye++ )
+	{
+		for ( uint32_t unType = 0; unType < vr::k_eHiddenAreaMesh_Max; unType++ )
+			m_rrvecMeshes[ unEye ][ unType ].swap( rrvecMeshes[ unEye ][ unType ] );
+	}
+	return true;
+}
+
+bool CHiddenAreaMeshes::Save( const char *pchPath, uint64_t ulHash ) const
+{
+	HiddenAreaFileHeader_t header;
+	memset( &header, 0, sizeof( header ) );
+	header.unMagic = k_unHiddenAreaMagic;
+	header.unVersion = k_unHiddenAreaVersion;
+	header.ulHash = ulHash;
+	for ( uint32_t unEye = 0; unEye < 2; unEye++ )
+	{
+		for ( uint32_t unType = 0; unType < vr::k_eHiddenAreaMesh_Max; unType++ )
+			header.rrunVertexCount[ unEye ][ unType ] = (uint32_t)m_rrvecMeshes[ unEye ][ unType ].size();
+	}
+
+	// written aside and renamed, so two drivers starting together never read half a file
+	std::string sTempPath = std::string( pchPath ) + ".tmp";
+	FILE *pFile = fopen( sTempPath.c_str(), "wb" );
+	if ( !pFile )
+		return false;
+
+	bool bWritten = fwrite( &header, sizeof( header ), 1, pFile ) == 1;
+	for ( uint32_t unEye = 0; unEye < 2 && bWritten; unEye++ )
+	{
+		for ( uint32_t unType = 0; unType < vr::k_eHiddenAreaMesh_Max && bWritten; unType++ )
+		{
+			const std::vector<vr::HmdVector2_t> &vecMesh = m_rrvecMeshes[ unEye ][ unType ];
+			bWritten = vecMesh.empty() || fwrite( vecMesh.data(), sizeof( vr::HmdVector2_t ), vecMesh.size(), pFile ) == vecMesh.size();
+		}
+	}
+	bWritten = fclose( pFile ) == 0 && bWritten;
+	if ( !bWritten || rename( sTempPath.c_str(), pchPath ) != 0 )
+	{
+		unlink( sTempPath.c_str() );
+		return false;
+	}
+	return true;
+}
+
+void CHiddenAreaMeshes::FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const
+{
+	uint32_t unUsed = 0;
+	for ( uint32_t unEye = 0; unEye < 2 && unUsed < unBufferSize; unEye++ )
+	{
+		vr::EVREye eEye = unEye == 0 ? vr::Eye_Left : vr::Eye_Right;
+		int nWritten = snprintf( pchBuffer + unUsed, unBufferSize - unUsed, "eye=%s hidden_vertices=%u visible_vertices=%u loop_vertices=%u hidden_fraction=%.4f\n",
+			unEye == 0 ? "left" : "right",
+			(uint32_t)m_rrvecMeshes[ unEye ][ vr::k_eHiddenAreaMesh_Standard ].size(),
+			(uint32_t)m_rrvecMeshes[ unEye ][ vr::k_eHiddenAreaMesh_Inverse ].size(),
+			(uint32_t)m_rrvecMeshes[ unEye ][ vr::k_eHiddenAreaMesh_LineLoop ].size(),
+			GetHiddenFraction( eEye ) );
+		if ( nWritten > 0 )
+			unUsed += (uint32_t)nWritten;
+	}
+}
@@ -0,0 +1,534 @@
+#include <inversedistortion.h>
+#include <vsynctimeline.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#define INVERSE_X86
+#include <immintrin.h>
+#elif defined( __aarch64__ )
+#define INVERSE_NEON
+#include <arm_neon.h>
+#endif
+
+// the seed grid is solved to convergence once, so it may take many steps
+static const uint32_t k_unSeedIterations = 50;
+
+// a Jacobian this close to singular means the lens folds over; the point keeps its estimate
+static const float k_flMinDeterminant = 1e-12f;
+
+static const uint32_t k_unBenchmarkBlock = 4096;
+
+typedef float ( *PfnInverseKernel )( const CInverseDistortion::Job_t &job, const float *pflU, const float *pflV, uint32_t unCount,
+	float *pflOutU, float *pflOutV );
+
+// --------------------------------------------------------------------------
+// Scalar kernel. Lens coordinates are the ones CLensModel works in; the
+// solve finds (x, y) with (x R + tx, y R + ty) equal to the target g, where
+// R is the channel's radial polynomial and t the tangential terms.
+// --------------------------------------------------------------------------
+static inline void SeedPoint( const CInverseDistortion::Job_t &job, float fU, float fV, float *pflX, float *pflY )
+{
+	// outside the texture the edge cells are extrapolated
+	float flX = fU * job.unSeedCells;
+	float flY = fV * job.unSeedCells;
+	int32_t nCell = (int32_t)job.unSeedCells - 1;
+	int32_t nX = std::min( std::max( (int32_t)floorf( flX ), 0 ), nCell );
+	int32_t nY = std::min( std::max( (int32_t)floorf( flY ), 0 ), nCell );
+	float flFracX = flX - nX;
+	float flFracY = flY - nY;
+
+	uint32_t unNodes = job.unSeedCells + 1;
+	uint32_t i = nY * unNodes + nX;
+	const float *rpflSeed[2] = { job.pflSeedX, job.pflSeedY };
+	float *rpflOut[2] = { pflX, pflY };
+	for ( uint32_t unAxis = 0; unAxis < 2; unAxis++ )
+	{
+		const float *s = rpflSeed[ unAxis ];
+		float flTop = s[i] + ( s[ i + 1 ] - s[i] ) * flFracX;
+		float flBottom = s[ i + unNodes ] + ( s[ i + unNodes + 1 ] - s[ i + unNodes ] ) * flFracX;
+		*rpflOut[ unAxis ] = flTop + ( flBottom - flTop ) * flFracY;
+	}
+}
+
+/** Distortion of (x, y) minus the target, in lens units, and optionally the Jacobian, which is symmetric */
+static inline void EvaluateLensError( const CInverseDistortion::Job_t &job, float x, float y, float flTargetX, float flTargetY,
+	float *pflErrorX, float *pflErrorY, float *pflJ00, float *pflJ01, float *pflJ11 )
+{
+	const CLensModel::EyeTerms_t &terms = *job.pTerms;
+	const float *k = job.pflRadial;
+	float p1 = terms.flTangentialP1;
+	float p2 = terms.flTangentialP2;
+
+	float xx = x * x;
+	float yy = y * y;
+	float xy = x * y;
+	float r2 = xx + yy;
+	float flRadial = 1.f + r2 * ( k[0] + r2 * ( k[1] + r2 * k[2] ) );
+	*pflErrorX = x * flRadial + ( 2.f * p1 * xy + p2 * ( r2 + 2.f * xx ) ) - flTargetX;
+	*pflErrorY = y * flRadial + ( p1 * ( r2 + 2.f * yy ) + 2.f * p2 * xy ) - flTargetY;
+	if ( !pflJ00 )
+		return;
+
+	// dR/d(r^2); d(r^2)/dx = 2x
+	float flRadialSlope = k[0] + r2 * ( 2.f * k[1] + r2 * 3.f * k[2] );
+	*pflJ00 = flRadial + 2.f * xx * flRadialSlope + 2.f * p1 * y + 6.f * p2 * x;
+	*pflJ01 = 2.f * xy * flRadialSlope + 2.f * p1 * x + 2.f * p2 * y;
+	*pflJ11 = flRadial + 2.f * yy * flRadialSlope + 6.f * p1 * y + 2.f * p2 * x;
+}
+
+static inline void NewtonPoint( const CInverseDistortion::Job_t &job, float flTargetX, float flTargetY, uint32_t unIterations, float *pflX, float *pflY )
+{
+	float x = *pflX;
+	float y = *pflY;
+	for ( uint32_t unIteration = 0; unIteration < unIterations; unIteration++ )
+	{
+		float flErrorX, flErrorY, j00, j01, j11;
+		EvaluateLensError( job, x, y, flTargetX, flTargetY, &flErrorX, &flErrorY, &j00, &j01, &j11 );
+		float flDeterminant = j00 * j11 - j01 * j01;
+		float flInverse = fabsf( flDeterminant ) > k_flMinDeterminant ? 1.f / flDeterminant : 0.f;
+		x -= ( j11 * flErrorX - j01 * flErrorY ) * flInverse;
+		y -= ( j00 * flErrorY - j01 * flErrorX ) * flInverse;
+	}
+	*pflX = x;
+	*pflY = y;
+}
+
+/** Squared residual of a solution in texture units */
+static inline float ResidualSquared( const CInverseDistortion::Job_t &job, float flTargetX, float flTargetY, float x, float y )
+{
+	float flErrorX, flErrorY;
+	EvaluateLensError( job, x, y, flTargetX, flTargetY, &flErrorX, &flErrorY, nullptr, nullptr, nullptr );
+	flErrorX *= job.pTerms->flTextureScaleU;
+	flErrorY *= job.pTerms->flTextureScaleV;
+	return flErrorX * flErrorX + flErrorY * flErrorY;
+}
+
+static float SolveRange( const CInverseDistortion::Job_t &job, const float *pflU, const float *pflV, uint32_t unBegin, uint32_t unEnd,
+	float *pflOutU, float *pflOutV )
+{
+	const CLensModel::EyeTerms_t &terms = *job.pTerms;
+	float flMaxResidual2 = 0.f;
+	for ( uint32_t i = unBegin; i < unEnd; i++ )
+	{
+		float flTargetX = ( pflU[i] - terms.flCentreU ) / terms.flTextureScaleU;
+		float flTargetY = ( pflV[i] - terms.flCentreV ) / terms.flTextureScaleV;
+		float x, y;
+		SeedPoint( job, pflU[i], pflV[i], &x, &y );
+		NewtonPoint( job, flTargetX, flTargetY, job.unIterations, &x, &y );
+		flMaxResidual2 = std::max( flMaxResidual2, ResidualSquared( job, flTargetX, flTargetY, x, y ) );
+		pflOutU[i] = x / terms.flLensScaleU + terms.flCentreU;
+		pflOutV[i] = y / 2.f + terms.flCentreV;
+	}
+	return flMaxResidual2;
+}
+
+static float SolveBatchScalar( const CInverseDistortion::Job_t &job, const float *pflU, const float *pflV, uint32_t unCount,
+	float *pflOutU, float *pflOutV )
+{
+	return sqrtf( SolveRange( job, pflU, pflV, 0, unCount, pflOutU, pflOutV ) );
+}
+
+#if defined( INVERSE_X86 )
+// --------------------------------------------------------------------------
+// AVX2 kernel, eight queries at a time; the seed corners come from gathers
+// --------------------------------------------------------------------------
+__attribute__(( target( "avx2" ) ))
+static float SolveBatchAvx2( const CInverseDistortion::Job_t &job, const float *pflU, const float *pflV, uint32_t unCount,
+	float *pflOutU, float *pflOutV )
+{
+	const CLensModel::EyeTerms_t &terms = *job.pTerms;
+	const float *k = job.pflRadial;
+	const __m256 centreU = _mm256_set1_ps( terms.flCentreU );
+	const __m256 centreV = _mm256_set1_ps( terms.flCentreV );
+	const __m256 textureScaleU = _mm256_set1_ps( terms.flTextureScaleU );
+	const __m256 textureScaleV = _mm256_set1_ps( terms.flTextureScaleV );
+	const __m256 lensScaleU = _mm256_set1_ps( terms.flLensScaleU );
+	const __m256 one = _mm256_set1_ps( 1.f );
+	const __m256 two = _mm256_set1_ps( 2.f );
+	const __m256 six = _mm256_set1_ps( 6.f );
+	const __m256 half = _mm256_set1_ps( 0.5f );
+	const __m256 p1 = _mm256_set1_ps( terms.flTangentialP1 );
+	const __m256 p2 = _mm256_set1_ps( terms.flTangentialP2 );
+	const __m256 k1 = _mm256_set1_ps( k[0] );
+	const __m256 k2 = _mm256_set1_ps( k[1] );
+	const __m256 k3 = _mm256_set1_ps( k[2] );
+	const __m256 twoK2 = _mm256_set1_ps( 2.f * k[1] );
+	const __m256 threeK3 = _mm256_set1_ps( 3.f * k[2] );
+	const __m256 minDeterminant = _mm256_set1_ps( k_flMinDeterminant );
+	const __m256 absMask = _mm256_castsi256_ps( _mm256_set1_epi32( 0x7fffffff ) );
+	const __m256 seedCells = _mm256_set1_ps( (float)job.unSeedCells );
+	const __m256i lastCell = _mm256_set1_epi32( (int32_t)job.unSeedCells - 1 );
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i nodes = _mm256_set1_epi32( (int32_t)job.unSeedCells + 1 );
+
+	__m256 maxResidual2 = _mm256_setzero_ps();
+	uint32_t i = 0;
+	for ( ; i + 8 <= unCount; i += 8 )
+	{
+		__m256 u = _mm256_loadu_ps( pflU + i );
+		__m256 v = _mm256_loadu_ps( pflV + i );
+		__m256 targetX = _mm256_div_ps( _mm256_sub_ps( u, centreU ), textureScaleU );
+		__m256 targetY = _mm256_div_ps( _mm256_sub_ps( v, centreV ), textureScaleV );
+
+		// bilinear seed
+		__m256 cellX = _mm256_mul_ps( u, seedCells );
+		__m256 cellY = _mm256_mul_ps( v, seedCells );
+		__m256i nX = _mm256_min_epi32( _mm256_max_epi32( _mm256_cvttps_epi32( _mm256_floor_ps( cellX ) ), zero ), lastCell );
+		__m256i nY = _mm256_min_epi32( _mm256_max_epi32( _mm256_cvttps_epi32( _mm256_floor_ps( cellY ) ), zero ), lastCell );
+		__m256 fracX = _mm256_sub_ps( cellX, _mm256_cvtepi32_ps( nX ) );
+		__m256 fracY = _mm256_sub_ps( cellY, _mm256_cvtepi32_ps( nY ) );
+		__m256i index = _mm256_add_epi32( _mm256_mullo_epi32( nY, nodes ), nX );
+		__m256i indexBelow = _mm256_add_epi32( index, nodes );
+
+		__m256 rSeed[2];
+		const float *rpflSeed[2] = { job.pflSeedX, job.pflSeedY };
+		for ( uint32_t unAxis = 0; unAxis < 2; unAxis++ )
+		{
+			const float *s = rpflSeed[ unAxis ];
+			__m256 s00 = _mm256_i32gather_ps( s, index, 4 );
+			__m256 s10 = _mm256_i32gather_ps( s + 1, index, 4 );
+			__m256 s01 = _mm256_i32gather_ps( s, indexBelow, 4 );
+			__m256 s11 = _mm256_i32gather_ps( s + 1, indexBelow, 4 );
+			__m256 top = _mm256_add_ps( s00, _mm256_mul_ps( _mm256_sub_ps( s10, s00 ), fracX ) );
+			__m256 bottom = _mm256_add_ps( s01, _mm256_mul_ps( _mm256_sub_ps( s11, s01 ), fracX ) );
+			rSeed[ unAxis ] = _mm256_add_ps( top, _mm256_mul_ps( _mm256_sub_ps( bottom, top ), fracY ) );
+		}
+		__m256 x = rSeed[0];
+		__m256 y = rSeed[1];
+
+		// the last pass only measures the residual
+		for ( uint32_t unIteration = 0; unIteration <= job.unIterations; unIteration++ )
+		{
+			__m256 xx = _mm256_mul_ps( x, x );
+			__m256 yy = _mm256_mul_ps( y, y );
+			__m256 xy = _mm256_mul_ps( x, y );
+			__m256 r2 = _mm256_add_ps( xx, yy );
+			__m256 radial = _mm256_add_ps( one, _mm256_mul_ps( r2, _mm256_add_ps( k1, _mm256_mul_ps( r2, _mm256_add_ps( k2, _mm256_mul_ps( r2, k3 ) ) ) ) ) );
+			__m256 tangentialX = _mm256_add_ps( _mm256_mul_ps( _mm256_mul_ps( two, p1 ), xy ), _mm256_mul_ps( p2, _mm256_add_ps( r2, _mm256_mul_ps( two, xx ) ) ) );
+			__m256 tangentialY = _mm256_add_ps( _mm256_mul_ps( p1, _mm256_add_ps( r2, _mm256_mul_ps( two, yy ) ) ), _mm256_mul_ps( _mm256_mul_ps( two, p2 ), xy ) );
+			__m256 errorX = _mm256_sub_ps( _mm256_add_ps( _mm256_mul_ps( x, radial ), tangentialX ), targetX );
+			__m256 errorY = _mm256_sub_ps( _mm256_add_ps( _mm256_mul_ps( y, radial ), tangentialY ), targetY );
+			if ( unIteration == job.unIterations )
+			{
+				__m256 residualX = _mm256_mul_ps( errorX, textureScaleU );
+				__m256 residualY = _mm256_mul_ps( errorY, textureScaleV );
+				maxResidual2 = _mm256_max_ps( maxResidual2, _mm256_add_ps( _mm256_mul_ps( residualX, residualX ), _mm256_mul_ps( residualY, residualY ) ) );
+				break;
+			}
+
+			__m256 radialSlope = _mm256_add_ps( k1, _mm256_mul_ps( r2, _mm256_add_ps( twoK2, _mm256_mul_ps( r2, threeK3 ) ) ) );
+			__m256 j00 = _mm256_add_ps( _mm256_add_ps( radial, _mm256_mul_ps( _mm256_mul_ps( two, xx ), radialSlope ) ),
+				_mm256_add_ps( _mm256_mul_ps( _mm256_mul_ps( two, p1 ), y ), _mm256_mul_ps( _mm256_mul_ps( six, p2 ), x ) ) );
+			__m256 j01 = _mm256_add_ps( _mm256_mul_ps( _mm256_mul_ps( two, xy ), radialSlope ),
+				_mm256_add_ps( _mm256_mul_ps( _mm256_mul_ps( two, p1 ), x ), _mm256_mul_ps( _mm256_mul_ps( two, p2 ), y ) ) );
+			__m256 j11 = _mm256_add_ps( _mm256_add_ps( radial, _mm256_mul_ps( _mm256_mul_ps( two, yy ), radialSlope ) ),
+				_mm256_add_ps( _mm256_mul_ps( _mm256_mul_ps( six, p1 ), y ), _mm256_mul_ps( _mm256_mul_ps( two, p2 ), x ) ) );
+
+			__m256 determinant = _mm256_sub_ps( _mm256_mul_ps( j00, j11 ), _mm256_mul_ps( j01, j01 ) );
+			__m256 valid = _mm256_cmp_ps( _mm256_and_ps( determinant, absMask ), minDeterminant, _CMP_GT_OQ );
+			__m256 inverse = _mm256_and_ps( _mm256_div_ps( one, determinant ), valid );
+			x = _mm256_sub_ps( x, _mm256_mul_ps( _mm256_sub_ps( _mm256_mul_ps( j11, errorX ), _mm256_mul_ps( j01, errorY ) ), inverse ) );
+			y = _mm256_sub_ps( y, _mm256_mul_ps( _mm256_sub_ps( _mm256_mul_ps( j00, errorY ), _mm256_mul_ps( j01, errorX ) ), inverse ) );
+		}
+
+		_mm256_storeu_ps( pflOutU + i, _mm256_add_ps( _mm256_div_ps( x, lensScaleU ), centreU ) );
+		_mm256_storeu_ps( pflOutV + i, _mm256_add_ps( _mm256_mul_ps( y, half ), centreV ) );
+	}
+
+	float rflMax[8];
+	_mm256_storeu_ps( rflMax, maxResidual2 );
+	float flMaxResidual2 = SolveRange( job, pflU, pflV, i, unCount, pflOutU, pflOutV );
+	for ( uint32_t unLane = 0; unLane < 8; unLane++ )
+	{
+		flMaxResidual2 = std::max( flMaxResidual2, rflMax[ unLane ] );
+	}
+	return sqrtf( flMaxResidual2 );
+}
+#endif
+
+#if defined( INVERSE_NEON )
+// --------------------------------------------------------------------------
+// NEON kernel, four queries at a time. There is no gather, so the seeds are
+// interpolated per lane and only the Newton steps run in vector registers.
+// --------------------------------------------------------------------------
+static float SolveBatchNeon( const CInverseDistortion::Job_t &job, const float *pflU, const float *pflV, uint32_t unCount,
+	float *pflOutU, float *pflOutV )
+{
+	const CLensModel::EyeTerms_t &terms = *job.pTerms;
+	const float *k = job.pflRadial;
+	const float32x4_t centreU = vdupq_n_f32( terms.flCentreU );
+	const float32x4_t centreV = vdupq_n_f32( terms.flCentreV );
+	const float32x4_t textureScaleU = vdupq_n_f32( terms.flTextureScaleU );
+	const float32x4_t textureScaleV = vdupq_n_f32( terms.flTextureScaleV );
+	const float32x4_t lensScaleU = vdupq_n_f32( terms.flLensScaleU );
+	const float32x4_t one = vdupq_n_f32( 1.f );
+	const float32x4_t two = vdupq_n_f32( 2.f );
+	const float32x4_t six = vdupq_n_f32( 6.f );
+	const float32x4_t half = vdupq_n_f32( 0.5f );
+	const float32x4_t p1 = vdupq_n_f32( terms.flTangentialP1 );
+	const float32x4_t p2 = vdupq_n_f32( terms.flTangentialP2 );
+	const float32x4_t k1 = vdupq_n_f32( k[0] );
+	const float32x4_t k2 = vdupq_n_f32( k[1] );
+	const float32x4_t k3 = vdupq_n_f32( k[2] );
+	const float32x4_t twoK2 = vdupq_n_f32( 2.f * k[1] );
+	const float32x4_t threeK3 = vdupq_n_f32( 3.f * k[2] );
+	const float32x4_t minDeterminant = vdupq_n_f32( k_flMinDeterminant );
+
+	float32x4_t maxResidual2 = vdupq_n_f32( 0.f );
+	uint32_t i = 0;
+	for ( ; i + 4 <= unCount; i += 4 )
+	{
+		float rflSeedX[4], rflSeedY[4];
+		for ( uint32_t unLane = 0; unLane < 4; unLane++ )
+		{
+			SeedPoint( job, pflU[ i + unLane ], pflV[ i + unLane ], &rflSeedX[ unLane ], &rflSeedY[ unLane ] );
+		}
+
+		float32x4_t targetX = vdivq_f32( vsubq_f32( vld1q_f32( pflU + i ), centreU ), textureScaleU );
+		float32x4_t targetY = vdivq_f32( vsubq_f32( vld1q_f32( pflV + i ), centreV ), textureScaleV );
+		float32x4_t x = vld1q_f32( rflSeedX );
+		float32x4_t y = vld1q_f32( rflSeedY );
+
+		// the last pass only measures the residual
+		for ( uint32_t unIteration = 0; unIteration <= job.unIterations; unIteration++ )
+		{
+			float32x4_t xx = vmulq_f32( x, x );
+			float32x4_t yy = vmulq_f32( y, y );
+			float32x4_t xy = vmulq_f32( x, y );
+			float32x4_t r2 = vaddq_f32( xx, yy );
+			float32x4_t radial = vaddq_f32( one, vmulq_f32( r2, vaddq_f32( k1, vmulq_f32( r2, vaddq_f32( k2, vmulq_f32( r2, k3 ) ) ) ) ) );
+			float32x4_t tangentialX = vaddq_f32( vmulq_f32( vmulq_f32( two, p1 ), xy ), vmulq_f32( p2, vaddq_f32( r2, vmulq_f32( two, xx ) ) ) );
+			float32x4_t tangentialY = vaddq_f32( vmulq_f32( p1, vaddq_f32( r2, vmulq_f32( two, yy ) ) ), vmulq_f32( vmulq_f32( two, p2 ), xy ) );
+			float32x4_t errorX = vsubq_f32( vaddq_f32( vmulq_f32( x, radial ), tangentialX ), targetX );
+			float32x4_t errorY = vsubq_f32( vaddq_f32( vmulq_f32( y, radial ), tangentialY ), targetY );
+			if ( unIteration == job.unIterations )
+			{
+				float32x4_t residualX = vmulq_f32( errorX, textureScaleU );
+				float32x4_t residualY = vmulq_f32( errorY, textureScaleV );
+				maxResidual2 = vmaxq_f32( maxResidual2, vaddq_f32( vmulq_f32( residualX, residualX ), vmulq_f32( residualY, residualY ) ) );
+				break;
+			}
+
+			float32x4_t radialSlope = vaddq_f32( k1, vmulq_f32( r2, vaddq_f32( twoK2, vmulq_f32( r2, threeK3 ) ) ) );
+			float32x4_t j00 = vaddq_f32( vaddq_f32( radial, vmulq_f32( vmulq_f32( two, xx ), radialSlope ) ),
+				vaddq_f32( vmulq_f32( vmulq_f32( two, p1 ), y ), vmulq_f32( vmulq_f32( six, p2 ), x ) ) );
+			float32x4_t j01 = vaddq_f32( vmulq_f32( vmulq_f32( two, xy ), radialSlope ),
+				vaddq_f32( vmulq_f32( vmulq_f32( two, p1 ), x ), vmulq_f32( vmulq_f32( two, p2 ), y ) ) );
+			float32x4_t j11 = vaddq_f32( vaddq_f32( radial, vmulq_f32( vmulq_f32( two, yy ), radialSlope ) ),
+				vaddq_f32( vmulq_f32( vmulq_f32( six, p1 ), y ), vmulq_f32( vmulq_f32( two, p2 ), x ) ) );
+
+			float32x4_t determinant = vsubq_f32( vmulq_f32( j00, j11 ), vmulq_f32( j01, j01 ) );
+			uint32x4_t valid = vcgtq_f32( vabsq_f32( determinant ), minDeterminant );
+			float32x4_t inverse = vreinterpretq_f32_u32( vandq_u32( vreinterpretq_u32_f32( vdivq_f32( one, determinant ) ), valid ) );
+			x = vsubq_f32( x, vmulq_f32( vsubq_f32( vmulq_f32( j11, errorX ), vmulq_f32( j01, errorY ) ), inverse ) );
+			y = vsubq_f32( y, vmulq_f32( vsubq_f32( vmulq_f32( j00, errorY ), vmulq_f32( j01, errorX ) ), inverse ) );
+		}
+
+		vst1q_f32( pflOutU + i, vaddq_f32( vdivq_f32( x, lensScaleU ), centreU ) );
+		vst1q_f32( pflOutV + i, vaddq_f32( vmulq_f32( y, half ), centreV ) );
+	}
+
+	float flMaxResidual2 = std::max( SolveRange( job, pflU, pflV, i, unCount, pflOutU, pflOutV ), vmaxvq_f32( maxResidual2 ) );
+	return sqrtf( flMaxResidual2 );
+}
+#endif
+
+static PfnInverseKernel GetInverseKernel( EDistortionKernel eKernel )
+{
+	switch ( eKernel )
+	{
+#if defined( INVERSE_X86 )
+	case DistortionKernel_Avx2:
+		return SolveBatchAvx2;
+#endif
+#if defined( INVERSE_NEON )
+	case DistortionKernel_Neon:
+		return SolveBatchNeon;
+#endif
+	default:
+		return SolveBatchScalar;
+	}
+}
+
+
+CInverseDistortion::CInverseDistortion()
+{
+	memset( m_rTerms, 0, sizeof( m_rTerms ) );
+	m_unSeedCells = 0;
+	m_unIterations = k_unDefaultIterations;
+	m_flSeedError = 0.f;
+	m_flMaxResidual = 0.f;
+
+	m_eKernel = DistortionKernel_Scalar;
+	for ( uint32_t i = 0; i < DistortionKernel_Count; i++ )
+	{
+		if ( CLensModel::IsKernelSupported( (EDistortionKernel)i ) )
+			m_eKernel = (EDistortionKernel)i;
+	}
+}
+
+CInverseDistortion::Job_t CInverseDistortion::GetJob( vr::EVREye eEye, ELensChannel eChannel, uint32_t unIterations ) const
+{
+	uint32_t unEye = eEye == vr::Eye_Left ? 0 : 1;
+	Job_t job;
+	job.pTerms = &m_rTerms[ unEye ];
+	job.pflRadial = m_rTerms[ unEye ].rrflRadial[ eChannel ];
+	job.pflSeedX = m_rrvecSeedX[ unEye ][ eChannel ].data();
+	job.pflSeedY = m_rrvecSeedY[ unEye ][ eChannel ].data();
+	job.unSeedCells = m_unSeedCells;
+	job.unIterations = unIterations;
+	return job;
+}
+
+void CInverseDistortion::Build( const CLensModel &model, uint32_t unSeedCells )
+{
+	m_unSeedCells = std::max( unSeedCells, 1u );
+	m_rTerms[0] = model.GetEyeTerms( vr::Eye_Left );
+	m_rTerms[1] = model.GetEyeTerms( vr::Eye_Right );
+
+	uint32_t unNodes = m_unSeedCells + 1;
+	for ( uint32_t unEye = 0; unEye < 2; unEye++ )
+	{
+		vr::EVREye eEye = unEye == 0 ? vr::Eye_Left : vr::Eye_Right;
+		const CLensModel::EyeTerms_t &terms = m_rTerms[ unEye ];
+		for ( uint32_t unChannel = 0; unChannel < LensChannel_Count; unChannel++ )
+		{
+			std::vector<float> &vecSeedX = m_rrvecSeedX[ unEye ][ unChannel ];
+			std::vector<float> &vecSeedY = m_rrvecSeedY[ unEye ][ unChannel ];
+			vecSeedX.resize( unNodes * unNodes );
+			vecSeedY.resize( unNodes * unNodes );
+			Job_t job = GetJob( eEye, (ELensChannel)unChannel, k_unSeedIterations );
+
+			for ( uint32_t y = 0; y < unNodes; y++ )
+			{
+				for ( uint32_t x = 0; x < unNodes; x++ )
+				{
+					float flTargetX = ( (float)x / m_unSeedCells - terms.flCentreU ) / terms.flTextureScaleU;
+					float flTargetY = ( (float)y / m_unSeedCells - terms.flCentreV ) / terms.flTextureScaleV;
+
+					// start from the node to the left, which is close by; the undistorted point starts each row
+					float flX = flTargetX;
+					float flY = flTargetY;
+					if ( x > 0 && isfinite( vecSeedX[ y * unNodes + x - 1 ] ) )
+					{
+						flX = vecSeedX[ y * unNodes + x - 1 ];
+						flY = vecSeedY[ y * unNodes + x - 1 ];
+					}
+					NewtonPoint( job, flTargetX, flTargetY, k_unSeedIterations, &flX, &flY );
+					if ( !isfinite( flX ) || !isfinite( flY ) )
+					{
+						flX = flTargetX;
+						flY = flTargetY;
+					}
+					vecSeedX[ y * unNodes + x ] = flX;
+					vecSeedY[ y * unNodes + x ] = flY;
+				}
+			}
+		}
+	}
+
+	m_flSeedError = MeasureResidual( 0 );
+	m_flMaxResidual = MeasureResidual( m_unIterations );
+}
+
+float CInverseDistortion::MeasureResidual( uint32_t unIterations ) const
+{
+	// cell centres are where the bilinear seed is furthest from its nodes
+	std::vector<float> vecU( m_unSeedCells );
+	std::vector<float> vecV( m_unSeedCells );
+	std::vector<float> vecOutU( m_unSeedCells );
+	std::vector<float> vecOutV( m_unSeedCells );
+	float flMaxResidual = 0.f;
+	for ( uint32_t unEye = 0; unEye < 2; unEye++ )
+	{
+		vr::EVREye eEye = unEye == 0 ? vr::Eye_Left : vr::Eye_Right;
+		for ( uint32_t unChannel = 0; unChannel < LensChannel_Count; unChannel++ )
+		{
+			Job_t job = GetJob( eEye, (ELensChannel)unChannel, unIterations );
+			for ( uint32_t y = 0; y < m_unSeedCells; y++ )
+			{
+				for ( uint32_t x = 0; x < m_unSeedCells; x++ )
+				{
+					vecU[x] = ( x + 0.5f ) / m_unSeedCells;
+					vecV[x] = ( y + 0.5f ) / m_unSeedCells;
+				}
+				flMaxResidual = std::max( flMaxResidual, SolveBatchScalar( job, vecU.data(), vecV.data(), m_unSeedCells, vecOutU.data(), vecOutV.data() ) );
+			}
+		}
+	}
+	return flMaxResidual;
+}
+
+float CInverseDistortion::SolveBatch( vr::EVREye eEye, ELensChannel eChannel, const float *pflU, const float *pflV, uint32_t unCount,
+	float *pflOutU, float *pflOutV ) const
+{
+	if ( !IsValid() )
+		return INFINITY;
+	return GetInverseKernel( m_eKernel )( GetJob( eEye, eChannel, m_unIterations ), pflU, pflV, unCount, pflOutU, pflOutV );
+}
+
+float CInverseDistortion::Solve( vr::EVREye eEye, ELensChannel eChannel, float fU, float fV, float *pfOutU, float *pfOutV ) const
+{
+	if ( !IsValid() )
+		return INFINITY;
+	return SolveBatchScalar( GetJob( eEye, eChannel, m_unIterations ), &fU, &fV, 1, pfOutU, pfOutV );
+}
+
+void CInverseDistortion::FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const
+{
+	snprintf( pchBuffer, unBufferSize, "seed_cells=%u iterations=%u kernel=%s seed_error=%g max_residual=%g\n",
+		m_unSeedCells, m_unIterations, CLensModel::GetKernelName( m_eKernel ), m_flSeedError, m_flMaxResidual );
+}
+
+void CInverseDistortion::RunBenchmark( uint32_t unSamples, char *pchBuffer, uint32_t unBufferSize ) const
+{
+	if ( !IsValid() )
+	{
+		snprintf( pchBuffer, unBufferSize, "inverse distortion not built\n" );
+		return;
+	}
+
+	// golden ratio steps over the whole texture
+	std::vector<float> vecU( k_unBenchmarkBlock );
+	std::vector<float> vecV( k_unBenchmarkBlock );
+	std::vector<float> vecOutU( k_unBenchmarkBlock );
+	std::vector<float> vecOutV( k_unBenchmarkBlock );
+	for ( uint32_t i = 0; i < k_unBenchmarkBlock; i++ )
+	{
+		vecU[i] = fmodf( i * 0.6180339887f, 1.f );
+		vecV[i] = fmodf( i * 0.7548776662f, 1.f );
+	}
+
+	uint32_t unBlocks = std::max( ( unSamples + k_unBenchmarkBlock - 1 ) / k_unBenchmarkBlock, 1u );
+	uint32_t unUsed = snprintf( pchBuffer, unBufferSize, "samples=%u block=%u iterations=%u\n", unBlocks * k_unBenchmarkBlock, k_unBenchmarkBlock, m_unIterations );
+	for ( uint32_t unKernel = 0; unKernel < DistortionKernel_Count && unUsed < unBufferSize; unKernel++ )
+	{
+		EDistortionKernel eKernel = (EDistortionKernel)unKernel;
+		if ( !CLensModel::IsKernelSupported( eKernel ) )
+			continue;
+
+		// every eye and channel in turn
+		PfnInverseKernel pfnKernel = GetInverseKernel( eKernel );
+		float flMaxResidual = 0.f;
+		uint64_t ulStartNs = GetMonotonicNs();
+		for ( uint32_t unBlock = 0; unBlock < unBlocks; unBlock++ )
+		{
+			vr::EVREye eEye = ( unBlock & 1 ) ? vr::Eye_Right : vr::Eye_Left;
+			ELensChannel eChannel = (ELensChannel)( ( unBlock >> 1 ) % LensChannel_Count );
+			float flResidual = pfnKernel( GetJob( eEye, eChannel, m_unIterations ), vecU.data(), vecV.data(), k_unBenchmarkBlock, vecOutU.data(), vecOutV.data() );
+			flMaxResidual = std::max( flMaxResidual, flResidual );
+		}
+		double flSeconds = ( GetMonotonicNs() - ulStartNs ) / 1e9;
+
+		double flSamples = (double)unBlocks * k_unBenchmarkBlock;
+		int nWritten = snprintf( pchBuffer + unUsed, unBufferSize - unUsed, "kernel=%s ns_per_sample=%.2f msamples_per_s=%.1f max_residual=%g\n",
+			CLensModel::GetKernelName( eKernel ), flSeconds * 1e9 / flSamples, flSamples / flSeconds / 1e6, flMaxResidual );
+		if ( nWritten > 0 )
+			unUsed += (uint32_t)nWritten;
+	}
+}
@@ -0,0 +1,116 @@
+#include <latencyestimator.h>
+
+#include <stdio.h>
+#include <algorithm>
+
+CLatencyEstimator::CLatencyEstimator()
+{
+	for ( uint32_t i = 0; i < k_unBuckets; i++ )
+	{
+		m_runBuckets[i] = 0;
+	}
+	for ( uint32_t i = 0; i < k_unWindow; i++ )
+	{
+		m_rnWindowNs[i] = 0;
+	}
+	m_ulFrames = 0;
+	m_nWindowSumNs = 0;
+	m_nMaxNs = 0;
+}
+
+uint32_t CLatencyEstimator::BucketFor( int64_t nLatencyNs )
+{
+	return (uint32_t)std::min<int64_t>( std::max<int64_t>( nLatencyNs, 0 ) / k_unBucketNs, k_unBuckets - 1 );
+}
+
+void CLatencyEstimator::AddFrame( uint64_t nFrameId, uint64_t ulPoseSampleNs, uint64_t ulRequestedVsyncNs, uint64_t ulScanoutVsyncNs, uint64_t ulPhotonDelayNs )
+{
+	FrameLatency_t latency;
+	latency.nFrameId = nFrameId;
+	latency.ulPoseSampleNs = ulPoseSampleNs;
+	latency.nActualNs = (int64_t)( ulScanoutVsyncNs + ulPhotonDelayNs ) - (int64_t)ulPoseSampleNs;
+	latency.nPredictedNs = ulRequestedVsyncNs ? (int64_t)( ulRequestedVsyncNs + ulPhotonDelayNs ) - (int64_t)ulPoseSampleNs : latency.nActualNs;
+
+	uint64_t ulIndex = m_ulFrames.load( std::memory_order_relaxed );
+	m_recentFrames[ ulIndex % k_unRecentFrames ].Store( latency );
+
+	// age out the sample that falls off the end of the window
+	uint32_t unSlot = (uint32_t)( ulIndex % k_unWindow );
+	if ( ulIndex >= k_unWindow )
+	{
+		m_runBuckets[ BucketFor( m_rnWindowNs[ unSlot ] ) ].fetch_sub( 1, std::memory_order_relaxed );
+		m_nWindowSumNs.fetch_sub( m_rnWindowNs[ unSlot ], std::memory_order_relaxed );
+	}
+	m_rnWindowNs[ unSlot ] = latency.nActualNs;
+	m_runBuckets[ BucketFor( latency.nActualNs ) ].fetch_add( 1, std::memory_order_relaxed );
+	m_nWindowSumNs.fetch_add( latency.nActualNs, std::memory_order_relaxed );
+	if ( latency.nActualNs > m_nMaxNs.load( std::memory_order_relaxed ) )
+		m_nMaxNs.store( latency.nActualNs, std::memory_order_relaxed );
+
+	m_ulFrames.store( ulIndex + 1, std::memory_order_release );
+}
+
+uint32_t CLatencyEstimator::GetRecentFrames( FrameLatency_t *pFrames, uint32_t unMaxFrames ) const
+{
+	uint64_t ulFrames = m_ulFrames.load( std::memory_order_acquire );
+	uint32_t unCount = (uint32_t)std::min<uint64_t>( std::min<uint64_t>( ulFrames, k_unRecentFrames - 1 ), unMaxFrames );
+	for ( uint32_t i = 0; i < unCount; i++ )
+	{
+		pFrames[i] = m_recentFrames[ ( ulFrames - 1 - i ) % k_unRecentFrames ].Load();
+	}
+	return unCount;
+}
+
+double CLatencyEstimator::GetPercentileNs( double flFraction ) const
+{
+	uint32_t runCounts[ k_unBuckets ];
+	uint64_t ulTotal = 0;
+	for ( uint32_t i = 0; i < k_unBuckets; i++ )
+	{
+		runCounts[i] = m_runBuckets[i].load( std::memory_order_relaxed );
+		ulTotal += runCounts[i];
+	}
+	if ( ulTotal == 0 )
+		return 0.0;
+
+	uint64_t ulRank = (uint64_t)( flFraction * (double)( ulTotal - 1 ) ) + 1;
+	uint64_t ulSeen = 0;
+	for ( uint32_t i = 0; i < k_unBuckets; i++ )
+	{
+		ulSeen += runCounts[i];
+		// bucket centres can overshoot the largest sample actually seen
+		if ( ulSeen >= ulRank )
+			return std::min( ( (double)i + 0.5 ) * k_unBucketNs, (double)m_nMaxNs.load( std::memory_order_relaxed ) );
+	}
+	return (double)k_unBuckets * k_unBucketNs;
+}
+
+void CLatencyEstimator::FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const
+{
+	if ( unBufferSize == 0 )
+		return;
+
+	uint64_t ulFrames = m_ulFrames.load( std::memory_order_acquire );
+	uint64_t ulWindow = std::min<uint64_t>( ulFrames, k_unWindow );
+	double flMeanMs = ulWindow ? (double)m_nWindowSumNs.load( std::memory_order_relaxed ) / (double)ulWindow * 1e-6 : 0.0;
+
+	int nUsed = snprintf( pchBuffer, unBufferSize,
+		"frames=%llu window=%llu\n"
+		"mtp_ms mean=%.2f p50=%.2f p90=%.2f p99=%.2f lifetime_max=%.2f\n",
+		(unsigned long long)ulFrames, (unsigned long long)ulWindow,
+		flMeanMs, GetPercentileNs( 0.5 ) * 1e-6, GetPercentileNs( 0.9 ) * 1e-6, GetPercentileNs( 0.99 ) * 1e-6,
+		m_nMaxNs.load( std::memory_order_relaxed ) * 1e-6 );
+	if ( nUsed < 0 || (uint32_t)nUsed >= unBufferSize )
+		return;
+
+	FrameLatency_t rFrames[8];
+	uint32_t unCount = GetRecentFrames( rFrames, 8 );
+	for ( uint32_t i = 0; i < unCount; i++ )
+	{
+		int nWritten = snprintf( pchBuffer + nUsed, unBufferSize - nUsed, "frame %llu predicted_ms=%.2f actual_ms=%.2f\n",
+			(unsigned long long)rFrames[i].nFrameId, rFrames[i].nPredictedNs * 1e-6, rFrames[i].nActualNs * 1e-6 );
+		if ( nWritten < 0 || (uint32_t)nWritten >= unBufferSize - nUsed )
+			break;
+		nUsed += nWritten;
+	}
+}
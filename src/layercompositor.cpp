@@ -0,0 +1,506 @@
+#include <layercompositor.h>
+#include <vsynctimeline.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#define COMPOSITOR_X86
+#include <immintrin.h>
+#endif
+
+static const uint32_t k_unTileRows = 32;
+static const uint32_t k_unMaxThreads = 8;
+static const uint32_t k_unOpaqueBlack = 0xff000000u;
+
+// a worker that wakes after its job finished must not pick up tiles of a job still being prepared
+static const uint32_t k_unNoTiles = 0x80000000u;
+
+// a row of unCount output pixels; pColumns maps each to a source pixel, or is null for a contiguous run
+typedef void ( *PfnRowKernel )( uint32_t *pDst, const uint32_t *pSrc, const int32_t *pColumns, uint32_t unCount );
+
+// --------------------------------------------------------------------------
+// Scalar kernels. Blending rounds x / 255 exactly the same way as the
+// vector kernels, so every kernel produces identical output.
+// --------------------------------------------------------------------------
+static inline uint32_t BlendPixel( uint32_t unSrc, uint32_t unDst )
+{
+	uint32_t unAlpha = unSrc >> 24;
+	uint32_t unInvAlpha = 255 - unAlpha;
+	uint32_t unResult = 0;
+	for ( uint32_t unShift = 0; unShift < 32; unShift += 8 )
+	{
+		uint32_t t = ( ( unSrc >> unShift ) & 0xff ) * unAlpha + ( ( unDst >> unShift ) & 0xff ) * unInvAlpha + 128;
+		unResult |= ( ( t + ( t >> 8 ) ) >> 8 ) << unShift;
+	}
+	return unResult;
+}
+
+static void CopyRowScalar( uint32_t *pDst, const uint32_t *pSrc, const int32_t *pColumns, uint32_t unCount )
+{
+	if ( !pColumns )
+	{
+		memcpy( pDst, pSrc, unCount * sizeof( uint32_t ) );
+		return;
+	}
+	for ( uint32_t i = 0; i < unCount; i++ )
+	{
+		pDst[i] = pSrc[ pColumns[i] ];
+	}
+}
+
+static void BlendRowScalar( uint32_t *pDst, const uint32_t *pSrc, const int32_t *pColumns, uint32_t unCount )
+{
+	for ( uint32_t i = 0; i < unCount; i++ )
+	{
+		pDst[i] = BlendPixel( pColumns ? pSrc[ pColumns[i] ] : pSrc[i], pDst[i] );
+	}
+}
+
+#if defined( COMPOSITOR_X86 )
+// --------------------------------------------------------------------------
+// SSE2 kernels, four pixels at a time. The blend only needs 16 bit multiplies,
+// so SSE2 is enough and this tier runs on every x86-64 CPU.
+// --------------------------------------------------------------------------
+static inline __m128i BlendHalfSse2( __m128i src, __m128i dst )
+{
+	const __m128i k255 = _mm_set1_epi16( 255 );
+	const __m128i k128 = _mm_set1_epi16( 128 );
+	__m128i alpha = _mm_shufflehi_epi16( _mm_shufflelo_epi16( src, 0xff ), 0xff );
+	__m128i t = _mm_add_epi16( _mm_add_epi16( _mm_mullo_epi16( src, alpha ), _mm_mullo_epi16( dst, _mm_sub_epi16( k255, alpha ) ) ), k128 );
+	return _mm_srli_epi16( _mm_add_epi16( t, _mm_srli_epi16( t, 8 ) ), 8 );
+}
+
+static inline __m128i BlendSse2( __m128i src, __m128i dst )
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i lo = BlendHalfSse2( _mm_unpacklo_epi8( src, zero ), _mm_unpacklo_epi8( dst, zero ) );
+	__m128i hi = BlendHalfSse2( _mm_unpackhi_epi8( src, zero ), _mm_unpackhi_epi8( dst, zero ) );
+	return _mm_packus_epi16( lo, hi );
+}
+
+static void BlendRowSse2( uint32_t *pDst, const uint32_t *pSrc, const int32_t *pColumns, uint32_t unCount )
+{
+	uint32_t i = 0;
+	for ( ; i + 4 <= unCount; i += 4 )
+	{
+		__m128i src = pColumns
+			? _mm_set_epi32( pSrc[ pColumns[i + 3] ], pSrc[ pColumns[i + 2] ], pSrc[ pColumns[i + 1] ], pSrc[ pColumns[i] ] )
+			: _mm_loadu_si128( (const __m128i *)( pSrc + i ) );
+		__m128i dst = _mm_loadu_si128( (const __m128i *)( pDst + i ) );
+		_mm_storeu_si128( (__m128i *)( pDst + i ), BlendSse2( src, dst ) );
+	}
+	for ( ; i < unCount; i++ )
+	{
+		pDst[i] = BlendPixel( pColumns ? pSrc[ pColumns[i] ] : pSrc[i], pDst[i] );
+	}
+}
+
+// --------------------------------------------------------------------------
+// AVX2 kernels, eight pixels at a time, with hardware gathers for scaled layers
+// --------------------------------------------------------------------------
+__attribute__(( target( "avx2" ) ))
+static inline __m256i BlendHalfAvx2( __m256i src, __m256i dst )
+{
+	const __m256i k255 = _mm256_set1_epi16( 255 );
+	const __m256i k128 = _mm256_set1_epi16( 128 );
+	__m256i alpha = _mm256_shufflehi_epi16( _mm256_shufflelo_epi16( src, 0xff ), 0xff );
+	__m256i t = _mm256_add_epi16( _mm256_add_epi16( _mm256_mullo_epi16( src, alpha ), _mm256_mullo_epi16( dst, _mm256_sub_epi16( k255, alpha ) ) ), k128 );
+	return _mm256_srli_epi16( _mm256_add_epi16( t, _mm256_srli_epi16( t, 8 ) ), 8 );
+}
+
+__attribute__(( target( "avx2" ) ))
+static void CopyRowAvx2( uint32_t *pDst, const uint32_t *pSrc, const int32_t *pColumns, uint32_t unCount )
+{
+	if ( !pColumns )
+	{
+		memcpy( pDst, pSrc, unCount * sizeof( uint32_t ) );
+		return;
+	}
+
+	uint32_t i = 0;
+	for ( ; i + 8 <= unCount; i += 8 )
+	{
+		__m256i columns = _mm256_loadu_si256( (const __m256i *)( pColumns + i ) );
+		_mm256_storeu_si256( (__m256i *)( pDst + i ), _mm256_i32gather_epi32( (const int *)pSrc, columns, 4 ) );
+	}
+	for ( ; i < unCount; i++ )
+	{
+		pDst[i] = pSrc[ pColumns[i] ];
+	}
+}
+
+__attribute__(( target( "avx2" ) ))
+static void BlendRowAvx2( uint32_t *pDst, const uint32_t *pSrc, const int32_t *pColumns, uint32_t unCount )
+{
+	const __m256i zero = _mm256_setzero_si256();
+	uint32_t i = 0;
+	for ( ; i + 8 <= unCount; i += 8 )
+	{
+		__m256i src = pColumns
+			? _mm256_i32gather_epi32( (const int *)pSrc, _mm256_loadu_si256( (const __m256i *)( pColumns + i ) ), 4 )
+			: _mm256_loadu_si256( (const __m256i *)( pSrc + i ) );
+		__m256i dst = _mm256_loadu_si256( (const __m256i *)( pDst + i ) );
+
+		// unpack and pack both work within 128 bit lanes, so pixel order is preserved
+		__m256i lo = BlendHalfAvx2( _mm256_unpacklo_epi8( src, zero ), _mm256_unpacklo_epi8( dst, zero ) );
+		__m256i hi = BlendHalfAvx2( _mm256_unpackhi_epi8( src, zero ), _mm256_unpackhi_epi8( dst, zero ) );
+		_mm256_storeu_si256( (__m256i *)( pDst + i ), _mm256_packus_epi16( lo, hi ) );
+	}
+	for ( ; i < unCount; i++ )
+	{
+		pDst[i] = BlendPixel( pColumns ? pSrc[ pColumns[i] ] : pSrc[i], pDst[i] );
+	}
+}
+#endif
+
+struct RowKernels_t
+{
+	PfnRowKernel pfnCopy;
+	PfnRowKernel pfnBlend;
+};
+
+static RowKernels_t GetRowKernels( ECompositorKernel eKernel )
+{
+	RowKernels_t kernels = { CopyRowScalar, BlendRowScalar };
+#if defined( COMPOSITOR_X86 )
+	if ( eKernel == CompositorKernel_Sse2 )
+	{
+		kernels.pfnBlend = BlendRowSse2;
+	}
+	else if ( eKernel == CompositorKernel_Avx2 )
+	{
+		kernels.pfnCopy = CopyRowAvx2;
+		kernels.pfnBlend = BlendRowAvx2;
+	}
+#endif
+	return kernels;
+}
+
+bool CLayerCompositor::IsKernelSupported( ECompositorKernel eKernel )
+{
+	switch ( eKernel )
+	{
+	case CompositorKernel_Scalar:
+		return true;
+#if defined( COMPOSITOR_X86 )
+	case CompositorKernel_Sse2:
+		return __builtin_cpu_supports( "sse2" );
+	case CompositorKernel_Avx2:
+		return __builtin_cpu_supports( "avx2" );
+#endif
+	default:
+		return false;
+	}
+}
+
+const char *CLayerCompositor::GetKernelName( ECompositorKernel eKernel )
+{
+	switch ( eKernel )
+	{
+	case CompositorKernel_Scalar:	return "scalar";
+	case CompositorKernel_Sse2:		return "sse2";
+	case CompositorKernel_Avx2:		return "avx2";
+	default:						return "unknown";
+	}
+}
+
+
+CLayerCompositor::CLayerCompositor()
+{
+	m_eKernel = CompositorKernel_Scalar;
+	for ( uint32_t i = 0; i < CompositorKernel_Count; i++ )
+	{
+		if ( IsKernelSupported( (ECompositorKernel)i ) )
+			m_eKernel = (ECompositorKernel)i;
+	}
+
+	m_unEyeWidth = 0;
+	m_unEyeHeight = 0;
+	m_unLayerCount = 0;
+	m_ulJobGeneration = 0;
+	m_bStopping = false;
+	m_unTileCount = 0;
+	m_unNextTile = k_unNoTiles;
+	m_unTilesDone = 0;
+}
+
+CLayerCompositor::~CLayerCompositor()
+{
+	Stop();
+}
+
+void CLayerCompositor::Start( uint32_t unThreads )
+{
+	Stop();
+
+	if ( unThreads == 0 )
+		unThreads = std::thread::hardware_concurrency();
+	if ( unThreads == 0 )
+		unThreads = 1;
+	if ( unThreads > k_unMaxThreads )
+		unThreads = k_unMaxThreads;
+
+	m_bStopping = false;
+	for ( uint32_t i = 1; i < unThreads; i++ )
+	{
+		m_vecWorkers.push_back( std::thread( &CLayerCompositor::WorkerThread, this ) );
+	}
+}
+
+void CLayerCompositor::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_bStopping = true;
+	}
+	m_startCondition.notify_all();
+
+	for ( std::thread &worker : m_vecWorkers )
+	{
+		worker.join();
+	}
+	m_vecWorkers.clear();
+}
+
+void CLayerCompositor::SetEyeSize( uint32_t unEyeWidth, uint32_t unEyeHeight )
+{
+	m_unEyeWidth = unEyeWidth;
+	m_unEyeHeight = unEyeHeight;
+	m_vecOutput.assign( (size_t)unEyeWidth * 2 * unEyeHeight, k_unOpaqueBlack );
+}
+
+bool CLayerCompositor::AddLayer( const SwapTextureMemory_t ( &rEyeMemory )[2], const vr::VRTextureBounds_t ( &rEyeBounds )[2] )
+{
+	if ( m_unLayerCount >= k_unMaxLayers )
+		return false;
+
+	for ( uint32_t unEye = 0; unEye < 2; unEye++ )
+	{
+		if ( rEyeMemory[ unEye ].unBytesPerPixel != sizeof( uint32_t ) || !rEyeMemory[ unEye ].pData )
+			return false;
+	}
+
+	for ( uint32_t unEye = 0; unEye < 2; unEye++ )
+	{
+		EyeLayer_t &eyeLayer = m_rLayers[ m_unLayerCount ][ unEye ];
+		eyeLayer.memory = rEyeMemory[ unEye ];
+		eyeLayer.bounds = rEyeBounds[ unEye ];
+	}
+	m_unLayerCount++;
+	return true;
+}
+
+void CLayerCompositor::PrepareEyeLayer( EyeLayer_t &eyeLayer )
+{
+	vr::VRTextureBounds_t bounds = eyeLayer.bounds;
+	if ( bounds.uMin == bounds.uMax || bounds.vMin == bounds.vMax )
+	{
+		bounds.uMin = bounds.vMin = 0.f;
+		bounds.uMax = bounds.vMax = 1.f;
+	}
+
+	// nearest sample at each output pixel centre; swapped bounds flip the layer
+	eyeLayer.vecColumns.resize( m_unEyeWidth );
+	for ( uint32_t x = 0; x < m_unEyeWidth; x++ )
+	{
+		float u = bounds.uMin + ( x + 0.5f ) / m_unEyeWidth * ( bounds.uMax - bounds.uMin );
+		int32_t nColumn = (int32_t)floorf( u * eyeLayer.memory.unWidth );
+		eyeLayer.vecColumns[x] = std::min( std::max( nColumn, 0 ), (int32_t)eyeLayer.memory.unWidth - 1 );
+	}
+
+	eyeLayer.vecRows.resize( m_unEyeHeight );
+	for ( uint32_t y = 0; y < m_unEyeHeight; y++ )
+	{
+		float v = bounds.vMin + ( y + 0.5f ) / m_unEyeHeight * ( bounds.vMax - bounds.vMin );
+		int32_t nRow = (int32_t)floorf( v * eyeLayer.memory.unHeight );
+		eyeLayer.vecRows[y] = std::min( std::max( nRow, 0 ), (int32_t)eyeLayer.memory.unHeight - 1 );
+	}
+
+	eyeLayer.bContiguous = true;
+	for ( uint32_t x = 1; x < m_unEyeWidth && eyeLayer.bContiguous; x++ )
+	{
+		eyeLayer.bContiguous = eyeLayer.vecColumns[x] == eyeLayer.vecColumns[0] + (int32_t)x;
+	}
+}
+
+void CLayerCompositor::CompositeTile( uint32_t unTile )
+{
+	RowKernels_t kernels = GetRowKernels( m_eKernel );
+	uint32_t unTilesPerEye = ( m_unEyeHeight + k_unTileRows - 1 ) / k_unTileRows;
+	uint32_t unEye = unTile / unTilesPerEye;
+	uint32_t unFirstRow = ( unTile % unTilesPerEye ) * k_unTileRows;
+	uint32_t unLastRow = std::min( unFirstRow + k_unTileRows, m_unEyeHeight );
+
+	for ( uint32_t y = unFirstRow; y < unLastRow; y++ )
+	{
+		uint32_t *pDst = &m_vecOutput[ (size_t)y * m_unEyeWidth * 2 + unEye * m_unEyeWidth ];
+		if ( m_unLayerCount == 0 )
+		{
+			std::fill( pDst, pDst + m_unEyeWidth, k_unOpaqueBlack );
+			continue;
+		}
+
+		for ( uint32_t unLayer = 0; unLayer < m_unLayerCount; unLayer++ )
+		{
+			const EyeLayer_t &eyeLayer = m_rLayers[ unLayer ][ unEye ];
+			const uint32_t *pSrc = (const uint32_t *)( (const uint8_t *)eyeLayer.memory.pData + (size_t)eyeLayer.vecRows[y] * eyeLayer.memory.unRowPitch );
+			const int32_t *pColumns = eyeLayer.vecColumns.data();
+			if ( eyeLayer.bContiguous )
+			{
+				pSrc += pColumns[0];
+				pColumns = nullptr;
+			}
+
+			if ( unLayer == 0 )
+				kernels.pfnCopy( pDst, pSrc, pColumns, m_unEyeWidth );
+			else
+				kernels.pfnBlend( pDst, pSrc, pColumns, m_unEyeWidth );
+		}
+	}
+}
+
+void CLayerCompositor::RunTiles()
+{
+	for ( ;; )
+	{
+		uint32_t unTile = m_unNextTile.fetch_add( 1 );
+		if ( unTile >= m_unTileCount )
+			break;
+
+		CompositeTile( unTile );
+		if ( m_unTilesDone.fetch_add( 1 ) + 1 == m_unTileCount )
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			m_doneCondition.notify_all();
+		}
+	}
+}
+
+void CLayerCompositor::WorkerThread()
+{
+	uint64_t ulGeneration = 0;
+	for ( ;; )
+	{
+		{
+			std::unique_lock<std::mutex> lock( m_mutex );
+			m_startCondition.wait( lock, [&] { return m_bStopping || m_ulJobGeneration != ulGeneration; } );
+			if ( m_bStopping )
+				return;
+			ulGeneration = m_ulJobGeneration;
+		}
+		RunTiles();
+	}
+}
+
+void CLayerCompositor::Composite()
+{
+	if ( m_vecOutput.empty() )
+	{
+		m_unLayerCount = 0;
+		return;
+	}
+
+	for ( uint32_t unLayer = 0; unLayer < m_unLayerCount; unLayer++ )
+	{
+		PrepareEyeLayer( m_rLayers[ unLayer ][0] );
+		PrepareEyeLayer( m_rLayers[ unLayer ][1] );
+	}
+
+	m_unTileCount = 2 * ( ( m_unEyeHeight + k_unTileRows - 1 ) / k_unTileRows );
+	m_unTilesDone = 0;
+	m_unNextTile = 0;
+	if ( !m_vecWorkers.empty() )
+	{
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			m_ulJobGeneration++;
+		}
+		m_startCondition.notify_all();
+	}
+
+	RunTiles();
+
+	{
+		std::unique_lock<std::mutex> lock( m_mutex );
+		m_doneCondition.wait( lock, [&] { return m_unTilesDone.load() == m_unTileCount; } );
+	}
+	m_unNextTile = k_unNoTiles;
+	m_unLayerCount = 0;
+}
+
+void CLayerCompositor::RunBenchmark( uint32_t unThreads, uint32_t unEyeWidth, uint32_t unEyeHeight, uint32_t unFrames, char *pchBuffer, uint32_t unBufferSize )
+{
+	if ( unBufferSize == 0 )
+		return;
+	pchBuffer[0] = 0;
+	if ( unEyeWidth == 0 || unEyeHeight == 0 || unFrames == 0 )
+		return;
+
+	// an opaque base layer and a half transparent overlay, both shared by the two eyes
+	std::vector<uint32_t> vecBase( (size_t)unEyeWidth * unEyeHeight );
+	std::vector<uint32_t> vecOverlay( vecBase.size() );
+	for ( size_t i = 0; i < vecBase.size(); i++ )
+	{
+		vecBase[i] = 0xff000000u | (uint32_t)( i * 2654435761u >> 8 );
+		vecOverlay[i] = ( (uint32_t)( i & 0xff ) << 24 ) | (uint32_t)( i * 40503u & 0xffffff );
+	}
+
+	SwapTextureMemory_t rBase[2], rOverlay[2];
+	memset( rBase, 0, sizeof( rBase ) );
+	for ( uint32_t unEye = 0; unEye < 2; unEye++ )
+	{
+		rBase[ unEye ].pData = vecBase.data();
+		rBase[ unEye ].ulSize = vecBase.size() * sizeof( uint32_t );
+		rBase[ unEye ].unWidth = unEyeWidth;
+		rBase[ unEye ].unHeight = unEyeHeight;
+		rBase[ unEye ].unBytesPerPixel = sizeof( uint32_t );
+		rBase[ unEye ].unRowPitch = unEyeWidth * sizeof( uint32_t );
+		rBase[ unEye ].nFd = -1;
+		rOverlay[ unEye ] = rBase[ unEye ];
+		rOverlay[ unEye ].pData = vecOverlay.data();
+	}
+
+	// the overlay crops the middle of its texture and scales it up, which takes the gather path
+	const vr::VRTextureBounds_t fullBounds = { 0.f, 0.f, 1.f, 1.f };
+	const vr::VRTextureBounds_t cropBounds = { 0.25f, 0.25f, 0.75f, 0.75f };
+	const vr::VRTextureBounds_t rBaseBounds[2] = { fullBounds, fullBounds };
+	const vr::VRTextureBounds_t rOverlayBounds[2] = { cropBounds, cropBounds };
+
+	CLayerCompositor compositor;
+	compositor.Start( unThreads );
+	compositor.SetEyeSize( unEyeWidth, unEyeHeight );
+
+	uint32_t unUsed = snprintf( pchBuffer, unBufferSize, "eye=%ux%u layers=2 frames=%u threads=%u\n",
+		unEyeWidth, unEyeHeight, unFrames, compositor.GetThreadCount() );
+
+	double flPixelsPerFrame = 2.0 * 2.0 * unEyeWidth * unEyeHeight;
+	for ( uint32_t i = 0; i < CompositorKernel_Count && unUsed < unBufferSize; i++ )
+	{
+		ECompositorKernel eKernel = (ECompositorKernel)i;
+		if ( !IsKernelSupported( eKernel ) )
+			continue;
+
+		compositor.SetKernel( eKernel );
+
+		// one untimed frame to fault in the output and the tables
+		uint64_t ulStartNs = 0;
+		for ( uint32_t unFrame = 0; unFrame <= unFrames; unFrame++ )
+		{
+			if ( unFrame == 1 )
+				ulStartNs = GetMonotonicNs();
+			compositor.AddLayer( rBase, rBaseBounds );
+			compositor.AddLayer( rOverlay, rOverlayBounds );
+			compositor.Composite();
+		}
+		double flSeconds = ( GetMonotonicNs() - ulStartNs ) / 1e9;
+
+		int nWritten = snprintf( pchBuffer + unUsed, unBufferSize - unUsed, "kernel=%s frame_ms=%.2f mpix_per_s=%.0f\n",
+			GetKernelName( eKernel ), flSeconds * 1e3 / unFrames, flPixelsPerFrame * unFrames / flSeconds / 1e6 );
+		if ( nWritten > 0 )
+			unUsed += (uint32_t)nWritten;
+	}
+}
@@ -0,0 +1,501 @@
+#include <motiongenerator.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+static const char * const k_rpchMotionModeNames[ Motion_Count ] =
+{
+	"still",
+	"sweep",
+	"spline",
+	"walk",
+	"script",
+};
+
+// per profile: how far each channel moves relative to the configured amplitude, and how fast
+static const double k_rrflChannelWeight[2][ CMotionGenerator::Channel_Count ] =
+{
+	{ 1.0, 0.4, 0.6, 1.0, 0.5, 0.15 },		// head: look around, lean a little
+	{ 3.0, 2.4, 2.1, 0.8, 1.0, 0.6 },		// hand: reach, and turn the wrist every way
+};
+static const double k_rrflChannelFrequency[2][ CMotionGenerator::Channel_Count ] =
+{
+	{ 0.9, 1.3, 0.7, 1.0, 1.7, 0.6 },
+	{ 1.6, 2.1, 1.2, 1.8, 1.4, 2.4 },
+};
+static const double k_rrflProfileBase[2][3] =
+{
+	{ 0.0, 0.0, 0.0 },
+	{ 0.2, -0.3, -0.35 },	// right hand, relative to where the head rests
+};
+
+// the walk holds a random force for k_unWalkForceSteps steps against a spring and damper that keep it near the base pose
+static const double k_flWalkStepSeconds = 0.01;
+static const uint64_t k_unWalkForceSteps = 10;
+static const double k_flWalkDamping = 0.7;
+static const double k_flWalkAccelerationScale = 3.0;	// acceleration bound, relative to the peak of a sweep with the same amplitude
+static const uint64_t k_unWalkCheckpointSteps = 100;	// one second; the ring covers the last minute
+
+// SplitMix64 finalizer, as in the fault injector
+static uint64_t MixBits( uint64_t ulValue )
+{
+	ulValue += 0x9e3779b97f4a7c15ull;
+	ulValue = ( ulValue ^ ( ulValue >> 30 ) ) * 0xbf58476d1ce4e5b9ull;
+	ulValue = ( ulValue ^ ( ulValue >> 27 ) ) * 0x94d049bb133111ebull;
+	return ulValue ^ ( ulValue >> 31 );
+}
+
+static void Cross( const double *pflA, const double *pflB, double *pflOut )
+{
+	pflOut[0] = pflA[1] * pflB[2] - pflA[2] * pflB[1];
+	pflOut[1] = pflA[2] * pflB[0] - pflA[0] * pflB[2];
+	pflOut[2] = pflA[0] * pflB[1] - pflA[1] * pflB[0];
+}
+
+CMotionGenerator::CMotionGenerator()
+{
+	m_config.eMode = Motion_Still;
+	m_config.eProfile = MotionProfile_Head;
+	m_config.ulSeed = 0;
+	m_config.flPositionAmplitude = 0.f;
+	m_config.flRotationAmplitude = 0.f;
+	m_config.flFrequency = 0.f;
+	m_config.bScriptLoop = false;
+	for ( uint32_t i = 0; i < Channel_Count; i++ )
+	{
+		m_rflAmplitude[i] = 0.0;
+		m_rflFrequency[i] = 0.0;
+		m_rflPhase[i] = 0.0;
+	}
+	for ( uint32_t i = 0; i < 3; i++ )
+	{
+		m_rflBase[i] = 0.0;
+	}
+	ResetWalk();
+}
+
+bool CMotionGenerator::Configure( const MotionConfig_t &config, std::string *psError )
+{
+	std::vector<Keyframe_t> vecKeyframes;
+	const char *pch = config.sScript.c_str();
+	while ( *pch )
+	{
+		while ( *pch == ' ' || *pch == ';' )
+			pch++;
+		if ( !*pch )
+			break;
+
+		const char *pchKeyframe = pch;
+		char *pchEnd;
+		Keyframe_t keyframe;
+		keyframe.flSeconds = strtod( pch, &pchEnd );
+		if ( pchEnd == pch || *pchEnd != ':' || !( keyframe.flSeconds >= 0.0 ) )
+		{
+			if ( psError )
+				*psError = std::string( "expected <seconds>: at '" ) + pchKeyframe + "'";
+			return false;
+		}
+		pch = pchEnd + 1;
+
+		for ( uint32_t unChannel = 0; unChannel < Channel_Count; unChannel++ )
+		{
+			bool bSeparated = !unChannel || *pch == ',';
+			if ( unChannel && bSeparated )
+				pch++;
+			keyframe.rflValues[ unChannel ] = strtod( pch, &pchEnd );
+			if ( !bSeparated || pchEnd == pch )
+			{
+				if ( psError )
+					*psError = std::string( "expected x,y,z,yaw,pitch,roll at '" ) + pchKeyframe + "'";
+				return false;
+			}
+			if ( unChannel >= Channel_Yaw )
+				keyframe.rflValues[ unChannel ] *= M_PI / 180.0;
+			keyframe.rflTangents[ unChannel ] = 0.0;
+			pch = pchEnd;
+		}
+		if ( *pch && *pch != ';' && *pch != ' ' )
+		{
+			if ( psError )
+				*psError = std::string( "expected ';' at '" ) + pch + "'";
+			return false;
+		}
+		vecKeyframes.push_back( keyframe );
+	}
+	std::sort( vecKeyframes.begin(), vecKeyframes.end() );
+	for ( size_t i = 1; i < vecKeyframes.size(); i++ )
+	{
+		if ( vecKeyframes[i].flSeconds == vecKeyframes[i - 1].flSeconds )
+		{
+			if ( psError )
+			{
+				char rchError[64];
+				snprintf( rchError, sizeof( rchError ), "two keyframes at %gs", vecKeyframes[i].flSeconds );
+				*psError = rchError;
+			}
+			return false;
+		}
+	}
+	if ( config.eMode == Motion_Script && vecKeyframes.empty() )
+	{
+		if ( psError )
+			*psError = "script mode without keyframes";
+		return false;
+	}
+
+	// Catmull-Rom tangents; the ends of a looping script take theirs across the wrap, assuming it ends where it started
+	size_t unKeyframes = vecKeyframes.size();
+	for ( size_t i = 0; i < unKeyframes; i++ )
+	{
+		size_t unPrev = i - 1, unNext = i + 1;
+		double flSpan;
+		if ( i > 0 && i + 1 < unKeyframes )
+		{
+			flSpan = vecKeyframes[ unNext ].flSeconds - vecKeyframes[ unPrev ].flSeconds;
+		}
+		else if ( config.bScriptLoop && unKeyframes >= 3 )
+		{
+			unPrev = unKeyframes - 2;
+			unNext = 1;
+			flSpan = ( vecKeyframes[1].flSeconds - vecKeyframes[0].flSeconds ) + ( vecKeyframes[ unKeyframes - 1 ].flSeconds - vecKeyframes[ unKeyframes - 2 ].flSeconds );
+		}
+		else
+		{
+			continue;
+		}
+		for ( uint32_t unChannel = 0; unChannel < Channel_Count; unChannel++ )
+		{
+			vecKeyframes[i].rflTangents[ unChannel ] = ( vecKeyframes[ unNext ].rflValues[ unChannel ] - vecKeyframes[ unPrev ].rflValues[ unChannel ] ) / flSpan;
+		}
+	}
+
+	m_config = config;
+	m_config.flPositionAmplitude = std::max( config.flPositionAmplitude, 0.f );
+	m_config.flRotationAmplitude = std::max( config.flRotationAmplitude, 0.f );
+	m_config.flFrequency = std::max( config.flFrequency, 0.001f );
+	m_vecKeyframes.swap( vecKeyframes );
+
+	uint32_t unProfile = config.eProfile == MotionProfile_Hand ? 1 : 0;
+	for ( uint32_t unChannel = 0; unChannel < Channel_Count; unChannel++ )
+	{
+		double flAmplitude = unChannel < Channel_Yaw ? m_config.flPositionAmplitude : m_config.flRotationAmplitude * M_PI / 180.0;
+		m_rflAmplitude[ unChannel ] = flAmplitude * k_rrflChannelWeight[ unProfile ][ unChannel ];
+		m_rflFrequency[ unChannel ] = m_config.flFrequency * k_rrflChannelFrequency[ unProfile ][ unChannel ];
+		m_rflPhase[ unChannel ] = M_PI * GetRandom( unChannel, ~0ull );
+	}
+	for ( uint32_t i = 0; i < 3; i++ )
+	{
+		m_rflBase[i] = k_rrflProfileBase[ unProfile ][i];
+	}
+	ResetWalk();
+	return true;
+}
+
+const char *CMotionGenerator::GetModeName( EMotionMode eMode )
+{
+	return eMode < Motion_Count ? k_rpchMotionModeNames[ eMode ] : "unknown";
+}
+
+EMotionMode CMotionGenerator::FindMode( const char *pchName )
+{
+	for ( uint32_t i = 0; i < Motion_Count; i++ )
+	{
+		if ( !strcmp( pchName, k_rpchMotionModeNames[i] ) )
+			return (EMotionMode)i;
+	}
+	return Motion_Count;
+}
+
+double CMotionGenerator::GetRandom( uint32_t unChannel, uint64_t ulIndex ) const
+{
+	uint64_t ulBits = MixBits( MixBits( m_config.ulSeed ) ^ ( ulIndex * Channel_Count + unChannel ) );
+	return (double)( ulBits >> 11 ) * ( 2.0 / 9007199254740992.0 ) - 1.0;
+}
+
+CMotionGenerator::ChannelState_t CMotionGenerator::SampleSweep( uint32_t unChannel, double flSeconds ) const
+{
+	double flOmega = 2.0 * M_PI * m_rflFrequency[ unChannel ];
+	double flAngle = flOmega * flSeconds + m_rflPhase[ unChannel ];
+	double flAmplitude = m_rflAmplitude[ unChannel ];
+
+	ChannelState_t state;
+	state.flValue = flAmplitude * sin( flAngle );
+	state.flRate = flAmplitude * flOmega * cos( flAngle );
+	state.flAcceleration = -flOmega * flOmega * state.flValue;
+	return state;
+}
+
+CMotionGenerator::ChannelState_t CMotionGenerator::SampleSpline( uint32_t unChannel, double flSeconds ) const
+{
+	// uniform cubic B-spline, so acceleration stays continuous across knots; knots every half period
+	double flKnotSeconds = 0.5 / m_rflFrequency[ unChannel ];
+	double flKnot = flSeconds / flKnotSeconds;
+	uint64_t ulKnot = (uint64_t)flKnot;
+	double u = flKnot - (double)ulKnot;
+	double u2 = u * u, u3 = u2 * u;
+
+	double rflBasis[4] = { ( 1.0 - u ) * ( 1.0 - u ) * ( 1.0 - u ) / 6.0, ( 3.0 * u3 - 6.0 * u2 + 4.0 ) / 6.0, ( -3.0 * u3 + 3.0 * u2 + 3.0 * u + 1.0 ) / 6.0, u3 / 6.0 };
+	double rflSlope[4] = { -( 1.0 - u ) * ( 1.0 - u ) / 2.0, ( 3.0 * u2 - 4.0 * u ) / 2.0, ( -3.0 * u2 + 2.0 * u + 1.0 ) / 2.0, u2 / 2.0 };
+	double rflCurvature[4] = { 1.0 - u, 3.0 * u - 2.0, -3.0 * u + 1.0, u };
+
+	ChannelState_t state = { 0.0, 0.0, 0.0 };
+	for ( uint32_t i = 0; i < 4; i++ )
+	{
+		double flPoint = m_rflAmplitude[ unChannel ] * GetRandom( unChannel, ulKnot + i );
+		state.flValue += rflBasis[i] * flPoint;
+		state.flRate += rflSlope[i] * flPoint;
+		state.flAcceleration += rflCurvature[i] * flPoint;
+	}
+	state.flRate /= flKnotSeconds;
+	state.flAcceleration /= flKnotSeconds * flKnotSeconds;
+	return state;
+}
+
+CMotionGenerator::ChannelState_t CMotionGenerator::SampleScript( uint32_t unChannel, double flSeconds ) const
+{
+	ChannelState_t state = { 0.0, 0.0, 0.0 };
+	if ( m_vecKeyframes.empty() )
+		return state;
+
+	const Keyframe_t &first = m_vecKeyframes.front();
+	const Keyframe_t &last = m_vecKeyframes.back();
+	if ( m_config.bScriptLoop && flSeconds > first.flSeconds && last.flSeconds > first.flSeconds )
+		flSeconds = first.flSeconds + fmod( flSeconds - first.flSeconds, last.flSeconds - first.flSeconds );
+
+	if ( flSeconds <= first.flSeconds )
+	{
+		state.flValue = first.rflValues[ unChannel ];
+		return state;
+	}
+	if ( flSeconds >= last.flSeconds )
+	{
+		state.flValue = last.rflValues[ unChannel ];
+		return state;
+	}
+
+	Keyframe_t key;
+	key.flSeconds = flSeconds;
+	std::vector<Keyframe_t>::const_iterator it = std::upper_bound( m_vecKeyframes.begin(), m_vecKeyframes.end(), key );
+	const Keyframe_t &to = *it;
+	const Keyframe_t &from = *( it - 1 );
+
+	// cubic Hermite between the two keyframes
+	double h = to.flSeconds - from.flSeconds;
+	double s = ( flSeconds - from.flSeconds ) / h;
+	double s2 = s * s, s3 = s2 * s;
+	double p0 = from.rflValues[ unChannel ], p1 = to.rflValues[ unChannel ];
+	double m0 = from.rflTangents[ unChannel ] * h, m1 = to.rflTangents[ unChannel ] * h;
+
+	state.flValue = ( 2.0 * s3 - 3.0 * s2 + 1.0 ) * p0 + ( s3 - 2.0 * s2 + s ) * m0 + ( -2.0 * s3 + 3.0 * s2 ) * p1 + ( s3 - s2 ) * m1;
+	state.flRate = ( ( 6.0 * s2 - 6.0 * s ) * p0 + ( 3.0 * s2 - 4.0 * s + 1.0 ) * m0 + ( -6.0 * s2 + 6.0 * s ) * p1 + ( 3.0 * s2 - 2.0 * s ) * m1 ) / h;
+	state.flAcceleration = ( ( 12.0 * s - 6.0 ) * p0 + ( 6.0 * s - 4.0 ) * m0 + ( -12.0 * s + 6.0 ) * p1 + ( 6.0 * s - 2.0 ) * m1 ) / ( h * h );
+	return state;
+}
+
+double CMotionGenerator::GetWalkAcceleration( uint32_t unChannel, uint64_t ulStep, double flValue, double flRate ) const
+{
+	double flOmega = 2.0 * M_PI * m_rflFrequency[ unChannel ];
+	double flLimit = k_flWalkAccelerationScale * m_rflAmplitude[ unChannel ] * flOmega * flOmega;
+	double flForce = flLimit * GetRandom( unChannel, ulStep / k_unWalkForceSteps );
+	double flAcceleration = flForce - flOmega * flOmega * flValue - 2.0 * k_flWalkDamping * flOmega * flRate;
+	return std::min( std::max( flAcceleration, -flLimit ), flLimit );
+}
+
+void CMotionGenerator::ResetWalk()
+{
+	m_walk.ulStep = 0;
+	for ( uint32_t unChannel = 0; unChannel < Channel_Count; unChannel++ )
+	{
+		m_walk.rflValue[ unChannel ] = 0.0;
+		m_walk.rflRate[ unChannel ] = 0.0;
+	}
+	for ( uint32_t i = 0; i < k_unWalkCheckpoints; i++ )
+	{
+		m_rWalkCheckpoints[i].ulStep = ~0ull;
+	}
+}
+
+void CMotionGenerator::IntegrateWalk( WalkState_t *pWalk, uint64_t ulStep ) const
+{
+	const double dt = k_flWalkStepSeconds;
+	for ( ; pWalk->ulStep < ulStep; pWalk->ulStep++ )
+	{
+		for ( uint32_t unChannel = 0; unChannel < Channel_Count; unChannel++ )
+		{
+			double flAcceleration = GetWalkAcceleration( unChannel, pWalk->ulStep, pWalk->rflValue[ unChannel ], pWalk->rflRate[ unChannel ] );
+			pWalk->rflValue[ unChannel ] += pWalk->rflRate[ unChannel ] * dt + 0.5 * flAcceleration * dt * dt;
+			pWalk->rflRate[ unChannel ] += flAcceleration * dt;
+		}
+	}
+}
+
+void CMotionGenerator::AdvanceWalk( uint64_t ulStep )
+{
+	while ( m_walk.ulStep < ulStep )
+	{
+		if ( m_walk.ulStep % k_unWalkCheckpointSteps == 0 )
+			m_rWalkCheckpoints[ ( m_walk.ulStep / k_unWalkCheckpointSteps ) % k_unWalkCheckpoints ] = m_walk;
+		IntegrateWalk( &m_walk, std::min( ulStep, ( m_walk.ulStep / k_unWalkCheckpointSteps + 1 ) * k_unWalkCheckpointSteps ) );
+	}
+}
+
+CMotionGenerator::WalkState_t CMotionGenerator::FindWalkCheckpoint( uint64_t ulStep ) const
+{
+	uint64_t ulCheckpoint = ulStep / k_unWalkCheckpointSteps;
+	const WalkState_t &checkpoint = m_rWalkCheckpoints[ ulCheckpoint % k_unWalkCheckpoints ];
+	if ( checkpoint.ulStep == ulCheckpoint * k_unWalkCheckpointSteps )
+		return checkpoint;
+
+	// older than the ring; replaying from rest gives the same trajectory, only slowly
+	WalkState_t rest;
+	rest.ulStep = 0;
+	for ( uint32_t unChannel = 0; unChannel < Channel_Count; unChannel++ )
+	{
+		rest.rflValue[ unChannel ] = 0.0;
+		rest.rflRate[ unChannel ] = 0.0;
+	}
+	return rest;
+}
+
+CMotionGenerator::ChannelState_t CMotionGenerator::SampleWalk( const WalkState_t &walk, uint32_t unChannel, double flSeconds ) const
+{
+	// constant acceleration within a step, so position, velocity and acceleration agree exactly
+	double flIntoStep = flSeconds - (double)walk.ulStep * k_flWalkStepSeconds;
+	double flValue = walk.rflValue[ unChannel ];
+	double flRate = walk.rflRate[ unChannel ];
+
+	ChannelState_t state;
+	state.flAcceleration = GetWalkAcceleration( unChannel, walk.ulStep, flValue, flRate );
+	state.flValue = flValue + flRate * flIntoStep + 0.5 * state.flAcceleration * flIntoStep * flIntoStep;
+	state.flRate = flRate + state.flAcceleration * flIntoStep;
+	return state;
+}
+
+MotionSample_t CMotionGenerator::Sample( uint64_t ulTimeNs )
+{
+	double flSeconds = (double)ulTimeNs * 1e-9;
+	ChannelState_t rState[ Channel_Count ];
+
+	if ( m_config.eMode == Motion_Walk )
+	{
+		// the shared state only moves forward; an earlier time integrates a copy, outside the lock
+		uint64_t ulStep = (uint64_t)( flSeconds / k_flWalkStepSeconds );
+		WalkState_t walk;
+		{
+			std::lock_guard<std::mutex> lock( m_walkMutex );
+			if ( ulStep >= m_walk.ulStep )
+			{
+				AdvanceWalk( ulStep );
+				walk = m_walk;
+			}
+			else
+			{
+				walk = FindWalkCheckpoint( ulStep );
+			}
+		}
+		IntegrateWalk( &walk, ulStep );
+		for ( uint32_t unChannel = 0; unChannel < Channel_Count; unChannel++ )
+		{
+			rState[ unChannel ] = SampleWalk( walk, unChannel, flSeconds );
+		}
+	}
+	else
+	{
+		for ( uint32_t unChannel = 0; unChannel < Channel_Count; unChannel++ )
+		{
+			switch ( m_config.eMode )
+			{
+			case Motion_Sweep:
+				rState[ unChannel ] = SampleSweep( unChannel, flSeconds );
+				break;
+			case Motion_Spline:
+				rState[ unChannel ] = SampleSpline( unChannel, flSeconds );
+				break;
+			case Motion_Script:
+				rState[ unChannel ] = SampleScript( unChannel, flSeconds );
+				break;
+			default:
+				rState[ unChannel ].flValue = rState[ unChannel ].flRate = rState[ unChannel ].flAcceleration = 0.0;
+				break;
+			}
+		}
+	}
+
+	MotionSample_t sample;
+	for ( uint32_t i = 0; i < 3; i++ )
+	{
+		sample.rflPosition[i] = m_rflBase[i] + rState[ Channel_X + i ].flValue;
+		sample.rflVelocity[i] = rState[ Channel_X + i ].flRate;
+		sample.rflAcceleration[i] = rState[ Channel_X + i ].flAcceleration;
+	}
+
+	// yaw about +y, then pitch about the turned x axis, then roll about the turned z axis
+	const ChannelState_t &yaw = rState[ Channel_Yaw ];
+	const ChannelState_t &pitch = rState[ Channel_Pitch ];
+	const ChannelState_t &roll = rState[ Channel_Roll ];
+	double cy = cos( 0.5 * yaw.flValue ), sy = sin( 0.5 * yaw.flValue );
+	double cp = cos( 0.5 * pitch.flValue ), sp = sin( 0.5 * pitch.flValue );
+	double cr = cos( 0.5 * roll.flValue ), sr = sin( 0.5 * roll.flValue );
+	sample.qRotation.w = cy * cp * cr + sy * sp * sr;
+	sample.qRotation.x = cy * sp * cr + sy * cp * sr;
+	sample.qRotation.y = sy * cp * cr - cy * sp * sr;
+	sample.qRotation.z = cy * cp * sr - sy * sp * cr;
+
+	// world space axes of the three rotations; the angular velocity is their rates along them,
+	// and differentiating that again adds the terms from the axes turning
+	double rflYawAxis[3] = { 0.0, 1.0, 0.0 };
+	double rflPitchAxis[3] = { cos( yaw.flValue ), 0.0, -sin( yaw.flValue ) };
+	double rflRollAxis[3] = { sin( yaw.flValue ) * cos( pitch.flValue ), -sin( pitch.flValue ), cos( yaw.flValue ) * cos( pitch.flValue ) };
+
+	double rflYawRate[3], rflYawPitchRate[3];
+	for ( uint32_t i = 0; i < 3; i++ )
+	{
+		rflYawRate[i] = yaw.flRate * rflYawAxis[i];
+		rflYawPitchRate[i] = rflYawRate[i] + pitch.flRate * rflPitchAxis[i];
+	}
+	double rflPitchAxisTurn[3], rflRollAxisTurn[3];
+	Cross( rflYawRate, rflPitchAxis, rflPitchAxisTurn );
+	Cross( rflYawPitchRate, rflRollAxis, rflRollAxisTurn );
+
+	for ( uint32_t i = 0; i < 3; i++ )
+	{
+		sample.rflAngularVelocity[i] = rflYawPitchRate[i] + roll.flRate * rflRollAxis[i];
+		sample.rflAngularAcceleration[i] = yaw.flAcceleration * rflYawAxis[i] + pitch.flAcceleration * rflPitchAxis[i] + roll.flAcceleration * rflRollAxis[i]
+			+ pitch.flRate * rflPitchAxisTurn[i] + roll.flRate * rflRollAxisTurn[i];
+	}
+	return sample;
+}
+
+void CMotionGenerator::ApplyToPose( const MotionSample_t &sample, vr::DriverPose_t *pPose )
+{
+	for ( uint32_t i = 0; i < 3; i++ )
+	{
+		pPose->vecPosition[i] = sample.rflPosition[i];
+		pPose->vecVelocity[i] = sample.rflVelocity[i];
+		pPose->vecAcceleration[i] = sample.rflAcceleration[i];
+		pPose->vecAngularVelocity[i] = sample.rflAngularVelocity[i];
+		pPose->vecAngularAcceleration[i] = sample.rflAngularAcceleration[i];
+	}
+	pPose->qRotation = sample.qRotation;
+}
+
+void CMotionGenerator::FormatSummary( uint64_t ulTimeNs, char *pchBuffer, uint32_t unBufferSize )
+{
+	MotionSample_t sample = Sample( ulTimeNs );
+	snprintf( pchBuffer, unBufferSize,
+		"mode=%s profile=%s seed=%llu position_amplitude_m=%g rotation_amplitude_deg=%g frequency_hz=%g keyframes=%u loop=%d\n"
+		"t=%.3f position=%.4f,%.4f,%.4f velocity=%.4f,%.4f,%.4f acceleration=%.3f,%.3f,%.3f\n"
+		"rotation=%.5f,%.5f,%.5f,%.5f angular_velocity=%.4f,%.4f,%.4f angular_acceleration=%.3f,%.3f,%.3f\n",
+		GetModeName( m_config.eMode ), m_config.eProfile == MotionProfile_Hand ? "hand" : "head", (unsigned long long)m_config.ulSeed,
+		m_config.flPositionAmplitude, m_config.flRotationAmplitude, m_config.flFrequency, (uint32_t)m_vecKeyframes.size(), m_config.bScriptLoop ? 1 : 0,
+		(double)ulTimeNs * 1e-9,
+		sample.rflPosition[0], sample.rflPosition[1], sample.rflPosition[2],
+		sample.rflVelocity[0], sample.rflVelocity[1], sample.rflVelocity[2],
+		sample.rflAcceleration[0], sample.rflAcceleration[1], sample.rflAcceleration[2],
+		sample.qRotation.w, sample.qRotation.x, sample.qRotation.y, sample.qRotation.z,
+		sample.rflAngularVelocity[0], sample.rflAngularVelocity[1], sample.rflAngularVelocity[2],
+		sample.rflAngularAcceleration[0], sample.rflAngularAcceleration[1], sample.rflAngularAcceleration[2] );
+}
@@ -0,0 +1,122 @@
+#include <rendertargetcontroller.h>
+
+#include <stdio.h>
+#include <math.h>
+
+#include <algorithm>
+
+// a reading needs this many frames rendered at the current size since the previous reading
+static const uint32_t k_unMinFrames = 45;
+
+// GPU p95 as a fraction of the frame budget: above the high mark scales down,
+// below the low mark scales up, in between holds; the target sits in the band
+static const float k_flHighLoad = 0.90f;
+static const float k_flLowLoad = 0.70f;
+static const float k_flTargetLoad = 0.80f;
+
+// more reprojected or dropped frames than this scales down whatever the GPU time says
+static const float k_flMaxReprojectedFraction = 0.05f;
+
+// one step never moves the scale further than this
+static const float k_flMaxStepDown = 0.80f;
+static const float k_flMinStepDown = 0.95f;
+static const float k_flMaxStepUp = 1.10f;
+
+static const uint32_t k_unCalmReadingsToScaleUp = 2;
+
+// render targets stay a multiple of this many pixels
+static const uint32_t k_unSizeAlignment = 8;
+
+CRenderTargetController::CRenderTargetController()
+{
+	m_unBaseWidth = m_unWidth = 0;
+	m_unBaseHeight = m_unHeight = 0;
+	m_flMinScale = m_flMaxScale = 1.f;
+	m_flScale = 1.f;
+	m_flLastLoad = 0.f;
+	m_unScaleDowns = 0;
+	m_unScaleUps = 0;
+	m_unLastReadFrameIndex = 0;
+	m_unCalmReadings = 0;
+}
+
+void CRenderTargetController::Configure( uint32_t unBaseWidth, uint32_t unBaseHeight, float flMinScale, float flMaxScale )
+{
+	m_unBaseWidth = unBaseWidth;
+	m_unBaseHeight = unBaseHeight;
+	m_flMinScale = std::min( flMinScale, 1.f );
+	m_flMaxScale = std::max( flMaxScale, 1.f );
+	m_flScale = 1.f;
+	m_unWidth = unBaseWidth;
+	m_unHeight = unBaseHeight;
+	m_unCalmReadings = 0;
+}
+
+bool CRenderTargetController::SetScale( float flScale, uint32_t unLastFrameIndex )
+{
+	flScale = std::min( std::max( flScale, m_flMinScale ), m_flMaxScale );
+
+	uint32_t unWidth = std::max( (uint32_t)lroundf( m_unBaseWidth * flScale / k_unSizeAlignment ), 1u ) * k_unSizeAlignment;
+	uint32_t unHeight = std::max( (uint32_t)lroundf( m_unBaseHeight * flScale / k_unSizeAlignment ), 1u ) * k_unSizeAlignment;
+	if ( unWidth == m_unWidth && unHeight == m_unHeight )
+		return false;
+
+	m_flScale = flScale;
+	m_unWidth = unWidth;
+	m_unHeight = unHeight;
+	m_unLastReadFrameIndex = unLastFrameIndex;
+	m_unCalmReadings = 0;
+	return true;
+}
+
+bool CRenderTargetController::Update( const FrameTimingAggregates_t &aggregates, float flFrameBudgetMs )
+{
+	if ( aggregates.unFrames < k_unMinFrames || !( flFrameBudgetMs > 0.f ) )
+		return false;
+
+	// the next reading starts after these frames
+	m_unLastReadFrameIndex = aggregates.unLastFrameIndex;
+
+	float flLoad = aggregates.flGpuMsP95 / flFrameBudgetMs;
+	float flReprojected = (float)( aggregates.unGpuReprojected + aggregates.unDropped ) / aggregates.unFrames;
+	m_flLastLoad = flLoad;
+
+	// GPU time follows the pixel count, which goes with the square of the scale
+	float flScale = m_flScale;
+	float flIdealStep = flLoad > 0.f ? sqrtf( k_flTargetLoad / flLoad ) : k_flMaxStepUp;
+
+	if ( flLoad > k_flHighLoad || flReprojected > k_flMaxReprojectedFraction )
+	{
+		float flStep = std::min( std::max( flIdealStep, k_flMaxStepDown ), k_flMinStepDown );
+		if ( SetScale( flScale * flStep, aggregates.unLastFrameIndex ) )
+		{
+			m_unScaleDowns++;
+			return true;
+		}
+		return false;
+	}
+
+	if ( flLoad < k_flLowLoad && flReprojected == 0.f )
+	{
+		if ( ++m_unCalmReadings < k_unCalmReadingsToScaleUp )
+			return false;
+
+		float flStep = std::min( flIdealStep, k_flMaxStepUp );
+		if ( SetScale( flScale * flStep, aggregates.unLastFrameIndex ) )
+		{
+			m_unScaleUps++;
+			return true;
+		}
+		return false;
+	}
+
+	m_unCalmReadings = 0;
+	return false;
+}
+
+void CRenderTargetController::FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const
+{
+	snprintf( pchBuffer, unBufferSize, "size=%ux%u scale=%.3f min=%.2f max=%.2f gpu_load=%.2f scale_downs=%u scale_ups=%u\n",
+		m_unWidth.load(), m_unHeight.load(), m_flScale.load(), m_flMinScale, m_flMaxScale, m_flLastLoad.load(),
+		m_unScaleDowns.load(), m_unScaleUps.load() );
+}
@@ -0,0 +1,355 @@
+#include <swaptextures.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// enough to recreate both eye sets without new mappings; beyond that the oldest is unmapped
+static const uint32_t k_unMaxRecycledTextures = 6;
+
+CSwapTextureSetPool::CSwapTextureSetPool()
+{
+	m_ulLiveBytes = 0;
+	m_ulCreatedTextures = 0;
+	m_ulRecycledTextures = 0;
+}
+
+CSwapTextureSetPool::~CSwapTextureSetPool()
+{
+	for ( const Texture_t &texture : m_vecTextures )
+	{
+		if ( texture.bInUse )
+		{
+			munmap( texture.memory.pData, texture.memory.ulSize );
+			close( texture.memory.nFd );
+		}
+	}
+	for ( const Recycled_t &recycled : m_vecRecycled )
+	{
+		munmap( recycled.memory.pData, recycled.memory.ulSize );
+		close( recycled.memory.nFd );
+	}
+	for ( const SwapTextureMemory_t &memory : m_vecOrphaned )
+	{
+		munmap( memory.pData, memory.ulSize );
+		close( memory.nFd );
+	}
+}
+
+uint32_t CSwapTextureSetPool::BytesPerPixel( uint32_t unFormat )
+{
+	// VkFormat values; everything else is assumed to be 8 bit RGBA
+	switch ( unFormat )
+	{
+	case 97:	// VK_FORMAT_R16G16B16A16_SFLOAT
+		return 8;
+	case 109:	// VK_FORMAT_R32G32B32A32_SFLOAT
+		return 16;
+	default:
+		return 4;
+	}
+}
+
+vr::SharedTextureHandle_t CSwapTextureSetPool::MakeHandle( uint32_t unSlot, uint32_t unGeneration )
+{
+	// slot + 1 so no valid handle is 0
+	return ( (vr::SharedTextureHandle_t)unGeneration << 32 ) | (vr::SharedTextureHandle_t)( unSlot + 1 );
+}
+
+CSwapTextureSetPool::Texture_t *CSwapTextureSetPool::LookupTexture( vr::SharedTextureHandle_t hTexture )
+{
+	uint32_t unSlot = (uint32_t)( hTexture & 0xffffffffull );
+	uint32_t unGeneration = (uint32_t)( hTexture >> 32 );
+	if ( unSlot == 0 || unSlot > m_vecTextures.size() )
+		return nullptr;
+
+	Texture_t &texture = m_vecTextures[ unSlot - 1 ];
+	if ( !texture.bInUse || texture.unGeneration != unGeneration )
+		return nullptr;
+	return &texture;
+}
+
+const CSwapTextureSetPool::Texture_t *CSwapTextureSetPool::LookupTexture( vr::SharedTextureHandle_t hTexture ) const
+{
+	return const_cast<CSwapTextureSetPool *>( this )->LookupTexture( hTexture );
+}
+
+bool CSwapTextureSetPool::AllocateMemory( uint32_t unPid, uint64_t ulSize, SwapTextureMemory_t *pMemory )
+{
+	// another client must never get memory the previous owner can still reach through its mapping
+	for ( size_t i = 0; i < m_vecRecycled.size(); i++ )
+	{
+		if ( m_vecRecycled[i].unPid == unPid && m_vecRecycled[i].memory.ulSize == ulSize )
+		{
+			*pMemory = m_vecRecycled[i].memory;
+			m_vecRecycled.erase( m_vecRecycled.begin() + i );
+			m_ulRecycledTextures++;
+			return true;
+		}
+	}
+
+	int nFd = memfd_create( "steamvr-test-swap", MFD_CLOEXEC );
+	if ( nFd < 0 )
+		return false;
+
+	if ( ftruncate( nFd, (off_t)ulSize ) != 0 )
+	{
+		close( nFd );
+		return false;
+	}
+
+	void *pData = mmap( nullptr, ulSize, PROT_READ | PROT_WRITE, MAP_SHARED, nFd, 0 );
+	if ( pData == MAP_FAILED )
+	{
+		close( nFd );
+		return false;
+	}
+
+	pMemory->pData = pData;
+	pMemory->ulSize = ulSize;
+	pMemory->nFd = nFd;
+	m_ulCreatedTextures++;
+	return true;
+}
+
+void CSwapTextureSetPool::ReleaseMemory( uint32_t unPid, const SwapTextureMemory_t &memory, bool bRecycle )
+{
+	if ( m_mapPins.count( memory.pData ) )
+	{
+		// still being read; UnpinTexture() unmaps it
+		m_vecOrphaned.push_back( memory );
+		return;
+	}
+
+	if ( !bRecycle )
+	{
+		munmap( memory.pData, memory.ulSize );
+		close( memory.nFd );
+		return;
+	}
+
+	if ( m_vecRecycled.size() >= k_unMaxRecycledTextures )
+	{
+		ReleaseMemory( m_vecRecycled.front().unPid, m_vecRecycled.front().memory, false );
+		m_vecRecycled.erase( m_vecRecycled.begin() );
+	}
+
+	Recycled_t recycled;
+	recycled.memory = memory;
+	recycled.unPid = unPid;
+	m_vecRecycled.push_back( recycled );
+}
+
+bool CSwapTextureSetPool::CreateSet( uint32_t unPid, const vr::IVRDriverDirectModeComponent::SwapTextureSetDesc_t &desc, vr::IVRDriverDirectModeComponent::SwapTextureSet_t *pOutSet )
+{
+	if ( desc.nWidth == 0 || desc.nHeight == 0 )
+		return false;
+
+	uint32_t unBytesPerPixel = BytesPerPixel( desc.nFormat );
+	uint32_t unRowPitch = desc.nWidth * unBytesPerPixel;
+	uint64_t ulSize = (uint64_t)unRowPitch * desc.nHeight;
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+
+	SwapTextureMemory_t rMemory[ k_unTexturesPerSet ];
+	for ( uint32_t i = 0; i < k_unTexturesPerSet; i++ )
+	{
+		if ( !AllocateMemory( unPid, ulSize, &rMemory[i] ) )
+		{
+			for ( uint32_t j = 0; j < i; j++ )
+			{
+				ReleaseMemory( unPid, rMemory[j], true );
+			}
+			return false;
+		}
+	}
+
+	uint32_t unSet;
+	if ( m_vecFreeSets.empty() )
+	{
+		unSet = (uint32_t)m_vecSets.size();
+		m_vecSets.push_back( Set_t() );
+	}
+	else
+	{
+		unSet = m_vecFreeSets.back();
+		m_vecFreeSets.pop_back();
+	}
+
+	Set_t &set = m_vecSets[ unSet ];
+	set.unPid = unPid;
+	set.unNextIndex = 0;
+	set.bInUse = true;
+
+	for ( uint32_t i = 0; i < k_unTexturesPerSet; i++ )
+	{
+		uint32_t unSlot;
+		if ( m_vecFreeTextures.empty() )
+		{
+			unSlot = (uint32_t)m_vecTextures.size();
+			Texture_t texture;
+			texture.unGeneration = 0;
+			m_vecTextures.push_back( texture );
+		}
+		else
+		{
+			unSlot = m_vecFreeTextures.back();
+			m_vecFreeTextures.pop_back();
+		}
+
+		Texture_t &texture = m_vecTextures[ unSlot ];
+		texture.memory = rMemory[i];
+		texture.memory.unWidth = desc.nWidth;
+		texture.memory.unHeight = desc.nHeight;
+		texture.memory.unFormat = desc.nFormat;
+		texture.memory.unBytesPerPixel = unBytesPerPixel;
+		texture.memory.unRowPitch = unRowPitch;
+		texture.unGeneration++;
+		texture.unSet = unSet;
+		texture.bInUse = true;
+
+		set.runTextures[i] = unSlot;
+		pOutSet->rSharedTextureHandles[i] = MakeHandle( unSlot, texture.unGeneration );
+	}
+	pOutSet->unTextureFlags = 0;
+
+	m_mapSetsByPid[ unPid ].push_back( unSet );
+	m_ulLiveBytes += ulSize * k_unTexturesPerSet;
+	return true;
+}
+
+void CSwapTextureSetPool::DestroySetLocked( uint32_t unSet, bool bRecycle )
+{
+	Set_t &set = m_vecSets[ unSet ];
+	for ( uint32_t i = 0; i < k_unTexturesPerSet; i++ )
+	{
+		Texture_t &texture = m_vecTextures[ set.runTextures[i] ];
+		m_ulLiveBytes -= texture.memory.ulSize;
+		ReleaseMemory( set.unPid, texture.memory, bRecycle );
+		texture.bInUse = false;
+		m_vecFreeTextures.push_back( set.runTextures[i] );
+	}
+	set.bInUse = false;
+	m_vecFreeSets.push_back( unSet );
+}
+
+void CSwapTextureSetPool::DestroySet( vr::SharedTextureHandle_t hTexture )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	Texture_t *pTexture = LookupTexture( hTexture );
+	if ( !pTexture )
+		return;
+
+	uint32_t unSet = pTexture->unSet;
+	uint32_t unPid = m_vecSets[ unSet ].unPid;
+	std::vector<uint32_t> &vecPidSets = m_mapSetsByPid[ unPid ];
+	for ( size_t i = 0; i < vecPidSets.size(); i++ )
+	{
+		if ( vecPidSets[i] == unSet )
+		{
+			vecPidSets[i] = vecPidSets.back();
+			vecPidSets.pop_back();
+			break;
+		}
+	}
+	if ( vecPidSets.empty() )
+	{
+		m_mapSetsByPid.erase( unPid );
+	}
+	DestroySetLocked( unSet, true );
+}
+
+void CSwapTextureSetPool::DestroyAllSets( uint32_t unPid )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+
+	// the client is going away, so nothing of it is worth keeping
+	for ( size_t i = 0; i < m_vecRecycled.size(); )
+	{
+		if ( m_vecRecycled[i].unPid == unPid )
+		{
+			ReleaseMemory( unPid, m_vecRecycled[i].memory, false );
+			m_vecRecycled.erase( m_vecRecycled.begin() + i );
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	std::unordered_map< uint32_t, std::vector<uint32_t> >::iterator it = m_mapSetsByPid.find( unPid );
+	if ( it == m_mapSetsByPid.end() )
+		return;
+
+	for ( uint32_t unSet : it->second )
+	{
+		DestroySetLocked( unSet, false );
+	}
+	m_mapSetsByPid.erase( it );
+}
+
+int32_t CSwapTextureSetPool::AdvanceSet( vr::SharedTextureHandle_t hTexture )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	Texture_t *pTexture = LookupTexture( hTexture );
+	if ( !pTexture )
+		return -1;
+
+	Set_t &set = m_vecSets[ pTexture->unSet ];
+	set.unNextIndex = ( set.unNextIndex + 1 ) % k_unTexturesPerSet;
+	return (int32_t)set.unNextIndex;
+}
+
+bool CSwapTextureSetPool::GetTextureMemory( vr::SharedTextureHandle_t hTexture, SwapTextureMemory_t *pMemory ) const
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	const Texture_t *pTexture = LookupTexture( hTexture );
+	if ( !pTexture )
+		return false;
+
+	*pMemory = pTexture->memory;
+	return true;
+}
+
+bool CSwapTextureSetPool::PinTexture( vr::SharedTextureHandle_t hTexture, SwapTextureMemory_t *pMemory )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	const Texture_t *pTexture = LookupTexture( hTexture );
+	if ( !pTexture )
+		return false;
+
+	*pMemory = pTexture->memory;
+	m_mapPins[ pMemory->pData ]++;
+	return true;
+}
+
+void CSwapTextureSetPool::UnpinTexture( const SwapTextureMemory_t &memory )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	std::unordered_map< void *, uint32_t >::iterator it = m_mapPins.find( memory.pData );
+	if ( it == m_mapPins.end() || --it->second )
+		return;
+	m_mapPins.erase( it );
+
+	for ( size_t i = 0; i < m_vecOrphaned.size(); i++ )
+	{
+		if ( m_vecOrphaned[i].pData == memory.pData )
+		{
+			ReleaseMemory( 0, m_vecOrphaned[i], false );
+			m_vecOrphaned[i] = m_vecOrphaned.back();
+			m_vecOrphaned.pop_back();
+			break;
+		}
+	}
+}
+
+void CSwapTextureSetPool::FormatSummary( char *pchBuffer, uint32_t unBufferSize ) const
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	uint32_t unLiveSets = (uint32_t)( m_vecSets.size() - m_vecFreeSets.size() );
+	snprintf( pchBuffer, unBufferSize, "sets=%u pids=%u live_mb=%.1f created_textures=%llu recycled_textures=%llu cached=%u pinned=%u orphaned=%u\n",
+		unLiveSets, (uint32_t)m_mapSetsByPid.size(), m_ulLiveBytes / ( 1024.0 * 1024.0 ),
+		(unsigned long long)m_ulCreatedTextures, (unsigned long long)m_ulRecycledTextures, (uint32_t)m_vecRecycled.size(),
+		(uint32_t)m_mapPins.size(), (uint32_t)m_vecOrphaned.size() );
+}
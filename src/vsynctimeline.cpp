@@ -0,0 +1,177 @@
+#include <vsynctimeline.h>
+
+#include <time.h>
+#include <errno.h>
+#include <math.h>
+
+uint64_t GetMonotonicNs()
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void SleepUntilNs( uint64_t ulDeadlineNs, uint64_t ulSpinNs )
+{
+	if ( ulDeadlineNs > ulSpinNs )
+	{
+		uint64_t ulWakeNs = ulDeadlineNs - ulSpinNs;
+		struct timespec ts;
+		ts.tv_sec = (time_t)( ulWakeNs / 1000000000ull );
+		ts.tv_nsec = (long)( ulWakeNs % 1000000000ull );
+		while ( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr ) == EINTR )
+		{
+		}
+	}
+
+	while ( GetMonotonicNs() < ulDeadlineNs )
+	{
+	}
+}
+
+
+CVsyncTimeline::CVsyncTimeline()
+{
+	m_unSequence = 0;
+	m_ulEpochNs = 0;
+	m_ulEpochFrame = 0;
+	m_ulPeriodNs = 1;
+}
+
+uint64_t CVsyncTimeline::PeriodFromFrequency( double flFrequencyHz )
+{
+	if ( flFrequencyHz <= 0.0 )
+		flFrequencyHz = 90.0;
+
+	return (uint64_t)( 1e9 / flFrequencyHz + 0.5 );
+}
+
+void CVsyncTimeline::Start( double flFrequencyHz )
+{
+	Anchor_t anchor;
+	anchor.ulPeriodNs = PeriodFromFrequency( flFrequencyHz );
+	anchor.ulEpochFrame = 0;
+	anchor.ulEpochNs = GetMonotonicNs();
+	StoreAnchor( anchor );
+}
+
+void CVsyncTimeline::Retime( double flFrequencyHz, uint64_t ulNowNs )
+{
+	Anchor_t anchor = LoadAnchor();
+	uint64_t ulLastFrame = FrameAt( anchor, ulNowNs );
+
+	Anchor_t retimed;
+	retimed.ulEpochFrame = ulLastFrame;
+	retimed.ulEpochNs = VsyncTimeNs( anchor, ulLastFrame );
+	retimed.ulPeriodNs = PeriodFromFrequency( flFrequencyHz );
+	StoreAnchor( retimed );
+}
+
+CVsyncTimeline::Anchor_t CVsyncTimeline::LoadAnchor() const
+{
+	Anchor_t anchor;
+	uint32_t unBefore, unAfter;
+	do
+	{
+		unBefore = m_unSequence.load( std::memory_order_acquire );
+		anchor.ulEpochNs = m_ulEpochNs.load( std::memory_order_relaxed );
+		anchor.ulEpochFrame = m_ulEpochFrame.load( std::memory_order_relaxed );
+		anchor.ulPeriodNs = m_ulPeriodNs.load( std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_acquire );
+		unAfter = m_unSequence.load( std::memory_order_relaxed );
+	} while ( ( unBefore & 1 ) || unBefore != unAfter );
+	return anchor;
+}
+
+void CVsyncTimeline::StoreAnchor( const Anchor_t &anchor )
+{
+	// single writer: Start/Retime are only called from the driver's control paths
+	uint32_t unSequence = m_unSequence.load( std::memory_order_relaxed );
+	m_unSequence.store( unSequence + 1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+	m_ulEpochNs.store( anchor.ulEpochNs, std::memory_order_relaxed );
+	m_ulEpochFrame.store( anchor.ulEpochFrame, std::memory_order_relaxed );
+	m_ulPeriodNs.store( anchor.ulPeriodNs, std::memory_order_relaxed );
+	m_unSequence.store( unSequence + 2, std::memory_order_release );
+}
+
+uint64_t CVsyncTimeline::FrameAt( const Anchor_t &anchor, uint64_t ulNowNs )
+{
+	if ( ulNowNs < anchor.ulEpochNs )
+		return anchor.ulEpochFrame;
+
+	return anchor.ulEpochFrame + ( ulNowNs - anchor.ulEpochNs ) / anchor.ulPeriodNs;
+}
+
+uint64_t CVsyncTimeline::VsyncTimeNs( const Anchor_t &anchor, uint64_t ulFrame )
+{
+	if ( ulFrame < anchor.ulEpochFrame )
+		return anchor.ulEpochNs;
+
+	return anchor.ulEpochNs + ( ulFrame - anchor.ulEpochFrame ) * anchor.ulPeriodNs;
+}
+
+uint64_t CVsyncTimeline::GetFrameAt( uint64_t ulNowNs ) const
+{
+	return FrameAt( LoadAnchor(), ulNowNs );
+}
+
+uint64_t CVsyncTimeline::GetFrameNearest( uint64_t ulTimeNs ) const
+{
+	Anchor_t anchor = LoadAnchor();
+	return FrameAt( anchor, ulTimeNs + anchor.ulPeriodNs / 2 );
+}
+
+uint64_t CVsyncTimeline::GetVsyncTimeNs( uint64_t ulFrame ) const
+{
+	return VsyncTimeNs( LoadAnchor(), ulFrame );
+}
+
+uint64_t CVsyncTimeline::Sample( uint64_t ulNowNs, uint64_t *pulNsSinceVsync ) const
+{
+	Anchor_t anchor = LoadAnchor();
+	uint64_t ulFrame = FrameAt( anchor, ulNowNs );
+	if ( pulNsSinceVsync )
+	{
+		uint64_t ulVsyncNs = VsyncTimeNs( anchor, ulFrame );
+		*pulNsSinceVsync = ulNowNs > ulVsyncNs ? ulNowNs - ulVsyncNs : 0;
+	}
+	return ulFrame;
+}
+
+
+void CTickJitterStats::Reset()
+{
+	m_ulCount = 0;
+	m_ulMaxNs = 0;
+	m_flSumNs = 0.0;
+	m_flSumSqNs = 0.0;
+}
+
+void CTickJitterStats::AddSample( uint64_t ulLatenessNs )
+{
+	double flLatenessNs = (double)ulLatenessNs;
+	m_flSumNs.store( m_flSumNs.load( std::memory_order_relaxed ) + flLatenessNs, std::memory_order_relaxed );
+	m_flSumSqNs.store( m_flSumSqNs.load( std::memory_order_relaxed ) + flLatenessNs * flLatenessNs, std::memory_order_relaxed );
+	if ( ulLatenessNs > m_ulMaxNs.load( std::memory_order_relaxed ) )
+		m_ulMaxNs.store( ulLatenessNs, std::memory_order_relaxed );
+	m_ulCount.fetch_add( 1, std::memory_order_release );
+}
+
+double CTickJitterStats::GetMeanNs() const
+{
+	uint64_t ulCount = m_ulCount.load( std::memory_order_acquire );
+	if ( ulCount == 0 )
+		return 0.0;
+	return m_flSumNs.load( std::memory_order_relaxed ) / (double)ulCount;
+}
+
+double CTickJitterStats::GetStdDevNs() const
+{
+	uint64_t ulCount = m_ulCount.load( std::memory_order_acquire );
+	if ( ulCount < 2 )
+		return 0.0;
+	double flMean = m_flSumNs.load( std::memory_order_relaxed ) / (double)ulCount;
+	double flVariance = m_flSumSqNs.load( std::memory_order_relaxed ) / (double)ulCount - flMean * flMean;
+	return flVariance > 0.0 ? sqrt( flVariance ) : 0.0;
+}